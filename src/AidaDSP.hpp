@@ -0,0 +1,431 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoPluginInfo.h"
+
+#include "BiquadCascade.hpp"
+
+#include "extra/ValueSmoother.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <memory>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Define a constexpr for converting a gain in dB to a coefficient */
+static constexpr float DB_CO(const float g) { return g > -90.f ? std::pow(10.f, g * 0.05f) : 0.f; }
+
+/* Define a macro to re-maps a number from one range to another  */
+static constexpr float MAP(const float x, const float in_min, const float in_max, const float out_min, const float out_max)
+{
+    return ((x - in_min) * (out_max - out_min) / (in_max - in_min)) + out_min;
+}
+
+/* Defines for tone controls */
+static constexpr const float COMMON_Q = 0.707f;
+static constexpr const float DEPTH_FREQ = 75.f;
+static constexpr const float PRESENCE_FREQ = 900.f;
+
+/* Defines for antialiasing filter */
+static constexpr const float INLPF_MAX_CO = 0.99f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
+static constexpr const float INLPF_MIN_CO = 0.25f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
+
+/* Gain compensation for cabinet IR (-12dB) */
+static constexpr const float kCabinetMaxGain = 0.251f;
+
+/* Remaining energy, relative to the whole IR, below which the end of a cabinet IR is considered silent */
+static constexpr const double kCabinetTrimThresholdDb = -60.0;
+
+/* Fade applied at the end of a cut IR */
+static constexpr const double kCabinetFadeTime = 0.005;
+
+/* Smoothing time of the model conditioning parameters (PARAM1 and PARAM2), in seconds */
+static constexpr const float kModelParamSmoothTime = 0.1f;
+
+/* Channels going through the DSP chain, stereo builds run both through a single model and cabinet */
+#if AIDAX_STEREO
+static constexpr const uint32_t kNumDSPChannels = 2;
+#else
+static constexpr const uint32_t kNumDSPChannels = 1;
+#endif
+
+/* Filters with coefficients depending on parameters, see AidaToneControl::updateFilters */
+enum AidaFilters {
+    kFilterDCBlocker = 1 << 0,
+    kFilterInLPF     = 1 << 1,
+    kFilterBass      = 1 << 2,
+    kFilterMid       = 1 << 3,
+    kFilterTreble    = 1 << 4,
+    kFilterDepth     = 1 << 5,
+    kFilterPresence  = 1 << 6,
+    kFiltersAll      = (1 << 7) - 1
+};
+
+/* Section order of the tone stack cascade */
+enum ToneStackSections {
+    kToneStackDepth = 0,
+    kToneStackBass,
+    kToneStackMid,
+    kToneStackTreble,
+    kToneStackPresence,
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+struct AidaToneControl {
+    Biquad dc_blocker { bq_type_highpass, 0.5f, COMMON_Q, 0.0f };
+    Biquad in_lpf { bq_type_lowpass, 0.5f, COMMON_Q, 0.0f };
+    Biquad bass { bq_type_lowshelf, 0.5f, COMMON_Q, 0.0f };
+    Biquad mid { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
+    Biquad treble { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
+    Biquad depth { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
+    Biquad presence { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
+    // filter state per channel, coefficients are shared
+    BiquadCascade dc_blocker_stage[kNumDSPChannels];
+    BiquadCascade in_lpf_stage[kNumDSPChannels];
+    BiquadCascade tone_stack[kNumDSPChannels];
+    ExponentialValueSmoother inlevel;
+    ExponentialValueSmoother outlevel;
+    bool net_bypass = false;
+    bool eq_bypass = false;
+    EqPos eq_pos = kEqPost;
+    MidEqType mid_type = kMidEqPeak;
+
+    AidaToneControl()
+    {
+        inlevel.setTimeConstant(1);
+        outlevel.setTimeConstant(1);
+    }
+
+    void setSampleRate(const float parameters[kNumParameters], const double sampleRate)
+    {
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            dc_blocker_stage[c].setSampleRate(sampleRate);
+            in_lpf_stage[c].setSampleRate(sampleRate);
+            tone_stack[c].setSampleRate(sampleRate);
+        }
+
+        updateFilters(parameters, sampleRate, kFiltersAll);
+
+        inlevel.setSampleRate(sampleRate);
+        inlevel.setTargetValue(DB_CO(parameters[kParameterINLEVEL]));
+
+        outlevel.setSampleRate(sampleRate);
+        outlevel.setTargetValue(DB_CO(parameters[kParameterOUTLEVEL]));
+    }
+
+    /* Recompute coefficients of the given filters (AidaFilters flags), meant to be called once per block.
+       The filter stages then ramp to the new coefficients. */
+    void updateFilters(const float parameters[kNumParameters], const double sampleRate, const uint32_t filters)
+    {
+        if (filters & kFilterDCBlocker)
+            dc_blocker.setFc(35.0f / sampleRate);
+
+        if (filters & kFilterInLPF)
+            in_lpf.setFc(MAP(parameters[kParameterINLPF], 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+
+        if (filters & kFilterBass)
+            bass.setBiquad(bq_type_lowshelf,
+                           parameters[kParameterBASSFREQ] / sampleRate, COMMON_Q, parameters[kParameterBASSGAIN]);
+
+        if (filters & kFilterMid)
+            mid.setBiquad(mid_type == kMidEqBandpass ? bq_type_bandpass : bq_type_peak,
+                          parameters[kParameterMIDFREQ] / sampleRate,
+                          parameters[kParameterMIDQ],
+                          parameters[kParameterMIDGAIN]);
+
+        if (filters & kFilterTreble)
+            treble.setBiquad(bq_type_highshelf,
+                             parameters[kParameterTREBLEFREQ] / sampleRate, COMMON_Q, parameters[kParameterTREBLEGAIN]);
+
+        if (filters & kFilterDepth)
+            depth.setBiquad(bq_type_peak,
+                            DEPTH_FREQ / sampleRate, COMMON_Q, parameters[kParameterDEPTH]);
+
+        if (filters & kFilterPresence)
+            presence.setBiquad(bq_type_highshelf,
+                               PRESENCE_FREQ / sampleRate, COMMON_Q, parameters[kParameterPRESENCE]);
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Apply a gain ramp to a buffer
+
+static inline void applyGainRamp(ExponentialValueSmoother& smoother, float* const out, const uint32_t numSamples)
+{
+    for (uint32_t i=0; i<numSamples; ++i)
+        out[i] *= smoother.next();
+}
+
+/* Same for all channels, stepping the smoother once per frame */
+static inline void applyGainRamp(ExponentialValueSmoother& smoother,
+                                 float* const outs[kNumDSPChannels], const uint32_t numSamples)
+{
+    for (uint32_t i=0; i<numSamples; ++i)
+    {
+        const float g = smoother.next();
+
+        for (uint32_t c=0; c<kNumDSPChannels; ++c)
+            outs[c][i] *= g;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Apply filter, coefficients are picked up from the Biquad designer at the start of each block and ramped to
+
+static inline void applyBiquadFilter(BiquadCascade& stage, const Biquad& filter,
+                                     float* const out, const float* const in, const uint32_t numSamples)
+{
+    stage.setSection(0, filter);
+    stage.process(out, in, numSamples);
+}
+
+static inline void applyBiquadFilter(BiquadCascade& stage, const Biquad& filter,
+                                     float* const out, const uint32_t numSamples)
+{
+    applyBiquadFilter(stage, filter, out, out, numSamples);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Apply biquad cascade filters, in a single pass
+
+static inline void applyToneControls(AidaToneControl& aida, float* const out, uint32_t numSamples,
+                                     const uint32_t channel = 0)
+{
+    // bandpass mid runs alone
+    const bool shelves = aida.mid_type != kMidEqBandpass;
+    BiquadCascade& tone_stack = aida.tone_stack[channel];
+
+    tone_stack.setSection(kToneStackDepth, aida.depth, shelves);
+    tone_stack.setSection(kToneStackBass, aida.bass, shelves);
+    tone_stack.setSection(kToneStackMid, aida.mid);
+    tone_stack.setSection(kToneStackTreble, aida.treble, shelves);
+    tone_stack.setSection(kToneStackPresence, aida.presence, shelves);
+    tone_stack.process(out, numSamples);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Find where the energy decay curve of an IR (energy left from each sample to the end) drops below the trim threshold
+
+static inline size_t getCabinetIRDecayLength(const float* const ir, const size_t len) noexcept
+{
+    double total = 0.0;
+
+    for (size_t i = 0; i < len; ++i)
+        total += static_cast<double>(ir[i]) * ir[i];
+
+    if (total <= 0.0)
+        return len;
+
+    const double threshold = total * std::pow(10.0, kCabinetTrimThresholdDb / 10.0);
+    double remaining = 0.0;
+
+    for (size_t i = len; i-- > 0;)
+    {
+        remaining += static_cast<double>(ir[i]) * ir[i];
+
+        if (remaining > threshold)
+            return i + 1;
+    }
+
+    return len;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Fade out the end of a cut IR, so the cut does not add a click to the response
+
+static inline void fadeOutCabinetIR(float* const ir, const size_t len, const double sampleRate) noexcept
+{
+    const size_t fadeLen = std::min<size_t>(len / 4, static_cast<size_t>(sampleRate * kCabinetFadeTime));
+
+    for (size_t i = 0; i < fadeLen; ++i)
+        ir[len - fadeLen + i] *= 0.5f * (1.f + std::cos(static_cast<float>(M_PI) * (i + 1) / fadeLen));
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Fixed delay, keeping signals that skip the model aligned with the latency it adds
+
+/* Max latency a model can add, in frames, must be a power of 2 */
+static constexpr const uint32_t kMaxModelLatency = 8192;
+
+/* Max delay, room for the model latency plus one host buffer of pipelined processing (see DSPPipeline) */
+static constexpr const uint32_t kMaxLatencyDelay = kMaxModelLatency * 2;
+
+class LatencyDelay
+{
+    std::vector<float> buffer = std::vector<float>(kMaxLatencyDelay, 0.f);
+    uint32_t writePos = 0;
+    uint32_t delay = 0;
+
+public:
+    /* Change the delay, dropping what was buffered for the previous one */
+    void setDelay(const uint32_t frames) noexcept
+    {
+        if (delay == frames)
+            return;
+
+        delay = std::min(frames, kMaxLatencyDelay - 1);
+        std::fill(buffer.begin(), buffer.end(), 0.f);
+    }
+
+    void process(float* const out, const uint32_t numSamples) noexcept
+    {
+        if (delay == 0)
+            return;
+
+        for (uint32_t i=0; i<numSamples; ++i)
+        {
+            buffer[writePos] = out[i];
+            out[i] = buffer[(writePos - delay) & (kMaxLatencyDelay - 1)];
+            writePos = (writePos + 1) & (kMaxLatencyDelay - 1);
+        }
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Neural model, implemented by one of the model kernels (see model_kernel.cpp)
+
+class SharedModelWeights;
+
+/* Precision of the recurrent weights, reduced precision trades a bit of accuracy for speed on big models */
+enum ModelPrecision {
+    kModelPrecisionDefault = -1, /* as set by the model "precision" key, full precision if there is none */
+    kModelPrecisionFloat = 0,
+    kModelPrecisionBF16,
+    kModelPrecisionInt8,
+};
+
+struct DynamicModel {
+    int input_size = 0;
+    ModelPrecision precision = kModelPrecisionFloat;
+
+    /* Sample rate the model was trained at, 0 if unknown */
+    uint32_t sample_rate = 0;
+
+    /* Delay added to the processed audio, in frames, for models running at another sample rate than the host */
+    uint32_t latency = 0;
+
+    /* reset() puts the recurrent state where silence leaves it, so the model needs no pre-buffering */
+    bool settled_reset = false;
+
+    /* Weights the model was created from, shared with every other model loaded from the same contents */
+    std::shared_ptr<const SharedModelWeights> weights;
+
+    virtual ~DynamicModel() {}
+
+    /* Run the model in-place over a buffer, param1 and param2 are used only by conditioned models */
+    virtual void process(float* out, uint32_t numSamples, LinearValueSmoother& param1, LinearValueSmoother& param2) = 0;
+
+    /* Run the model in-place over 2 buffers, each with its own recurrent state, stepped together over the same weights.
+       Needs a model loaded in stereo mode, otherwise the left channel is processed and copied into the right one. */
+    virtual void processStereo(float* left, float* right, uint32_t numSamples,
+                               LinearValueSmoother& param1, LinearValueSmoother& param2) = 0;
+
+    /* Reset internal (recurrent) state, of both channels in stereo mode */
+    virtual void reset() = 0;
+};
+
+/* Parse a json model using the best model kernel for the running CPU, returns null on error.
+   Stereo mode sets up a second recurrent state for processStereo().
+   Reduced precision only applies to single recurrent layer models, others always run at full precision. */
+DynamicModel* loadDynamicModel(std::istream& jsonStream, int& input_size, bool stereo = false,
+                               ModelPrecision precision = kModelPrecisionDefault);
+
+/* Load a json or binary (.aidax) model file, json files are transparently cached in binary form.
+   Weights are shared with all models loaded from the same contents, only the first load parses the file. */
+DynamicModel* loadDynamicModelFromFile(const char* filename, int& input_size, bool stereo = false,
+                                       ModelPrecision precision = kModelPrecisionDefault);
+
+/* Same for json contents in memory */
+DynamicModel* loadDynamicModelFromMemory(const void* data, size_t dataSize, int& input_size, bool stereo = false,
+                                         ModelPrecision precision = kModelPrecisionDefault);
+
+/* Name of the model kernel in use, selected once per process */
+const char* getModelKernelName();
+
+/* Size of the binary weights a model was created from, 0 for models without them (not built-in architectures) */
+size_t getModelWeightsSize(const DynamicModel* model) noexcept;
+
+/* Names used by the model "precision" key: "float", "bf16" and "int8" */
+const char* getModelPrecisionName(ModelPrecision precision) noexcept;
+bool parseModelPrecision(const char* name, ModelPrecision& precision) noexcept;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Many independent streams through the same model, e.g. for hosting lots of sessions that share a few models.
+// All streams are advanced together, so each weight is loaded once per sample for all of them.
+// Supports single GRU or LSTM layer models, the same ones that can be stored as binary models.
+
+struct BatchedModel {
+    int input_size = 0;
+
+    /* Shared weights, used in place by the batched model */
+    std::shared_ptr<const SharedModelWeights> weights;
+
+    virtual ~BatchedModel() {}
+
+    /* Add a stream with reset state, returns its id or -1 if all slots are in use, realtime safe */
+    virtual int addStream() = 0;
+
+    /* Remove a stream, its id can be given out again by addStream(), realtime safe */
+    virtual void removeStream(int stream) = 0;
+
+    /* Reset the recurrent state of a stream, to the model initial state if it has one or to zeros */
+    virtual void resetStream(int stream) = 0;
+
+    /* Set the conditioning values of a stream, ramped to over the next processed block.
+       The first call after addStream() or resetStream() sets them right away instead, call it before processing. */
+    virtual void setStreamParameters(int stream, float param1, float param2) = 0;
+
+    /* Run every added stream in-place over a block, @a buffers is indexed by stream id */
+    virtual void process(float* const* buffers, uint32_t numSamples) = 0;
+
+    virtual uint32_t getNumStreams() const noexcept = 0;
+    virtual uint32_t getMaxStreams() const noexcept = 0;
+};
+
+/* Same as loadDynamicModel and loadDynamicModelFromFile, with slots for up to @a maxStreams streams.
+   Batched models always run at full precision, their weights are already loaded once for all streams. */
+BatchedModel* loadBatchedModel(std::istream& jsonStream, uint32_t maxStreams);
+BatchedModel* loadBatchedModelFromFile(const char* filename, uint32_t maxStreams);
+
+// --------------------------------------------------------------------------------------------------------------------
+// This function carries model calculations
+
+static inline void applyModel(DynamicModel* const model, float* const out, const uint32_t numSamples,
+                              LinearValueSmoother& param1, LinearValueSmoother& param2)
+{
+    model->process(out, numSamples, param1, param2);
+}
+
+static inline void applyModel(DynamicModel* const model, float* const outs[kNumDSPChannels], const uint32_t numSamples,
+                              LinearValueSmoother& param1, LinearValueSmoother& param2)
+{
+    if constexpr (kNumDSPChannels == 2)
+        model->processStereo(outs[0], outs[1], numSamples, param1, param2);
+    else
+        model->process(outs[0], numSamples, param1, param2);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reset model internal state
+
+static inline void resetModel(DynamicModel* const model)
+{
+    model->reset();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,418 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "extra/Mutex.hpp"
+#include "extra/RingBuffer.hpp"
+#include "extra/String.hpp"
+
+#include "Threading.hpp"
+
+#if AIDAX_THREADS
+# include "Semaphore.hpp"
+# include "extra/Thread.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "dr_flac.h"
+#include "dr_wav.h"
+// -Wunused-variable
+#include "CDSPResampler.h"
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Amount of audio kept decoded ahead of playback, in seconds */
+static constexpr const double kAudioFileBufferTime = 2.0;
+
+/* Number of file frames decoded at once */
+static constexpr const uint32_t kAudioFileChunkFrames = 4096;
+
+// --------------------------------------------------------------------------------------------------------------------
+// An open WAV or FLAC file, decoded and resampled chunk by chunk into a ring buffer.
+// Only the left channel is used, and playback loops back to the start of the file when reaching its end.
+// fill() is called from the reader thread while read() is called from the audio thread.
+
+class AudioFileStream
+{
+    drwav wav;
+    drflac* flac = nullptr;
+    bool wavOpen = false;
+    uint channels = 0;
+    std::unique_ptr<r8b::CDSPResampler24> resampler;
+    std::vector<float> decodeBuffer;
+    std::vector<double> resampleBuffer;
+    std::vector<float> outputBuffer;
+    uint32_t maxOutputFrames = kAudioFileChunkFrames;
+    HeapRingBuffer ring;
+
+    AudioFileStream() = default;
+
+public:
+    ~AudioFileStream()
+    {
+        if (wavOpen)
+            drwav_uninit(&wav);
+        if (flac != nullptr)
+            drflac_close(flac);
+
+        ring.deleteBuffer();
+    }
+
+    /* Open a file for streaming at @a hostSampleRate, and decode its first chunks */
+    static AudioFileStream* open(const char* const filename, const double hostSampleRate)
+    {
+        std::unique_ptr<AudioFileStream> stream(new AudioFileStream());
+        uint sampleRate;
+
+        if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
+        {
+            stream->flac = drflac_open_file(filename, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(stream->flac != nullptr, nullptr);
+
+            stream->channels = stream->flac->channels;
+            sampleRate = stream->flac->sampleRate;
+        }
+        else
+        {
+            stream->wavOpen = drwav_init_file(&stream->wav, filename, nullptr);
+            DISTRHO_SAFE_ASSERT_RETURN(stream->wavOpen, nullptr);
+
+            stream->channels = stream->wav.channels;
+            sampleRate = stream->wav.sampleRate;
+        }
+
+        DISTRHO_SAFE_ASSERT_RETURN(stream->channels != 0 && sampleRate != 0, nullptr);
+
+        if (sampleRate != hostSampleRate)
+        {
+            stream->resampler.reset(new r8b::CDSPResampler24(sampleRate, hostSampleRate, kAudioFileChunkFrames));
+            stream->resampleBuffer.resize(kAudioFileChunkFrames);
+            stream->maxOutputFrames = stream->resampler->getMaxOutLen(kAudioFileChunkFrames);
+        }
+
+        stream->decodeBuffer.resize(kAudioFileChunkFrames * stream->channels);
+        stream->outputBuffer.resize(stream->maxOutputFrames);
+
+        const uint32_t ringFrames = std::max<uint32_t>(hostSampleRate * kAudioFileBufferTime, stream->maxOutputFrames * 4);
+        DISTRHO_SAFE_ASSERT_RETURN(stream->ring.createBuffer(sizeof(float) * ringFrames), nullptr);
+
+        stream->fill();
+        return stream.release();
+    }
+
+   /**
+      Decode and resample file chunks until the ring buffer is full, or until @a maxChunks chunks were decoded.
+      Returns false if the file has no audio to read.
+    */
+    bool fill(uint32_t maxChunks = UINT32_MAX)
+    {
+        while (maxChunks-- != 0 && ring.getWritableDataSize() >= sizeof(float) * maxOutputFrames)
+        {
+            uint32_t numFrames = decode();
+
+            // loop back to start
+            if (numFrames == 0)
+            {
+                if (! rewind() || (numFrames = decode()) == 0)
+                    return false;
+            }
+
+            int numOutputFrames;
+
+            if (resampler != nullptr)
+            {
+                for (uint32_t i = 0; i < numFrames; ++i)
+                    resampleBuffer[i] = decodeBuffer[i * channels];
+
+                double* resampled;
+                numOutputFrames = resampler->process(resampleBuffer.data(), numFrames, resampled);
+
+                for (int i = 0; i < numOutputFrames; ++i)
+                    outputBuffer[i] = resampled[i];
+            }
+            else
+            {
+                numOutputFrames = numFrames;
+
+                for (uint32_t i = 0; i < numFrames; ++i)
+                    outputBuffer[i] = decodeBuffer[i * channels];
+            }
+
+            if (numOutputFrames <= 0)
+                continue;
+
+            DISTRHO_SAFE_ASSERT_RETURN(ring.writeCustomData(outputBuffer.data(), sizeof(float) * numOutputFrames), false);
+            ring.commitWrite();
+        }
+
+        return true;
+    }
+
+    /* Check if the ring buffer dropped below half its size, meaning a fill() is due */
+    bool needsFill() noexcept
+    {
+        return ring.getReadableDataSize() < ring.getSize() / 2;
+    }
+
+   /**
+      Read up to @a numFrames frames of decoded audio, filling the rest of @a buffer with silence.
+      Returns the number of frames read.
+    */
+    uint32_t read(float* const buffer, const uint32_t numFrames) noexcept
+    {
+        uint32_t numReadableFrames = std::min<uint32_t>(numFrames, ring.getReadableDataSize() / sizeof(float));
+
+        if (numReadableFrames != 0 && ! ring.readCustomData(buffer, sizeof(float) * numReadableFrames))
+            numReadableFrames = 0;
+
+        if (numReadableFrames != numFrames)
+            std::memset(buffer + numReadableFrames, 0, sizeof(float) * (numFrames - numReadableFrames));
+
+        return numReadableFrames;
+    }
+
+private:
+    uint32_t decode()
+    {
+        if (flac != nullptr)
+            return drflac_read_pcm_frames_f32(flac, kAudioFileChunkFrames, decodeBuffer.data());
+
+        return drwav_read_pcm_frames_f32(&wav, kAudioFileChunkFrames, decodeBuffer.data());
+    }
+
+    bool rewind()
+    {
+        if (flac != nullptr)
+            return drflac_seek_to_pcm_frame(flac, 0);
+
+        return drwav_seek_to_pcm_frame(&wav, 0);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(AudioFileStream)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Streams audio files for playback from a background thread, handing each opened file over to the audio thread
+// through an atomic pointer. Works like AsyncCabinetLoader, replaced streams are sent back through a ring buffer and
+// deleted on the reader thread, which also keeps refilling the stream in use when woken up by the audio thread.
+// Without threads (wasm builds without pthreads) files are opened when requested, and streams refilled from the
+// audio thread.
+
+class AsyncAudioFileReader
+#if AIDAX_THREADS
+    : private Thread
+#endif
+{
+    struct Request {
+        String filename;
+        double sampleRate = 0.0;
+    };
+
+    Mutex requestMutex;
+    Request request;
+    bool requestPending = false;
+
+    std::atomic<AudioFileStream*> preparedStream { nullptr };
+    HeapRingBuffer retiredStreams;
+
+    // owned by the reader thread, latest stream opened and the one being refilled
+    AudioFileStream* fillingStream = nullptr;
+
+    // owned by the audio thread
+    AudioFileStream* playingStream = nullptr;
+
+   #if AIDAX_THREADS
+    Semaphore semReaderWakeup;
+   #endif
+
+public:
+    AsyncAudioFileReader()
+       #if AIDAX_THREADS
+        : Thread("AsyncAudioFileReader"),
+          semReaderWakeup(0)
+       #endif
+    {
+        retiredStreams.createBuffer(sizeof(AudioFileStream*) * 16);
+
+       #if AIDAX_THREADS
+        startThread();
+       #endif
+    }
+
+    ~AsyncAudioFileReader()
+    {
+       #if AIDAX_THREADS
+        signalThreadShouldExit();
+        semReaderWakeup.post();
+        stopThread(5000);
+       #endif
+
+        delete preparedStream.exchange(nullptr);
+        delete playingStream;
+        deleteRetiredStreams();
+        retiredStreams.deleteBuffer();
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Non-realtime calls */
+
+   /**
+      Set the sample rate files are resampled to.
+      The current file is opened again in the background if the sample rate changes.
+    */
+    void setSampleRate(const double sampleRate)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+
+            if (d_isEqual(request.sampleRate, sampleRate))
+                return;
+
+            request.sampleRate = sampleRate;
+
+            if (request.filename.isEmpty())
+                return;
+
+            requestPending = true;
+        }
+
+        wakeup();
+    }
+
+   /**
+      Request a file to be opened in the background, replacing the one currently playing once its first chunks are
+      decoded.
+    */
+    void requestFile(const char* const filename)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(filename != nullptr && filename[0] != '\0',);
+
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename = filename;
+            requestPending = true;
+        }
+
+        wakeup();
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Realtime calls, only to be used from the audio thread */
+
+   /**
+      Read @a numFrames frames from the playing file into @a buffer, picking up a newly opened file first.
+      Returns false if there is no file to play, in which case @a buffer is left untouched.
+      Missing frames, if the reader does not keep up, are filled with silence.
+    */
+    bool read(float* const buffer, const uint32_t numFrames) noexcept
+    {
+        if (retiredStreams.getWritableDataSize() >= sizeof(AudioFileStream*))
+        {
+            if (AudioFileStream* const stream = preparedStream.exchange(nullptr))
+            {
+                if (playingStream != nullptr && playingStream != stream)
+                {
+                    retiredStreams.writeCustomType(playingStream);
+                    retiredStreams.commitWrite();
+                }
+
+                playingStream = stream;
+            }
+        }
+
+        if (playingStream == nullptr)
+            return false;
+
+        playingStream->read(buffer, numFrames);
+
+        if (playingStream->needsFill())
+            wakeup();
+
+        return true;
+    }
+
+private:
+    void wakeup()
+    {
+       #if AIDAX_THREADS
+        semReaderWakeup.post();
+       #else
+        deleteRetiredStreams();
+        processRequest();
+
+        // spread decoding over several audio blocks
+        if (fillingStream != nullptr)
+            fillingStream->fill(1);
+       #endif
+    }
+
+    void deleteRetiredStreams()
+    {
+        AudioFileStream* stream;
+
+        while (retiredStreams.isDataAvailableForReading() && retiredStreams.readCustomType(stream))
+            delete stream;
+    }
+
+    void processRequest()
+    {
+        Request req;
+        {
+            const MutexLocker cml(requestMutex);
+
+            if (! requestPending)
+                return;
+
+            req = request;
+            requestPending = false;
+        }
+
+        d_stdout("Loading filename %s", req.filename.buffer());
+
+        AudioFileStream* const stream = AudioFileStream::open(req.filename, req.sampleRate);
+
+        if (stream == nullptr)
+            return;
+
+        fillingStream = stream;
+
+        // a previously opened stream that was never taken can be deleted right away
+        delete preparedStream.exchange(stream);
+    }
+
+   #if AIDAX_THREADS
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            semReaderWakeup.wait();
+
+            if (shouldThreadExit())
+                break;
+
+            deleteRetiredStreams();
+            processRequest();
+
+            if (fillingStream != nullptr)
+                fillingStream->fill();
+        }
+    }
+   #endif
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AsyncAudioFileReader)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
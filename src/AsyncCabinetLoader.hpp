@@ -0,0 +1,517 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AidaDSP.hpp"
+#include "Files.hpp"
+#include "PartitionedConvolver.hpp"
+#include "Threading.hpp"
+
+#include "extra/Mutex.hpp"
+#include "extra/RingBuffer.hpp"
+#include "extra/String.hpp"
+
+#if AIDAX_THREADS
+# include "Semaphore.hpp"
+# include "extra/Thread.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "dr_flac.h"
+#include "dr_wav.h"
+// -Wunused-variable
+#include "CDSPResampler.h"
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Process-wide cache of resampled cabinet IRs, keyed by file path, modification time and sample rate.
+// Silent tails are trimmed before caching. The embedded default cabinet uses an empty path.
+
+class CabinetIRCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<float>> IR;
+
+    static CabinetIRCache& getInstance()
+    {
+        static CabinetIRCache cache;
+        return cache;
+    }
+
+   /**
+      Get a cabinet IR resampled to @a sampleRate, reading and resampling it if not cached yet.
+      Returns null on error.
+    */
+    IR getIR(const char* const filename, const double sampleRate)
+    {
+        const bool isDefault = filename == nullptr || filename[0] == '\0';
+        int64_t mtime = 0;
+
+        if (! isDefault)
+        {
+            struct stat st;
+            if (::stat(filename, &st) != 0)
+            {
+                d_stderr2("Unable to open cabinet file: %s", filename);
+                return nullptr;
+            }
+            mtime = static_cast<int64_t>(st.st_mtime);
+        }
+
+        const uint32_t rate = static_cast<uint32_t>(sampleRate + 0.5);
+
+        {
+            const MutexLocker cml(mutex);
+
+            for (Entry& entry : entries)
+            {
+                if (entry.sampleRate == rate && entry.mtime == mtime
+                    && entry.filename == (isDefault ? "" : filename))
+                {
+                    entry.lastUse = ++useCounter;
+                    return entry.ir;
+                }
+            }
+        }
+
+        IR ir(readIR(isDefault ? nullptr : filename, sampleRate));
+
+        if (ir == nullptr)
+            return nullptr;
+
+        const MutexLocker cml(mutex);
+
+        if (entries.size() >= kMaxCachedIRs)
+        {
+            size_t oldest = 0;
+            for (size_t i = 1; i < entries.size(); ++i)
+            {
+                if (entries[i].lastUse < entries[oldest].lastUse)
+                    oldest = i;
+            }
+            entries.erase(entries.begin() + oldest);
+        }
+
+        entries.push_back({ String(isDefault ? "" : filename), mtime, rate, ir, ++useCounter });
+        return ir;
+    }
+
+private:
+    /* Max number of resampled IRs kept around */
+    static constexpr const size_t kMaxCachedIRs = 16;
+
+    struct Entry {
+        String filename;
+        int64_t mtime;
+        uint32_t sampleRate;
+        IR ir;
+        uint64_t lastUse;
+    };
+
+    Mutex mutex;
+    std::vector<Entry> entries;
+    uint64_t useCounter = 0;
+
+    CabinetIRCache() {}
+
+    static std::vector<float>* readIR(const char* const filename, const double hostSampleRate)
+    {
+        uint channels;
+        uint sampleRate;
+        drwav_uint64 numFrames;
+        float* ir;
+
+        if (filename == nullptr)
+        {
+            using namespace Files;
+
+            ir = drwav_open_memory_and_read_pcm_frames_f32(V30_P2_audix_i5_deerinkstudiosData,
+                                                           V30_P2_audix_i5_deerinkstudiosDataSize,
+                                                           &channels,
+                                                           &sampleRate,
+                                                           &numFrames,
+                                                           nullptr);
+        }
+        else if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
+        {
+            ir = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+        }
+        else
+        {
+            ir = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+        }
+        DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr, nullptr);
+
+        if (channels > 1)
+        {
+            for (drwav_uint64 i=0, j=0; j<numFrames; ++i, j+=channels)
+                ir[i] = ir[j];
+            numFrames /= channels;
+        }
+
+        d_stdout("Loading cabinet with %u channels, %u Hz sample rate and %lu frames",
+                 channels, sampleRate, (ulong)numFrames);
+
+        std::vector<float>* data;
+
+        if (sampleRate != hostSampleRate)
+        {
+            r8b::CDSPResampler16IR resampler(sampleRate, hostSampleRate, numFrames);
+            const int numResampledFrames = resampler.getMaxOutLen(0);
+
+            if (numResampledFrames <= 0)
+            {
+                drwav_free(ir, nullptr);
+                return nullptr;
+            }
+
+            d_stdout("Resampling to %f Hz sample rate and %d frames",
+                     hostSampleRate, numResampledFrames);
+
+            data = new std::vector<float>(numResampledFrames);
+            resampler.oneshot(ir, numFrames, data->data(), numResampledFrames);
+        }
+        else
+        {
+            data = new std::vector<float>(ir, ir + numFrames);
+        }
+
+        drwav_free(ir, nullptr);
+
+        const size_t decayLength = getCabinetIRDecayLength(data->data(), data->size());
+
+        if (decayLength < data->size())
+        {
+            d_stdout("Trimming silent cabinet tail from %lu to %lu frames",
+                     (ulong)data->size(), (ulong)decayLength);
+
+            data->resize(decayLength);
+            fadeOutCabinetIR(data->data(), decayLength, hostSampleRate);
+        }
+
+        return data;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(CabinetIRCache)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Prepares cabinet convolvers on a background thread, handing them over to the audio thread through an atomic pointer.
+// Convolvers have one channel per DSP channel, all using the same IR.
+// Works like AsyncModelLoader, replaced convolvers are sent back through a ring buffer and deleted on the loader thread.
+// Without threads (wasm builds without pthreads) convolvers are prepared when requested, old ones deleted on the next
+// request, and a length limit change from the audio thread is handled on the next idle() call.
+
+class AsyncCabinetLoader
+#if AIDAX_THREADS
+    : private Thread
+#endif
+{
+    struct Settings {
+        String filename;
+        double sampleRate = 0.0;
+        uint32_t bufferSize = 0;
+        uint32_t maxLength = 0;
+    };
+
+    Mutex requestMutex;
+    Settings request;
+    bool requestPending = false;
+    bool requested = false;
+
+    std::atomic<uint32_t> maxLength { 0 };
+    std::atomic<bool> maxLengthChanged { false };
+
+    Mutex loadMutex;
+    std::atomic<PartitionedConvolver*> preparedCabinet { nullptr };
+    HeapRingBuffer retiredCabinets;
+
+   #if AIDAX_THREADS
+    Semaphore semLoaderWakeup;
+   #endif
+
+public:
+    AsyncCabinetLoader()
+       #if AIDAX_THREADS
+        : Thread("AsyncCabinetLoader"),
+          semLoaderWakeup(0)
+       #endif
+    {
+        retiredCabinets.createBuffer(sizeof(PartitionedConvolver*) * 16);
+
+       #if AIDAX_THREADS
+        startThread();
+       #endif
+    }
+
+    ~AsyncCabinetLoader()
+    {
+       #if AIDAX_THREADS
+        signalThreadShouldExit();
+        semLoaderWakeup.post();
+        stopThread(5000);
+       #endif
+
+        delete preparedCabinet.exchange(nullptr);
+        deleteRetiredCabinets();
+        retiredCabinets.deleteBuffer();
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Non-realtime calls */
+
+   /**
+      Set the sample rate and buffer size to prepare cabinets for, must not be called while processing.
+      The last requested cabinet is prepared again right away, to be picked up with takeCabinet().
+    */
+    void setAudioSettings(const double sampleRate, const uint32_t bufferSize)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+
+            if (d_isEqual(request.sampleRate, sampleRate) && request.bufferSize == bufferSize)
+                return;
+
+            request.sampleRate = sampleRate;
+            request.bufferSize = bufferSize;
+            requestPending = false;
+
+            if (! requested)
+                return;
+        }
+
+        prepare();
+    }
+
+   /**
+      Load a cabinet and prepare it right away, to be picked up with takeCabinet().
+      A null or empty @a filename loads the default cabinet.
+    */
+    void loadCabinet(const char* const filename)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename = filename != nullptr ? filename : "";
+            requestPending = false;
+            requested = true;
+        }
+
+        prepare();
+    }
+
+   /**
+      Request a cabinet to be prepared in the background, replacing any previous request that has not started yet.
+      A null or empty @a filename loads the default cabinet.
+    */
+    void requestCabinet(const char* const filename)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename = filename != nullptr ? filename : "";
+            requestPending = true;
+            requested = true;
+        }
+
+        wakeup();
+    }
+
+   /**
+      Handle what realtime calls left for later, on builds without threads.
+      Must be called regularly from outside of audio processing, does nothing when there are threads.
+    */
+    void idle()
+    {
+       #if ! AIDAX_THREADS
+        deleteRetiredCabinets();
+
+        if (maxLengthChanged.load())
+            processRequest();
+       #endif
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Realtime calls, only to be used from the audio thread (or while not processing) */
+
+   /**
+      Limit cabinet IRs to @a ms milliseconds, 0 for no limit.
+      The current cabinet is prepared again in the background if the limit changes, or on the next idle() call
+      without threads.
+    */
+    void setMaxLength(const uint32_t ms) noexcept
+    {
+        if (maxLength.exchange(ms) == ms)
+            return;
+
+        maxLengthChanged.store(true);
+
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #endif
+    }
+
+   /**
+      Take the most recently prepared cabinet, if any.
+      The caller owns the returned convolver, and must give it back through retireCabinet() when replaced.
+    */
+    PartitionedConvolver* takeCabinet() noexcept
+    {
+        return preparedCabinet.exchange(nullptr);
+    }
+
+   /**
+      Check if there is room for retiring @a count cabinets without blocking.
+    */
+    bool canRetireCabinets(const uint32_t count) noexcept
+    {
+        return retiredCabinets.getWritableDataSize() >= sizeof(PartitionedConvolver*) * count;
+    }
+
+   /**
+      Hand a replaced cabinet back to be deleted outside the audio thread.
+      Check canRetireCabinets() before taking a new cabinet, this call must not fail.
+    */
+    void retireCabinet(PartitionedConvolver* const cabinet) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(cabinet != nullptr,);
+        DISTRHO_SAFE_ASSERT_RETURN(retiredCabinets.writeCustomType(cabinet),);
+
+        retiredCabinets.commitWrite();
+
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #endif
+    }
+
+private:
+    static PartitionedConvolver* createCabinet(const Settings& settings)
+    {
+        const CabinetIRCache::IR ir(CabinetIRCache::getInstance().getIR(settings.filename, settings.sampleRate));
+
+        if (ir == nullptr)
+            return nullptr;
+
+        std::unique_ptr<PartitionedConvolver> cabinet(new PartitionedConvolver());
+        const size_t maxFrames = static_cast<size_t>(settings.sampleRate * settings.maxLength / 1000.0);
+        bool ok;
+
+        if (maxFrames != 0 && maxFrames < ir->size())
+        {
+            std::vector<float> cut(ir->begin(), ir->begin() + maxFrames);
+            fadeOutCabinetIR(cut.data(), maxFrames, settings.sampleRate);
+            ok = cabinet->init(cut.data(), maxFrames, settings.bufferSize, kNumDSPChannels);
+        }
+        else
+        {
+            ok = cabinet->init(ir->data(), ir->size(), settings.bufferSize, kNumDSPChannels);
+        }
+
+        if (! ok)
+        {
+            d_stderr2("Unable to initialize cabinet convolver");
+            return nullptr;
+        }
+
+        return cabinet.release();
+    }
+
+    /* Prepare the last requested cabinet, dropping any taken from older settings */
+    void prepare()
+    {
+        const MutexLocker cml(loadMutex);
+
+        Settings settings;
+        {
+            const MutexLocker cml2(requestMutex);
+            settings = request;
+        }
+
+        maxLengthChanged.store(false);
+        settings.maxLength = maxLength.load();
+
+        delete preparedCabinet.exchange(createCabinet(settings));
+    }
+
+    void wakeup()
+    {
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #else
+        deleteRetiredCabinets();
+        processRequest();
+       #endif
+    }
+
+    void deleteRetiredCabinets()
+    {
+        PartitionedConvolver* cabinet;
+
+        while (retiredCabinets.isDataAvailableForReading() && retiredCabinets.readCustomType(cabinet))
+            delete cabinet;
+    }
+
+    void processRequest()
+    {
+        const MutexLocker cml(loadMutex);
+
+        Settings settings;
+        {
+            const MutexLocker cml2(requestMutex);
+
+            // a new length limit applies to the last requested cabinet
+            if (maxLengthChanged.exchange(false) && requested)
+                requestPending = true;
+
+            if (! requestPending)
+                return;
+
+            settings = request;
+            requestPending = false;
+        }
+
+        settings.maxLength = maxLength.load();
+
+        PartitionedConvolver* const cabinet = createCabinet(settings);
+
+        if (cabinet == nullptr)
+            return;
+
+        // a previously prepared cabinet that was never taken can be deleted right away
+        delete preparedCabinet.exchange(cabinet);
+    }
+
+   #if AIDAX_THREADS
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            semLoaderWakeup.wait();
+
+            if (shouldThreadExit())
+                break;
+
+            deleteRetiredCabinets();
+            processRequest();
+        }
+    }
+   #endif
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AsyncCabinetLoader)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
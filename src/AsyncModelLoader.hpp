@@ -0,0 +1,584 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AidaDSP.hpp"
+#include "ResampledModel.hpp"
+#include "Threading.hpp"
+
+#include "extra/Mutex.hpp"
+#include "extra/RingBuffer.hpp"
+#include "extra/String.hpp"
+
+#if AIDAX_THREADS
+# include "Semaphore.hpp"
+# include "extra/Thread.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Loads and pre-buffers models on a background thread, handing them over to the audio thread through an atomic pointer.
+// Models replaced by the audio thread are sent back through a ring buffer and deleted on the loader thread.
+// Without threads (wasm builds without pthreads) models are prepared when requested, old ones deleted on the next
+// request, and a model rate change from the audio thread is handled on the next idle() call.
+// Models can optionally run at the sample rate they were trained at, see ResampledModel.
+//
+// Model bank slots are loaded the same way, each with its own atomic pointer, see ModelBank.
+// Bank models count against a memory budget by the size of their binary weights, measured once loaded (json models
+// are converted to those), or by the size of their file for models without them. Slots going over it are left empty.
+// AIDAX_MODEL_BANK_MEMORY sets the budget in MiB, 64 by default.
+
+class AsyncModelLoader
+#if AIDAX_THREADS
+    : private Thread
+#endif
+{
+    struct Request {
+        String filename;
+        const void* data = nullptr;
+        size_t dataSize = 0;
+        float param1 = 0.f;
+        float param2 = 0.f;
+        double sampleRate = 0.0;
+    };
+
+    Mutex requestMutex;
+    Request request;
+    bool requestPending = false;
+    bool requested = false;
+
+    std::atomic<bool> modelRate { false };
+    std::atomic<bool> modelRateChanged { false };
+
+    // bank slot files, protected by requestMutex
+    String bankFiles[kModelBankSlots];
+    bool bankPending = false;
+
+    // bank slot files currently prepared and their size against the memory budget, protected by loadMutex
+    String loadedBankFiles[kModelBankSlots];
+    size_t loadedBankSizes[kModelBankSlots] = {};
+    size_t bankMemoryBudget = 0;
+
+    Mutex loadMutex;
+    std::atomic<DynamicModel*> preparedModel { nullptr };
+    std::atomic<DynamicModel*> preparedBankModels[kModelBankSlots];
+    std::atomic<uint32_t> clearedBankSlots { 0 };
+    HeapRingBuffer retiredModels;
+
+   #if AIDAX_THREADS
+    Semaphore semLoaderWakeup;
+   #endif
+
+public:
+    AsyncModelLoader()
+       #if AIDAX_THREADS
+        : Thread("AsyncModelLoader"),
+          semLoaderWakeup(0)
+       #endif
+    {
+        for (uint32_t i = 0; i < kModelBankSlots; ++i)
+            preparedBankModels[i].store(nullptr);
+
+        const char* const memory = std::getenv("AIDAX_MODEL_BANK_MEMORY");
+        bankMemoryBudget = static_cast<size_t>(std::max(0, memory != nullptr ? std::atoi(memory) : 64)) << 20;
+
+        retiredModels.createBuffer(sizeof(DynamicModel*) * 32);
+
+       #if AIDAX_THREADS
+        startThread();
+       #endif
+    }
+
+    ~AsyncModelLoader()
+    {
+       #if AIDAX_THREADS
+        signalThreadShouldExit();
+        semLoaderWakeup.post();
+        stopThread(5000);
+       #endif
+
+        delete preparedModel.exchange(nullptr);
+        for (uint32_t i = 0; i < kModelBankSlots; ++i)
+            delete preparedBankModels[i].exchange(nullptr);
+        deleteRetiredModels();
+        retiredModels.deleteBuffer();
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Non-realtime calls */
+
+   /**
+      Set the host sample rate models are prepared for, must not be called while processing.
+      If the last requested model runs at its training sample rate, it is prepared again right away, to be picked up
+      with takeModel(), and so are bank models.
+    */
+    void setSampleRate(const double sampleRate)
+    {
+        bool withModel, withBank;
+
+        {
+            const MutexLocker cml(requestMutex);
+
+            if (d_isEqual(request.sampleRate, sampleRate))
+                return;
+
+            request.sampleRate = sampleRate;
+
+            if (! modelRate.load())
+                return;
+
+            withModel = requested;
+            withBank = bankPending || hasBankFiles();
+            requestPending = false;
+            bankPending = false;
+        }
+
+        if (withModel)
+            prepare();
+        if (withBank)
+            prepareBank(true);
+    }
+
+   /**
+      Load a model and pre-buffer it right away, to be picked up with takeModel().
+      @a param1 and @a param2 are the values used for conditioned models while pre-buffering.
+    */
+    void loadModel(const void* const data, const size_t dataSize, const float param1, const float param2)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename.clear();
+            request.data = data;
+            request.dataSize = dataSize;
+            request.param1 = param1;
+            request.param2 = param2;
+            requestPending = false;
+            requested = true;
+        }
+
+        prepare();
+    }
+
+   /**
+      Request a model to be loaded in the background, replacing any previous request that has not started yet.
+    */
+    void requestModel(const char* const filename, const float param1, const float param2)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename = filename;
+            request.data = nullptr;
+            request.dataSize = 0;
+            request.param1 = param1;
+            request.param2 = param2;
+            requestPending = true;
+            requested = true;
+        }
+
+        wakeup();
+    }
+
+    void requestModel(const void* const data, const size_t dataSize, const float param1, const float param2)
+    {
+        {
+            const MutexLocker cml(requestMutex);
+            request.filename.clear();
+            request.data = data;
+            request.dataSize = dataSize;
+            request.param1 = param1;
+            request.param2 = param2;
+            requestPending = true;
+            requested = true;
+        }
+
+        wakeup();
+    }
+
+   /**
+      Request model bank slots to be loaded in the background, from a list of model files, one per line.
+      Slots whose file did not change are left as they are, slots without a file are cleared.
+    */
+    void requestBankModels(const char* const fileList)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(fileList != nullptr,);
+
+        {
+            const MutexLocker cml(requestMutex);
+            const char* s = fileList;
+
+            for (uint32_t i = 0; i < kModelBankSlots; ++i)
+            {
+                const char* const end = std::strchr(s, '\n');
+                size_t len = end != nullptr ? static_cast<size_t>(end - s) : std::strlen(s);
+
+                // tolerate windows line endings and trailing spaces
+                while (len != 0 && std::isspace(static_cast<unsigned char>(s[len - 1])))
+                    --len;
+
+                bankFiles[i] = String(std::string(s, len).c_str());
+                s = end != nullptr ? end + 1 : s + len;
+            }
+
+            bankPending = true;
+        }
+
+        wakeup();
+    }
+
+   /**
+      Handle what realtime calls left for later, on builds without threads.
+      Must be called regularly from outside of audio processing, does nothing when there are threads.
+    */
+    void idle()
+    {
+       #if ! AIDAX_THREADS
+        deleteRetiredModels();
+
+        if (modelRateChanged.load())
+            processRequest();
+       #endif
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Realtime calls, only to be used from the audio thread (or while not processing) */
+
+   /**
+      Run models at the sample rate they were trained at, when known and lower than the host one.
+      The current model is prepared again in the background if this changes, or on the next idle() call without
+      threads.
+    */
+    void setModelRate(const bool enabled) noexcept
+    {
+        if (modelRate.exchange(enabled) == enabled)
+            return;
+
+        modelRateChanged.store(true);
+
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #endif
+    }
+
+   /**
+      Take the most recently prepared model, if any.
+      The caller owns the returned model, and must give it back through retireModel() when replaced.
+    */
+    DynamicModel* takeModel() noexcept
+    {
+        return preparedModel.exchange(nullptr);
+    }
+
+   /**
+      Same for a model bank slot, from 0 to kModelBankSlots - 1.
+    */
+    DynamicModel* takeBankModel(const uint32_t slot) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSlots, nullptr);
+
+        return preparedBankModels[slot].exchange(nullptr);
+    }
+
+   /**
+      Take the bank slots cleared since the last call, as a bit per slot.
+      Must be handled before taking bank models, as a slot may have been cleared and loaded again.
+    */
+    uint32_t takeClearedBankSlots() noexcept
+    {
+        return clearedBankSlots.exchange(0);
+    }
+
+   /**
+      Check if there is room for retiring @a count models without blocking.
+    */
+    bool canRetireModels(const uint32_t count) noexcept
+    {
+        return retiredModels.getWritableDataSize() >= sizeof(DynamicModel*) * count;
+    }
+
+   /**
+      Hand a replaced model back to be deleted outside the audio thread.
+      Check canRetireModels() before taking a new model, this call must not fail.
+    */
+    void retireModel(DynamicModel* const model) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(model != nullptr,);
+        DISTRHO_SAFE_ASSERT_RETURN(retiredModels.writeCustomType(model),);
+
+        retiredModels.commitWrite();
+
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #endif
+    }
+
+private:
+    static DynamicModel* createModel(const Request& req, const bool resampled)
+    {
+        int input_size = 0;
+        DynamicModel* newmodel = nullptr;
+
+        try {
+            newmodel = req.data != nullptr
+                     ? loadDynamicModelFromMemory(req.data, req.dataSize, input_size, kNumDSPChannels == 2)
+                     : loadDynamicModelFromFile(req.filename, input_size, kNumDSPChannels == 2);
+        }
+        catch (const std::exception& e) {
+            if (req.data != nullptr)
+                d_stderr2("Unable to load json, error: %s", e.what());
+            else
+                d_stderr2("Unable to load model file: %s\nError: %s", req.filename.buffer(), e.what());
+        };
+
+        if (newmodel == nullptr)
+            return nullptr;
+
+        if (resampled && ResampledModel::isNeeded(newmodel, req.sampleRate))
+        {
+            std::unique_ptr<ResampledModel> wrapper(new ResampledModel(newmodel, req.sampleRate, kNumDSPChannels == 2));
+
+            if (wrapper->latency < kMaxModelLatency)
+            {
+                d_stdout("Running model at %u Hz, with %u frames of latency", newmodel->sample_rate, wrapper->latency);
+                newmodel = wrapper.release();
+            }
+            else
+            {
+                d_stderr2("Model sample rate conversion needs too much latency, running at the host sample rate");
+                newmodel = wrapper->releaseModel();
+            }
+        }
+
+        return prebufferModel(newmodel, req.param1, req.param2);
+    }
+
+    static DynamicModel* prebufferModel(DynamicModel* const model, const float param1, const float param2)
+    {
+        std::unique_ptr<DynamicModel> newmodel(model);
+
+        if (newmodel == nullptr)
+            return nullptr;
+
+        // already starts from where silence leaves it
+        if (newmodel->settled_reset)
+            return newmodel.release();
+
+        LinearValueSmoother prebufferParam1, prebufferParam2;
+        prebufferParam1.setTargetValue(param1);
+        prebufferParam1.clearToTargetValue();
+        prebufferParam2.setTargetValue(param2);
+        prebufferParam2.clearToTargetValue();
+
+        // Pre-buffer to avoid "clicks" during initialization
+        float out[kNumDSPChannels][2048] = {};
+        float* outs[kNumDSPChannels];
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            outs[c] = out[c];
+
+        applyModel(newmodel.get(), outs, ARRAY_SIZE(out[0]), prebufferParam1, prebufferParam2);
+
+        return newmodel.release();
+    }
+
+    bool hasBankFiles() const noexcept
+    {
+        for (uint32_t i = 0; i < kModelBankSlots; ++i)
+        {
+            if (bankFiles[i].isNotEmpty())
+                return true;
+        }
+
+        return false;
+    }
+
+    static size_t getFileSize(const char* const filename)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        return file.good() ? static_cast<size_t>(file.tellg()) : 0;
+    }
+
+   /**
+      Prepare the requested bank slots, only those whose file changed unless @a all is set.
+      Takes loadMutex, so bank slots and the main model are never prepared at the same time.
+    */
+    void prepareBank(const bool all)
+    {
+        const MutexLocker cml(loadMutex);
+
+        Request req;
+        String files[kModelBankSlots];
+        {
+            const MutexLocker cml2(requestMutex);
+            req = request;
+
+            for (uint32_t i = 0; i < kModelBankSlots; ++i)
+                files[i] = bankFiles[i];
+        }
+
+        const bool resampled = modelRate.load();
+        size_t memoryUsed = 0;
+
+        for (uint32_t i = 0; i < kModelBankSlots; ++i)
+        {
+            DynamicModel* newmodel = nullptr;
+            size_t modelSize = loadedBankSizes[i];
+
+            if (all || files[i] != loadedBankFiles[i])
+            {
+                modelSize = 0;
+
+                if (files[i].isNotEmpty())
+                {
+                    req.filename = files[i];
+                    req.data = nullptr;
+                    req.dataSize = 0;
+
+                    newmodel = createModel(req, resampled);
+
+                    if (newmodel != nullptr)
+                    {
+                        modelSize = getModelWeightsSize(newmodel);
+
+                        if (modelSize == 0)
+                            modelSize = getFileSize(files[i]);
+                    }
+                }
+            }
+
+            if (memoryUsed + modelSize > bankMemoryBudget)
+            {
+                d_stderr2("Model bank memory budget exceeded, skipping slot %u: %s", i + 1, files[i].buffer());
+                delete newmodel;
+                newmodel = nullptr;
+                modelSize = 0;
+                files[i].clear();
+            }
+
+            memoryUsed += modelSize;
+
+            if (! all && files[i] == loadedBankFiles[i])
+                continue;
+
+            loadedBankFiles[i] = files[i];
+            loadedBankSizes[i] = modelSize;
+
+            if (newmodel != nullptr)
+            {
+                delete preparedBankModels[i].exchange(newmodel);
+            }
+            else
+            {
+                delete preparedBankModels[i].exchange(nullptr);
+                clearedBankSlots.fetch_or(1u << i);
+            }
+        }
+    }
+
+    /* Prepare the last requested model, dropping any taken from older settings */
+    void prepare()
+    {
+        const MutexLocker cml(loadMutex);
+
+        Request req;
+        {
+            const MutexLocker cml2(requestMutex);
+            req = request;
+        }
+
+        modelRateChanged.store(false);
+
+        delete preparedModel.exchange(createModel(req, modelRate.load()));
+    }
+
+    void wakeup()
+    {
+       #if AIDAX_THREADS
+        semLoaderWakeup.post();
+       #else
+        deleteRetiredModels();
+        processRequest();
+       #endif
+    }
+
+    void deleteRetiredModels()
+    {
+        DynamicModel* model;
+
+        while (retiredModels.isDataAvailableForReading() && retiredModels.readCustomType(model))
+            delete model;
+    }
+
+    void processRequest()
+    {
+        bool withBank, allBank;
+
+        {
+            const MutexLocker cml(loadMutex);
+
+            Request req;
+            {
+                const MutexLocker cml2(requestMutex);
+
+                // a change of model rate applies to the last requested model, and to all bank slots
+                allBank = modelRateChanged.exchange(false);
+
+                if (allBank && requested)
+                    requestPending = true;
+
+                withBank = bankPending || (allBank && hasBankFiles());
+                bankPending = false;
+
+                if (requestPending)
+                {
+                    req = request;
+                    requestPending = false;
+                }
+            }
+
+            if (req.filename.isNotEmpty() || req.data != nullptr)
+            {
+                // a previously prepared model that was never taken can be deleted right away
+                if (DynamicModel* const newmodel = createModel(req, modelRate.load()))
+                    delete preparedModel.exchange(newmodel);
+            }
+        }
+
+        if (withBank)
+            prepareBank(allBank);
+    }
+
+   #if AIDAX_THREADS
+    void run() override
+    {
+        while (! shouldThreadExit())
+        {
+            semLoaderWakeup.wait();
+
+            if (shouldThreadExit())
+                break;
+
+            deleteRetiredModels();
+            processRequest();
+        }
+    }
+   #endif
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AsyncModelLoader)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,309 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "BiquadCascade.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Coefficient tolerance for detecting unity-gain sections */
+static constexpr const double kBiquadUnityThreshold = 1e-9;
+
+/* State below which a unity-gain section is considered settled and gets skipped */
+static constexpr const float kBiquadSettledThreshold = 1e-9f;
+
+/* Coefficient changes are ramped over kBiquadRampTime, in steps of kBiquadRampStepFrames */
+static constexpr const double kBiquadRampTime = 0.02;
+static constexpr const uint32_t kBiquadRampStepFrames = 32;
+
+static uint32_t getBiquadRampSteps(const double sampleRate) noexcept
+{
+    return std::max<uint32_t>(1, static_cast<uint32_t>(kBiquadRampTime * sampleRate / kBiquadRampStepFrames + 0.5));
+}
+
+BiquadCascade::BiquadCascade() noexcept
+    : rampSteps(getBiquadRampSteps(48000.0))
+{
+    std::memset(sections, 0, sizeof(sections));
+    std::memset(targets, 0, sizeof(targets));
+
+    for (uint32_t i = 0; i < kMaxSections; ++i)
+    {
+        a0[i] = 1.f;
+        a1[i] = a2[i] = b1[i] = b2[i] = 0.f;
+        z1[i] = z2[i] = 0.f;
+        targets[i].a0 = 1.f;
+        activeSections[i] = 0;
+    }
+}
+
+void BiquadCascade::setSampleRate(const double sampleRate) noexcept
+{
+    rampSteps = getBiquadRampSteps(sampleRate);
+    rampStepsLeft = std::min(rampStepsLeft, rampSteps);
+}
+
+void BiquadCascade::setSection(const uint32_t index, const Biquad& filter, const bool enabled) noexcept
+{
+    DISTRHO_SAFE_ASSERT_RETURN(index < kMaxSections,);
+
+    double da0, da1, da2, db1, db2;
+    filter.getCoefficients(da0, da1, da2, db1, db2);
+
+    const bool unity = std::abs(da0 - 1.0) < kBiquadUnityThreshold
+                    && std::abs(da1 - db1) < kBiquadUnityThreshold
+                    && std::abs(da2 - db2) < kBiquadUnityThreshold;
+
+    const Coefficients target = {
+        static_cast<float>(da0),
+        static_cast<float>(da1),
+        static_cast<float>(da2),
+        static_cast<float>(db1),
+        static_cast<float>(db2),
+    };
+
+    Section& section = sections[index];
+    const bool isNew = index >= numSections;
+
+    if (! isNew && section.enabled == enabled
+        && section.target.a0 == target.a0 && section.target.a1 == target.a1 && section.target.a2 == target.a2
+        && section.target.b1 == target.b1 && section.target.b2 == target.b2)
+        return;
+
+    if (! needsUpdate)
+        storeActiveSections();
+
+    // sections that were not running start directly at the new coefficients
+    const bool ramp = ! isNew && section.enabled && enabled;
+
+    section.target = target;
+    section.enabled = enabled;
+    section.unity = unity;
+
+    if (ramp)
+        rampStepsLeft = rampSteps;
+    else
+        section.current = target;
+
+    if (isNew)
+        numSections = index + 1;
+
+    needsUpdate = true;
+}
+
+void BiquadCascade::reset() noexcept
+{
+    if (! needsUpdate)
+        storeActiveSections();
+
+    for (uint32_t i = 0; i < kMaxSections; ++i)
+    {
+        sections[i].current = sections[i].target;
+        sections[i].z1 = sections[i].z2 = 0.f;
+    }
+
+    rampStepsLeft = 0;
+    needsUpdate = true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Copy coefficients and state of the active sections back, before repacking
+
+void BiquadCascade::storeActiveSections() noexcept
+{
+    for (uint32_t i = 0; i < numActive; ++i)
+    {
+        Section& section = sections[activeSections[i]];
+        section.current = { a0[i], a1[i], a2[i], b1[i], b2[i] };
+        section.z1 = z1[i];
+        section.z2 = z2[i];
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Pack enabled sections into the processing lanes
+
+void BiquadCascade::updateActiveSections() noexcept
+{
+    numActive = 0;
+
+    for (uint32_t i = 0; i < numSections; ++i)
+    {
+        const Section& section = sections[i];
+
+        if (! section.enabled)
+            continue;
+
+        // unity-gain sections are kept until ramped and any previous response has died out
+        if (section.unity && rampStepsLeft == 0 && d_isZero(section.z1) && d_isZero(section.z2))
+            continue;
+
+        a0[numActive] = section.current.a0;
+        a1[numActive] = section.current.a1;
+        a2[numActive] = section.current.a2;
+        b1[numActive] = section.current.b1;
+        b2[numActive] = section.current.b2;
+        z1[numActive] = section.z1;
+        z2[numActive] = section.z2;
+        targets[numActive] = section.target;
+        activeSections[numActive++] = i;
+    }
+
+    needsUpdate = false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Move the coefficients one step closer to their targets.
+// Interpolating linearly keeps each section stable, as the stable region of the denominator is convex.
+
+void BiquadCascade::stepCoefficients() noexcept
+{
+    if (rampStepsLeft == 1)
+    {
+        for (uint32_t i = 0; i < numActive; ++i)
+        {
+            a0[i] = targets[i].a0;
+            a1[i] = targets[i].a1;
+            a2[i] = targets[i].a2;
+            b1[i] = targets[i].b1;
+            b2[i] = targets[i].b2;
+        }
+    }
+    else
+    {
+        const float step = 1.f / static_cast<float>(rampStepsLeft);
+
+        for (uint32_t i = 0; i < numActive; ++i)
+        {
+            a0[i] += (targets[i].a0 - a0[i]) * step;
+            a1[i] += (targets[i].a1 - a1[i]) * step;
+            a2[i] += (targets[i].a2 - a2[i]) * step;
+            b1[i] += (targets[i].b1 - b1[i]) * step;
+            b2[i] += (targets[i].b2 - b2[i]) * step;
+        }
+    }
+
+    --rampStepsLeft;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// All active sections in one pass, same transposed direct form II as Biquad::process but in float.
+// The section count is a template parameter so the inner loop is unrolled and all state stays in registers.
+// Each section only depends on its own previous sample, so the CPU overlaps consecutive sections and samples.
+
+template <uint32_t numSections>
+static void processBiquadSections(float* const out, const float* const in, const uint32_t numSamples,
+                                  const float* const a0, const float* const a1, const float* const a2,
+                                  const float* const b1, const float* const b2,
+                                  float* const z1, float* const z2) noexcept
+{
+    float ca0[numSections], ca1[numSections], ca2[numSections], cb1[numSections], cb2[numSections];
+    float s1[numSections], s2[numSections];
+
+    for (uint32_t k = 0; k < numSections; ++k)
+    {
+        ca0[k] = a0[k];
+        ca1[k] = a1[k];
+        ca2[k] = a2[k];
+        cb1[k] = b1[k];
+        cb2[k] = b2[k];
+        s1[k] = z1[k];
+        s2[k] = z2[k];
+    }
+
+    for (uint32_t i = 0; i < numSamples; ++i)
+    {
+        float x = in[i];
+
+        for (uint32_t k = 0; k < numSections; ++k)
+        {
+            const float y = x * ca0[k] + s1[k];
+            s1[k] = x * ca1[k] + s2[k] - cb1[k] * y;
+            s2[k] = x * ca2[k] - cb2[k] * y;
+            x = y;
+        }
+
+        out[i] = x;
+    }
+
+    for (uint32_t k = 0; k < numSections; ++k)
+    {
+        z1[k] = s1[k];
+        z2[k] = s2[k];
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+void BiquadCascade::processSections(float* const out, const float* const in, const uint32_t numSamples) noexcept
+{
+    switch (numActive)
+    {
+    case 1: processBiquadSections<1>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 2: processBiquadSections<2>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 3: processBiquadSections<3>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 4: processBiquadSections<4>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 5: processBiquadSections<5>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 6: processBiquadSections<6>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 7: processBiquadSections<7>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    case 8: processBiquadSections<8>(out, in, numSamples, a0, a1, a2, b1, b2, z1, z2); break;
+    }
+}
+
+void BiquadCascade::process(float* const out, const float* const in, const uint32_t numSamples) noexcept
+{
+    if (needsUpdate)
+        updateActiveSections();
+
+    if (numActive == 0)
+    {
+        rampStepsLeft = 0;
+
+        if (out != in)
+            std::memcpy(out, in, sizeof(float) * numSamples);
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < numSamples;)
+    {
+        uint32_t frames = numSamples - offset;
+
+        if (rampStepsLeft != 0)
+        {
+            stepCoefficients();
+            frames = std::min(frames, kBiquadRampStepFrames);
+        }
+
+        processSections(out + offset, in + offset, frames);
+        offset += frames;
+    }
+
+    if (rampStepsLeft != 0)
+        return;
+
+    // drop unity-gain sections once settled
+    for (uint32_t i = 0; i < numActive; ++i)
+    {
+        if (sections[activeSections[i]].unity
+            && std::abs(z1[i]) < kBiquadSettledThreshold && std::abs(z2[i]) < kBiquadSettledThreshold)
+        {
+            storeActiveSections();
+            sections[activeSections[i]].z1 = sections[activeSections[i]].z2 = 0.f;
+            needsUpdate = true;
+            break;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,97 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "Biquad.h"
+
+#include "DistrhoUtils.hpp"
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Serial chain of biquad sections, processed in a single fused pass over the buffer.
+//
+// Coefficients are designed by regular Biquad objects and copied over as floats, see setSection().
+// Changes to enabled sections are interpolated over a short ramp, stepping the coefficients every few samples.
+// Sections that are disabled or at unity gain (e.g. 0 dB shelves and peaks) are skipped.
+// Active sections are packed in a structure-of-arrays layout and run together, in float, one sample at a time.
+
+class BiquadCascade
+{
+public:
+    static constexpr const uint32_t kMaxSections = 8;
+
+    BiquadCascade() noexcept;
+
+    /* Set the ramp length used for coefficient changes */
+    void setSampleRate(double sampleRate) noexcept;
+
+    /* Copy the coefficients of a section, a disabled section keeps its state but is not processed */
+    void setSection(uint32_t index, const Biquad& filter, bool enabled = true) noexcept;
+
+    /* Clear the state of all sections and finish any coefficient ramp */
+    void reset() noexcept;
+
+    /* Run all active sections over a buffer, in-place processing is allowed */
+    void process(float* out, const float* in, uint32_t numSamples) noexcept;
+
+    void process(float* const out, const uint32_t numSamples) noexcept
+    {
+        process(out, out, numSamples);
+    }
+
+    uint32_t getNumActiveSections() noexcept
+    {
+        if (needsUpdate)
+            updateActiveSections();
+
+        return numActive;
+    }
+
+private:
+    struct Coefficients {
+        float a0, a1, a2, b1, b2;
+    };
+
+    struct Section {
+        Coefficients target;
+        Coefficients current;
+        float z1, z2;
+        bool enabled;
+        bool unity;
+    };
+
+    Section sections[kMaxSections];
+    uint32_t numSections = 0;
+
+    // active sections, packed in processing order, with the coefficients being ramped to
+    float a0[kMaxSections];
+    float a1[kMaxSections];
+    float a2[kMaxSections];
+    float b1[kMaxSections];
+    float b2[kMaxSections];
+    float z1[kMaxSections];
+    float z2[kMaxSections];
+    Coefficients targets[kMaxSections];
+    uint32_t activeSections[kMaxSections];
+    uint32_t numActive = 0;
+    bool needsUpdate = false;
+
+    // coefficient ramp, shared by all sections
+    uint32_t rampSteps;
+    uint32_t rampStepsLeft = 0;
+
+    void storeActiveSections() noexcept;
+    void updateActiveSections() noexcept;
+    void stepCoefficients() noexcept;
+    void processSections(float* out, const float* in, uint32_t numSamples) noexcept;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,374 @@
+/*
+ * Convolution Worker Pool
+ * Copyright (C) 2022-2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include "extra/Mutex.hpp"
+#include "extra/Thread.hpp"
+#include "Semaphore.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#if defined(DISTRHO_OS_WINDOWS)
+// windows.h is already included by Semaphore.hpp
+#elif defined(DISTRHO_OS_MAC)
+// no way to pin threads to cores on macOS
+#else
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Process-wide pool of threads for background convolution work, shared by all PartitionedConvolver instances.
+//
+// The pool has one worker per CPU core by default, but never more workers than registered jobs.
+// AIDAX_CONVOLUTION_THREADS changes the number of workers, AIDAX_CONVOLUTION_CORES takes a comma separated list of
+// CPU cores to pin workers to (one worker per core, Linux and Windows only).
+//
+// Jobs are submitted from the audio thread and picked by workers in earliest deadline first order, with the deadline
+// estimated from the time between submissions. Waiting on a job that no worker has started yet runs it right away on
+// the waiting thread, so a busy pool never makes a job late.
+
+class ConvolutionWorkerPool
+{
+public:
+    class Job
+    {
+    public:
+        Job() noexcept {}
+        virtual ~Job() {}
+
+    protected:
+        /* Do the actual work, called from a worker thread or from the thread waiting on the job */
+        virtual void processJob() = 0;
+
+        /* Add and remove this job from the pool, not realtime safe */
+        void registerJob()
+        {
+            ConvolutionWorkerPool::getInstance().addJob(this);
+        }
+
+        void unregisterJob()
+        {
+            ConvolutionWorkerPool::getInstance().removeJob(this);
+
+            // workers cannot pick it anymore, cancel or finish whatever was submitted
+            int expected = kJobQueued;
+            if (! state.compare_exchange_strong(expected, kJobIdle) && expected != kJobIdle)
+                semFinished.wait();
+
+            state.store(kJobIdle);
+        }
+
+        /* Queue the job for processing, meant for the audio thread */
+        void submitJob() noexcept
+        {
+            const int64_t now = getTimeNs();
+
+            if (lastSubmitTime != 0)
+                period = now - lastSubmitTime;
+
+            lastSubmitTime = now;
+            deadline.store(now + (period != 0 ? period : kDefaultJobPeriod), std::memory_order_relaxed);
+            state.store(kJobQueued, std::memory_order_release);
+
+            ConvolutionWorkerPool::getInstance().semWork.post();
+        }
+
+        /* Wait for the last submitted job to be done, meant for the audio thread */
+        void waitForJob() noexcept
+        {
+            int expected = kJobQueued;
+
+            if (state.compare_exchange_strong(expected, kJobRunning, std::memory_order_acquire))
+            {
+                // not picked up by a worker, do it now
+                processJob();
+                state.store(kJobIdle, std::memory_order_release);
+                return;
+            }
+
+            if (expected == kJobIdle)
+                return;
+
+            semFinished.wait();
+            state.store(kJobIdle, std::memory_order_release);
+        }
+
+       /**
+          Check if the last submitted job is done without waiting or running it, meant for the audio thread.
+          Returns false while it is still queued or running, in which case it must not be submitted again.
+        */
+        bool tryFinishJob() noexcept
+        {
+            const int current = state.load(std::memory_order_acquire);
+
+            if (current == kJobIdle)
+                return true;
+
+            // the worker marks the job done right before posting, check again on the next call
+            if (current != kJobDone || ! semFinished.tryWait())
+                return false;
+
+            state.store(kJobIdle, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        friend class ConvolutionWorkerPool;
+
+        std::atomic<int> state { kJobIdle };
+        std::atomic<int64_t> deadline { 0 };
+        int64_t lastSubmitTime = 0;
+        int64_t period = 0;
+        Semaphore semFinished;
+
+        DISTRHO_DECLARE_NON_COPYABLE(Job)
+    };
+
+private:
+    enum JobState {
+        kJobIdle = 0,
+        kJobQueued,
+        kJobRunning,
+        kJobDone
+    };
+
+    /* Deadline used until a job has been submitted twice */
+    static constexpr const int64_t kDefaultJobPeriod = 10000000; // 10ms
+
+   #ifdef DISTRHO_OS_WASM
+    /* Web Workers are created upfront, see PTHREAD_POOL_SIZE in the standalone Makefile */
+    static constexpr const uint kMaxWasmWorkers = 2;
+   #endif
+
+    class Worker : public Thread
+    {
+        ConvolutionWorkerPool& pool;
+        const int core;
+
+    public:
+        Worker(ConvolutionWorkerPool& p, const int c)
+            : Thread("ConvolutionWorker"),
+              pool(p),
+              core(c) {}
+
+    protected:
+        void run() override
+        {
+            if (core >= 0)
+                pinCurrentThread(core);
+
+            while (! shouldThreadExit())
+            {
+                pool.semWork.wait();
+
+                if (shouldThreadExit())
+                    break;
+
+                while (Job* const job = pool.takeJob())
+                {
+                    job->processJob();
+                    job->state.store(kJobDone, std::memory_order_release);
+                    job->semFinished.post();
+                }
+            }
+        }
+    };
+
+    Mutex jobsMutex;
+    std::vector<Job*> jobs;
+    Mutex workersMutex;
+    std::vector<Worker*> workers;
+    std::vector<int> cores;
+    uint maxWorkers;
+    Semaphore semWork;
+
+    ConvolutionWorkerPool()
+    {
+        if (const char* const coreList = std::getenv("AIDAX_CONVOLUTION_CORES"))
+        {
+            for (const char* s = coreList; *s != '\0';)
+            {
+                char* end;
+                const long core = std::strtol(s, &end, 10);
+
+                if (end == s)
+                    break;
+                if (core >= 0)
+                    cores.push_back(static_cast<int>(core));
+
+                s = *end == ',' ? end + 1 : end;
+            }
+        }
+
+        if (! cores.empty())
+            maxWorkers = static_cast<uint>(cores.size());
+        else if (const char* const numThreads = std::getenv("AIDAX_CONVOLUTION_THREADS"))
+            maxWorkers = std::max(1, std::atoi(numThreads));
+        else
+            maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+       #ifdef DISTRHO_OS_WASM
+        maxWorkers = std::min(maxWorkers, kMaxWasmWorkers);
+       #endif
+    }
+
+    ~ConvolutionWorkerPool()
+    {
+        stopWorkers();
+    }
+
+    static ConvolutionWorkerPool& getInstance()
+    {
+        static ConvolutionWorkerPool pool;
+        return pool;
+    }
+
+    static int64_t getTimeNs() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void pinCurrentThread(const int core)
+    {
+       #if defined(DISTRHO_OS_WINDOWS)
+        if (::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) == 0)
+            d_stderr2("Failed to pin convolution worker to core %d", core);
+       #elif defined(DISTRHO_OS_MAC) || defined(DISTRHO_OS_WASM)
+        (void)core;
+       #else
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(core, &cpuset);
+
+        if (::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset) != 0)
+            d_stderr2("Failed to pin convolution worker to core %d", core);
+       #endif
+    }
+
+    void addJob(Job* const job)
+    {
+        size_t numJobs;
+
+        {
+            const MutexLocker cml(jobsMutex);
+            jobs.push_back(job);
+            numJobs = jobs.size();
+        }
+
+        const MutexLocker cml(workersMutex);
+
+        while (workers.size() < std::min<size_t>(numJobs, maxWorkers))
+        {
+            const size_t index = workers.size();
+            Worker* const worker = new Worker(*this, index < cores.size() ? cores[index] : -1);
+            worker->startThread(true);
+            workers.push_back(worker);
+        }
+    }
+
+    void removeJob(Job* const job)
+    {
+        bool empty;
+
+        {
+            const MutexLocker cml(jobsMutex);
+
+            for (std::vector<Job*>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+            {
+                if (*it == job)
+                {
+                    jobs.erase(it);
+                    break;
+                }
+            }
+
+            empty = jobs.empty();
+        }
+
+        // nothing left to do, do not keep idle realtime threads around
+        if (empty)
+            stopWorkers();
+    }
+
+    void stopWorkers()
+    {
+        const MutexLocker cml(workersMutex);
+
+        for (Worker* worker : workers)
+            worker->signalThreadShouldExit();
+
+        for (size_t i = 0; i < workers.size(); ++i)
+            semWork.post();
+
+        for (Worker* worker : workers)
+        {
+            worker->stopThread(5000);
+            delete worker;
+        }
+
+        workers.clear();
+    }
+
+    /* Claim the queued job with the earliest deadline, returns null if there are none */
+    Job* takeJob()
+    {
+        const MutexLocker cml(jobsMutex);
+
+        for (;;)
+        {
+            Job* next = nullptr;
+            int64_t nextDeadline = 0;
+            bool more = false;
+
+            for (Job* job : jobs)
+            {
+                if (job->state.load(std::memory_order_acquire) != kJobQueued)
+                    continue;
+
+                const int64_t deadline = job->deadline.load(std::memory_order_relaxed);
+
+                if (next == nullptr || deadline < nextDeadline)
+                {
+                    more = more || next != nullptr;
+                    next = job;
+                    nextDeadline = deadline;
+                }
+                else
+                {
+                    more = true;
+                }
+            }
+
+            if (next == nullptr)
+                return nullptr;
+
+            int expected = kJobQueued;
+            if (! next->state.compare_exchange_strong(expected, kJobRunning, std::memory_order_acquire))
+                continue; // taken by the waiting thread, look again
+
+            // semaphores may not count past 1, so wake up another worker for the remaining jobs
+            if (more)
+                semWork.post();
+
+            return next;
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ConvolutionWorkerPool)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,187 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AidaDSP.hpp"
+#include "Threading.hpp"
+
+#if AIDAX_THREADS
+# include "ConvolutionWorkerPool.hpp"
+#endif
+
+#include "extra/ScopedDenormalDisable.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs the processing stages that come after the model one block behind, as a ConvolutionWorkerPool job, so that a
+// worker processes block N-1 while the audio thread runs the model for block N.
+//
+// Block sizes may vary between calls, so processed frames go through a small output buffer prefilled with a full host
+// buffer of silence. Frames stay in the pipeline for exactly that long, which is the latency it adds.
+// Without threads (wasm builds without pthreads) the stage runs right away on the audio thread, keeping the same
+// latency.
+// Only the audio thread waits on the job, so a stage may itself wait on other pool jobs (such as the cabinet tail).
+
+class DSPPipeline
+#if AIDAX_THREADS
+    : private ConvolutionWorkerPool::Job
+#endif
+{
+    struct Channel {
+        // model output of the previous block, processed in-place by the worker
+        std::vector<float> pending;
+        // processed frames not yet handed back
+        std::vector<float> output;
+    };
+
+    Channel channels[kNumDSPChannels];
+    uint32_t bufferSize = 0;
+    uint32_t pendingFrames = 0;
+    uint32_t outputFrames = 0;
+    bool pendingIdle = false;
+    bool registered = false;
+
+public:
+    DSPPipeline() noexcept {}
+
+    virtual ~DSPPipeline()
+    {
+       #if AIDAX_THREADS
+        if (registered)
+            unregisterJob();
+       #endif
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Non-realtime calls */
+
+   /**
+      Add the pipeline to the worker pool, must be done before the first start() for the stage to run in parallel.
+      Without it the stage runs on the audio thread when finish() waits for it, adding latency for nothing.
+    */
+    void registerWorker()
+    {
+       #if AIDAX_THREADS
+        if (registered)
+            return;
+
+        registerJob();
+        registered = true;
+       #endif
+    }
+
+    /* Allocate buffers for host blocks of up to @a newBufferSize frames, clearing the pipeline */
+    void setBufferSize(const uint32_t newBufferSize)
+    {
+        bufferSize = newBufferSize;
+
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            channels[c].pending.assign(newBufferSize, 0.f);
+            channels[c].output.assign(newBufferSize * 2, 0.f);
+        }
+
+        reset();
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Realtime calls, only to be used from the audio thread */
+
+    /* Latency added by the pipeline, in frames */
+    uint32_t getLatency() const noexcept
+    {
+        return bufferSize;
+    }
+
+    /* Drop everything in the pipeline, prefilling it with silence */
+    void reset() noexcept
+    {
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            std::memset(channels[c].output.data(), 0, sizeof(float) * bufferSize);
+
+        pendingFrames = 0;
+        outputFrames = bufferSize;
+        pendingIdle = false;
+    }
+
+   /**
+      Start processing the model output of the previous block.
+      Nothing touched by processPipelineStage() may be changed from now until finish() is called.
+    */
+    void start() noexcept
+    {
+        if (pendingFrames == 0)
+            return;
+
+       #if AIDAX_THREADS
+        submitJob();
+       #else
+        processJob();
+       #endif
+    }
+
+   /**
+      Wait for the previous block, hand the model output in @a outs over for the next one, and replace it with
+      @a numSamples processed frames from one host buffer ago.
+      @a idle tells if the model was skipped for this block, and is passed back along with its frames.
+    */
+    void finish(float* const outs[kNumDSPChannels], const uint32_t numSamples, const bool idle) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSamples <= bufferSize,);
+
+       #if AIDAX_THREADS
+        if (pendingFrames != 0)
+            waitForJob();
+       #endif
+
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            Channel& channel(channels[c]);
+
+            std::memcpy(channel.output.data() + outputFrames, channel.pending.data(), sizeof(float) * pendingFrames);
+            std::memcpy(channel.pending.data(), outs[c], sizeof(float) * numSamples);
+            std::memcpy(outs[c], channel.output.data(), sizeof(float) * numSamples);
+            std::memmove(channel.output.data(), channel.output.data() + numSamples,
+                         sizeof(float) * (outputFrames + pendingFrames - numSamples));
+        }
+
+        outputFrames += pendingFrames - numSamples;
+        pendingFrames = numSamples;
+        pendingIdle = idle;
+    }
+
+protected:
+    /* Process @a numSamples frames of model output in-place, @a idle as given to finish() for them */
+    virtual void processPipelineStage(float* outs[kNumDSPChannels], uint32_t numSamples, bool idle) = 0;
+
+private:
+    void processJob()
+       #if AIDAX_THREADS
+        override
+       #endif
+    {
+        // workers do not inherit the audio thread floating point settings
+        const ScopedDenormalDisable sdd;
+
+        float* outs[kNumDSPChannels];
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            outs[c] = channels[c].pending.data();
+
+        processPipelineStage(outs, pendingFrames, pendingIdle);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(DSPPipeline)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
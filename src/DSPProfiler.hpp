@@ -0,0 +1,140 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "DistrhoPluginInfo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Number of slices the peak window is split into, oldest slice is dropped as a new one starts */
+static constexpr const uint32_t kDSPProfilerPeakSlices = 50;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Measures time spent on each stage of an audio block, relative to the time the block represents (its deadline).
+// Everything happens on the audio thread: per-block results go into a fixed ring of peak slices covering the last few
+// seconds, and summaries are read out at meter rate through publish(), so there is no locking or allocation involved.
+
+class DSPProfiler
+{
+    typedef std::chrono::steady_clock clock;
+
+    clock::time_point blockStart;
+    clock::time_point stageStart;
+    double stageTimes[kDSPStageCount];
+    double blockDeadline = 0.0;
+
+    // load average since last publish
+    double periodTime = 0.0;
+    double periodDeadline = 0.0;
+
+    // worst block load per slice, as a ring
+    float peakSlices[kDSPProfilerPeakSlices];
+    uint32_t peakSliceIndex = 0;
+    uint32_t peakSliceFrames = 0;
+    uint32_t peakSliceMaxFrames = 1;
+
+    uint32_t overruns = 0;
+    DSPStage overrunStage = kDSPStageNone;
+
+    double sampleRate = 48000.0;
+
+public:
+    DSPProfiler()
+    {
+        reset();
+    }
+
+    void setSampleRate(const double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        peakSliceMaxFrames = std::max<uint32_t>(1, newSampleRate * kDSPProfilerPeakWindow / kDSPProfilerPeakSlices);
+        reset();
+    }
+
+    void reset()
+    {
+        std::memset(stageTimes, 0, sizeof(stageTimes));
+        std::memset(peakSlices, 0, sizeof(peakSlices));
+        peakSliceIndex = peakSliceFrames = 0;
+        periodTime = periodDeadline = 0.0;
+        overruns = 0;
+        overrunStage = kDSPStageNone;
+    }
+
+    /* Start measuring a block, everything until the first stage() call is accounted to kDSPStageInput */
+    void begin(const uint32_t numSamples) noexcept
+    {
+        blockStart = stageStart = clock::now();
+        blockDeadline = numSamples / sampleRate;
+        peakSliceFrames += numSamples;
+        std::memset(stageTimes, 0, sizeof(stageTimes));
+    }
+
+    /* Account time since the previous call to the stage that just finished */
+    void stage(const DSPStage finished) noexcept
+    {
+        const clock::time_point now = clock::now();
+        stageTimes[finished] += std::chrono::duration<double>(now - stageStart).count();
+        stageStart = now;
+    }
+
+    /* Finish measuring a block, the remaining time is accounted to the last stage */
+    void end(const DSPStage finished) noexcept
+    {
+        stage(finished);
+
+        const double blockTime = std::chrono::duration<double>(stageStart - blockStart).count();
+        const float blockLoad = blockTime / blockDeadline * 100.0;
+
+        periodTime += blockTime;
+        periodDeadline += blockDeadline;
+
+        if (peakSliceFrames >= peakSliceMaxFrames)
+        {
+            peakSliceFrames = 0;
+            peakSliceIndex = (peakSliceIndex + 1) % kDSPProfilerPeakSlices;
+            peakSlices[peakSliceIndex] = blockLoad;
+        }
+        else
+        {
+            peakSlices[peakSliceIndex] = std::max(peakSlices[peakSliceIndex], blockLoad);
+        }
+
+        if (blockTime > blockDeadline)
+        {
+            ++overruns;
+            overrunStage = static_cast<DSPStage>(std::max_element(stageTimes, stageTimes + kDSPStageCount) - stageTimes);
+        }
+    }
+
+    /* Write the current summaries into the matching plugin parameters, restarting the load average period */
+    void publish(float parameters[kParameterCount]) noexcept
+    {
+        const float maxLoad = kParameters[kParameterDSPLoad].ranges.max;
+
+        if (periodDeadline > 0.0)
+            parameters[kParameterDSPLoad] = std::min<float>(maxLoad, periodTime / periodDeadline * 100.0);
+
+        parameters[kParameterDSPLoadPeak] = std::min(maxLoad, *std::max_element(peakSlices, peakSlices + kDSPProfilerPeakSlices));
+        parameters[kParameterDSPOverruns] = std::min<float>(kParameters[kParameterDSPOverruns].ranges.max, overruns);
+        parameters[kParameterDSPOverrunStage] = overrunStage;
+
+        periodTime = periodDeadline = 0.0;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(DSPProfiler)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
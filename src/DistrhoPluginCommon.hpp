@@ -12,21 +12,48 @@
 static constexpr const char* const kVersionString = "v1.1.0";
 static constexpr const uint32_t kVersionNumber = d_version(1, 1, 0);
 
+// stereo plugin builds, with both channels processed through the same model, see DynamicModel::processStereo
+#ifndef AIDAX_STEREO
+# define AIDAX_STEREO 0
+#endif
+
 #define DISTRHO_PLUGIN_BRAND   "AIDA DSP"
-#define DISTRHO_PLUGIN_NAME    "AIDA-X"
-#define DISTRHO_PLUGIN_URI     "http://aidadsp.cc/plugins/aidadsp-bundle/rt-neural-loader"
-#define DISTRHO_PLUGIN_CLAP_ID "cc.aidadsp.rt-neural-loader"
+#if AIDAX_STEREO
+# define DISTRHO_PLUGIN_NAME    "AIDA-X Stereo"
+# define DISTRHO_PLUGIN_URI     "http://aidadsp.cc/plugins/aidadsp-bundle/rt-neural-loader-stereo"
+# define DISTRHO_PLUGIN_CLAP_ID "cc.aidadsp.rt-neural-loader-stereo"
+#else
+# define DISTRHO_PLUGIN_NAME    "AIDA-X"
+# define DISTRHO_PLUGIN_URI     "http://aidadsp.cc/plugins/aidadsp-bundle/rt-neural-loader"
+# define DISTRHO_PLUGIN_CLAP_ID "cc.aidadsp.rt-neural-loader"
+#endif
+
+// headless engine builds, running the plugin DSP from the command line, see src/headless
+#ifndef AIDAX_HEADLESS
+# define AIDAX_HEADLESS 0
+#endif
 
-#define DISTRHO_PLUGIN_HAS_UI          1
+#if AIDAX_HEADLESS
+# define DISTRHO_PLUGIN_HAS_UI         0
+#else
+# define DISTRHO_PLUGIN_HAS_UI         1
+#endif
 #define DISTRHO_PLUGIN_IS_RT_SAFE      1
 #define DISTRHO_PLUGIN_WANT_PROGRAMS   0
 #define DISTRHO_PLUGIN_WANT_STATE      1
+#define DISTRHO_PLUGIN_WANT_LATENCY    1
+#define DISTRHO_PLUGIN_WANT_MIDI_INPUT 1
 #define DISTRHO_UI_FILE_BROWSER        1
 #define DISTRHO_UI_USE_NANOVG          1
 
-#define DISTRHO_PLUGIN_CLAP_FEATURES   "audio-effect", "multi-effects", "mono"
+#if AIDAX_STEREO
+# define DISTRHO_PLUGIN_CLAP_FEATURES   "audio-effect", "multi-effects", "stereo"
+# define DISTRHO_PLUGIN_VST3_CATEGORIES "Fx|Dynamics|Stereo"
+#else
+# define DISTRHO_PLUGIN_CLAP_FEATURES   "audio-effect", "multi-effects", "mono"
+# define DISTRHO_PLUGIN_VST3_CATEGORIES "Fx|Dynamics|Mono"
+#endif
 #define DISTRHO_PLUGIN_LV2_CATEGORY    "lv2:SimulatorPlugin"
-#define DISTRHO_PLUGIN_VST3_CATEGORIES "Fx|Dynamics|Mono"
 
 #if DISTRHO_PLUGIN_VARIANT_STANDALONE && DISTRHO_PLUGIN_NUM_INPUTS == 0
 # define AIDAX_WITH_AUDIOFILE 1
@@ -59,6 +86,12 @@ static constexpr const char* const kDefaultCabinetName = "V30-P2-audix-i5.wav";
 
 static constexpr const float kMinimumMeterDb = -60.f;
 
+/* Number of model bank slots, selected with the BANK parameter or MIDI program changes (see ModelBank) */
+static constexpr const uint32_t kModelBankSlots = 8;
+
+/* Length of the window used for the worst block DSP load report, in seconds */
+static constexpr const double kDSPProfilerPeakWindow = 5.0;
+
 enum Parameters {
     kParameterINLPF,
     kParameterINLEVEL,
@@ -84,12 +117,22 @@ enum Parameters {
     kParameterModelInputSize,
     kParameterMeterIn,
     kParameterMeterOut,
+    kParameterCABSIMMAXLEN,
+    kParameterCabinetLength,
+    kParameterDSPLoad,
+    kParameterDSPLoadPeak,
+    kParameterDSPOverruns,
+    kParameterDSPOverrunStage,
+    kParameterMODELRATE,
+    kParameterPIPELINE,
+    kParameterBANK,
     kParameterCount
 };
 
 enum States {
     kStateModelFile,
     kStateImpulseFile,
+    kStateModelBank,
    #if AIDAX_WITH_AUDIOFILE
     kStateAudioFile,
    #endif
@@ -106,6 +149,21 @@ enum MidEqType {
     kMidEqBandpass
 };
 
+/* Processing stages of the plugin run function, as measured by DSPProfiler */
+enum DSPStage {
+    kDSPStageNone,
+    kDSPStageInput,
+    kDSPStageLPF,
+    kDSPStageInLevel,
+    kDSPStageEqPre,
+    kDSPStageModel,
+    kDSPStageDCBlocker,
+    kDSPStageCabinet,
+    kDSPStageEqPost,
+    kDSPStageOutput,
+    kDSPStageCount
+};
+
 static ParameterEnumerationValue kEQPOS[2] = {
     { kEqPost, "POST" },
     { kEqPre, "PRE" }
@@ -128,6 +186,29 @@ static ParameterEnumerationValue kModelInSize[4] = {
     { 3.f, "WITH 2 PARAMS" }
 };
 
+static ParameterEnumerationValue kMODELRATE[2] = {
+    { 0.f, "HOST" },
+    { 1.f, "TRAINING" }
+};
+
+static ParameterEnumerationValue kPIPELINE[2] = {
+    { 0.f, "OFF" },
+    { 1.f, "ON" }
+};
+
+static ParameterEnumerationValue kDSPStages[kDSPStageCount] = {
+    { kDSPStageNone, "NONE" },
+    { kDSPStageInput, "INPUT" },
+    { kDSPStageLPF, "ANTIALIASING" },
+    { kDSPStageInLevel, "INPUT LEVEL" },
+    { kDSPStageEqPre, "EQ PRE" },
+    { kDSPStageModel, "MODEL" },
+    { kDSPStageDCBlocker, "DC BLOCKER" },
+    { kDSPStageCabinet, "CABINET" },
+    { kDSPStageEqPost, "EQ POST" },
+    { kDSPStageOutput, "OUTPUT" }
+};
+
 static const Parameter kParameters[] = {
     { kParameterIsAutomatable, "ANTIALIASING", "ANTIALIASING", "%", 66.216f, 0.f, 100.f, },
     { kParameterIsAutomatable, "INPUT", "PREGAIN", "dB", 0.f, -12.f, 12.f, },
@@ -153,6 +234,15 @@ static const Parameter kParameters[] = {
     { kParameterIsOutput, "Model Input Size", "ModelInSize", "", 0.f, 0.f, 3.f, ARRAY_SIZE(kModelInSize), kModelInSize },
     { kParameterIsOutput, "Meter In", "MeterIn", "dB", 0.f, 0.f, 2.f, },
     { kParameterIsOutput, "Meter Out", "MeterOut", "dB", 0.f, 0.f, 2.f, },
+    { kParameterIsInteger, "CABSIMMAXLEN", "CABSIMMAXLEN", "ms", 0.f, 0.f, 1000.f, },
+    { kParameterIsOutput, "Cabinet Length", "CabinetLength", "ms", 0.f, 0.f, 10000.f, },
+    { kParameterIsOutput, "DSP Load", "DSPLoad", "%", 0.f, 0.f, 200.f, },
+    { kParameterIsOutput, "DSP Load Peak", "DSPLoadPeak", "%", 0.f, 0.f, 200.f, },
+    { kParameterIsOutput|kParameterIsInteger, "DSP Overruns", "DSPOverruns", "", 0.f, 0.f, 16777216.f, },
+    { kParameterIsOutput|kParameterIsInteger, "DSP Overrun Stage", "DSPOverrunStage", "", 0.f, 0.f, kDSPStageCount - 1, ARRAY_SIZE(kDSPStages), kDSPStages },
+    { kParameterIsBoolean|kParameterIsInteger, "MODELRATE", "MODELRATE", "", 0.f, 0.f, 1.f, ARRAY_SIZE(kMODELRATE), kMODELRATE },
+    { kParameterIsBoolean|kParameterIsInteger, "PIPELINE", "PIPELINE", "", 0.f, 0.f, 1.f, ARRAY_SIZE(kPIPELINE), kPIPELINE },
+    { kParameterIsAutomatable|kParameterIsInteger, "BANK", "BANK", "", 0.f, 0.f, kModelBankSlots, },
 };
 
 static constexpr const uint kNumParameters = ARRAY_SIZE(kParameters);
@@ -0,0 +1,290 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AsyncModelLoader.hpp"
+#include "Threading.hpp"
+
+#if AIDAX_THREADS
+# include "ConvolutionWorkerPool.hpp"
+#endif
+
+#include "extra/ScopedDenormalDisable.hpp"
+
+#include <cstring>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Number of models kept by the bank, the main model plus one per bank slot */
+static constexpr const uint32_t kModelBankSize = kModelBankSlots + 1;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Models kept ready for switching within a single block, indexed from 0 (the main model) to kModelBankSlots.
+//
+// The model playing is checked out of the bank by the audio thread, all others are kept warm by running them over the
+// same input, each slot as its own ConvolutionWorkerPool job so that warm models spread over the workers. Their
+// recurrent state then matches the live signal, so switching to one is just a crossfade, without the clicks or
+// pre-buffering of a cold model.
+// The audio thread never waits on warm models: they run one block behind, and a slot whose job is still busy when the
+// next block comes in skips that block. Slots are only changed while their job is done, otherwise that is retried on
+// the next block.
+// Without threads (wasm builds without pthreads) warm models run on the audio thread.
+// Everything here is called from the audio thread, except where noted.
+
+class ModelBank
+{
+    struct Slot
+       #if AIDAX_THREADS
+        : ConvolutionWorkerPool::Job
+       #endif
+    {
+        // warm model, null while empty or checked out
+        DynamicModel* model = nullptr;
+        // a model was checked out and is still the latest one for this slot
+        bool checkedOut = false;
+        // model input copy, one per channel
+        std::vector<float> buffers[kNumDSPChannels];
+        // parameters and size of the block being warmed, copied so the model follows the same parameter ramps
+        LinearValueSmoother param1;
+        LinearValueSmoother param2;
+        uint32_t frames = 0;
+
+       #if AIDAX_THREADS
+        using ConvolutionWorkerPool::Job::registerJob;
+        using ConvolutionWorkerPool::Job::unregisterJob;
+        using ConvolutionWorkerPool::Job::submitJob;
+        using ConvolutionWorkerPool::Job::waitForJob;
+       #endif
+
+        /* Check if the model of this slot is not being warmed, which is needed to change or check it out */
+        bool isIdle() noexcept
+        {
+           #if AIDAX_THREADS
+            return tryFinishJob();
+           #else
+            return true;
+           #endif
+        }
+
+        void processJob()
+           #if AIDAX_THREADS
+            override
+           #endif
+        {
+            // workers do not inherit the audio thread floating point settings
+            const ScopedDenormalDisable sdd;
+
+            float* outs[kNumDSPChannels];
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                outs[c] = buffers[c].data();
+
+            applyModel(model, outs, frames, param1, param2);
+        }
+    };
+
+    Slot slots[kModelBankSize];
+    // bank slots cleared by the loader, not yet emptied because they were busy
+    uint32_t pendingClearedSlots = 0;
+    uint32_t bufferSize = 0;
+    bool registered = false;
+
+public:
+    ModelBank() noexcept {}
+
+    ~ModelBank()
+    {
+        for (uint32_t i = 0; i < kModelBankSize; ++i)
+        {
+           #if AIDAX_THREADS
+            if (registered)
+                slots[i].unregisterJob();
+           #endif
+
+            delete slots[i].model;
+        }
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Non-realtime calls */
+
+    /* Add the slots to the worker pool, done only once there is a bank to keep warm */
+    void registerWorker()
+    {
+       #if AIDAX_THREADS
+        if (registered)
+            return;
+
+        for (uint32_t i = 0; i < kModelBankSize; ++i)
+            slots[i].registerJob();
+
+        registered = true;
+       #endif
+    }
+
+    /* Allocate warming buffers for host blocks of up to @a newBufferSize frames, waiting for any warming in progress */
+    void setBufferSize(const uint32_t newBufferSize)
+    {
+        bufferSize = newBufferSize;
+
+        for (uint32_t i = 0; i < kModelBankSize; ++i)
+        {
+           #if AIDAX_THREADS
+            slots[i].waitForJob();
+           #endif
+
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                slots[i].buffers[c].resize(newBufferSize);
+        }
+    }
+
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Realtime calls */
+
+   /**
+      Pick up models prepared by @a loader, slot 0 taking its main model, handing replaced ones back to it.
+      A model that replaces a checked out one makes it outdated, see returnModel().
+      Models for slots that are busy warming stay with the loader until a later call.
+    */
+    void takePreparedModels(AsyncModelLoader& loader) noexcept
+    {
+        if (! loader.canRetireModels(kModelBankSize))
+            return;
+
+        if (slots[0].isIdle())
+        {
+            if (DynamicModel* const newmodel = loader.takeModel())
+                setModel(loader, 0, newmodel);
+        }
+
+        pendingClearedSlots |= loader.takeClearedBankSlots();
+
+        for (uint32_t i = 0; i < kModelBankSlots; ++i)
+        {
+            if (! slots[i + 1].isIdle())
+                continue;
+
+            if (pendingClearedSlots & (1u << i))
+            {
+                pendingClearedSlots &= ~(1u << i);
+                setModel(loader, i + 1, nullptr);
+            }
+
+            if (DynamicModel* const newmodel = loader.takeBankModel(i))
+                setModel(loader, i + 1, newmodel);
+        }
+    }
+
+    /* Check if @a slot has a model, warm or checked out */
+    bool isAvailable(const uint32_t slot) const noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSize, false);
+
+        return slots[slot].model != nullptr || slots[slot].checkedOut;
+    }
+
+    /* Check if @a slot has a warm model, which for a checked out slot means a newer model came in */
+    bool hasModel(const uint32_t slot) const noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSize, false);
+
+        return slots[slot].model != nullptr;
+    }
+
+    /* Check if the warm model of @a slot can be checked out now, it may still be busy with the last block */
+    bool canTakeModel(const uint32_t slot) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSize, false);
+
+        return slots[slot].model != nullptr && slots[slot].isIdle();
+    }
+
+   /**
+      Check out the warm model of @a slot, returns null if there is none or it is still busy with the last block.
+      The caller owns the returned model until it is given back with returnModel().
+    */
+    DynamicModel* takeModel(const uint32_t slot) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSize, nullptr);
+
+        DynamicModel* const model = slots[slot].model;
+
+        if (model == nullptr || ! slots[slot].isIdle())
+            return nullptr;
+
+        slots[slot].model = nullptr;
+        slots[slot].checkedOut = true;
+        return model;
+    }
+
+   /**
+      Give a model checked out of @a slot back to the bank, to be kept warm again.
+      Returns @a model back if it was replaced or cleared in the meantime, in which case the caller has to retire it.
+      The model must have processed every block since it was checked out.
+    */
+    DynamicModel* returnModel(const uint32_t slot, DynamicModel* const model) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(slot < kModelBankSize, model);
+
+        if (! slots[slot].checkedOut || slots[slot].model != nullptr)
+            return model;
+
+        slots[slot].model = model;
+        slots[slot].checkedOut = false;
+        return nullptr;
+    }
+
+   /**
+      Run all warm models over a copy of the model input in @a ins, as the model playing is about to.
+      @a param1 and @a param2 are copied, so that warm models follow the same parameter ramps.
+      Returns right away, warm models still busy with the previous block skip this one.
+    */
+    void warm(float* const ins[kNumDSPChannels], const uint32_t numSamples,
+              const LinearValueSmoother& param1, const LinearValueSmoother& param2) noexcept
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(numSamples <= bufferSize,);
+
+        for (uint32_t i = 0; i < kModelBankSize; ++i)
+        {
+            Slot& slot(slots[i]);
+
+            if (slot.model == nullptr || ! slot.isIdle())
+                continue;
+
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                std::memcpy(slot.buffers[c].data(), ins[c], sizeof(float) * numSamples);
+
+            slot.param1 = param1;
+            slot.param2 = param2;
+            slot.frames = numSamples;
+
+           #if AIDAX_THREADS
+            slot.submitJob();
+           #else
+            slot.processJob();
+           #endif
+        }
+    }
+
+private:
+    void setModel(AsyncModelLoader& loader, const uint32_t slot, DynamicModel* const model) noexcept
+    {
+        if (slots[slot].model != nullptr)
+            loader.retireModel(slots[slot].model);
+
+        slots[slot].model = model;
+        slots[slot].checkedOut = false;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ModelBank)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
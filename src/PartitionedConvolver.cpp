@@ -0,0 +1,349 @@
+/*
+ * Partitioned Convolver
+ * Copyright (C) 2022-2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: ISC
+ */
+
+#include "PartitionedConvolver.hpp"
+
+#if AIDAX_THREADS
+# include "ConvolutionWorkerPool.hpp"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+using fftconvolver::Sample;
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Range for the block size of the first stage, which follows the host buffer size */
+static constexpr const uint32_t kMinHeadBlockSize = 32;
+static constexpr const uint32_t kMaxHeadBlockSize = 1024;
+
+/* Block size ratio between consecutive stages, and the biggest block size used */
+static constexpr const uint32_t kStageGrowth = 4;
+static constexpr const uint32_t kMaxStageBlockSize = 16384;
+
+/* Biggest buffer size using a direct form FIR for the head, and how many samples the FIR processes at once */
+static constexpr const uint32_t kMaxFirHeadBufferSize = 64;
+static constexpr const uint32_t kFirHeadChunkSize = 32;
+
+static bool useFirHead(const uint32_t bufferSize) noexcept
+{
+    if (const char* const forced = std::getenv("AIDAX_CONVOLUTION_FIR_HEAD"))
+        return std::atoi(forced) != 0;
+
+    return bufferSize <= kMaxFirHeadBufferSize;
+}
+
+static uint32_t getHeadBlockSize(const uint32_t bufferSize) noexcept
+{
+    uint32_t blockSize = kMinHeadBlockSize;
+
+    while (blockSize < bufferSize && blockSize < kMaxHeadBlockSize)
+        blockSize *= 2;
+
+    return blockSize;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Stage running in blocks, one block behind the input, with a second block of delay while processing
+
+#if AIDAX_THREADS
+struct PartitionedConvolver::Stage : ConvolutionWorkerPool::Job
+#else
+struct PartitionedConvolver::Stage
+#endif
+{
+    fftconvolver::FFTConvolver convolver;
+    const uint32_t blockSize;
+    std::vector<Sample> input;
+    std::vector<Sample> backgroundInput;
+    std::vector<Sample> backgroundOutput;
+    std::vector<Sample> output;
+    bool registered = false;
+
+    explicit Stage(const uint32_t bs)
+        : blockSize(bs),
+          input(bs),
+          backgroundInput(bs),
+          backgroundOutput(bs),
+          output(bs) {}
+
+    ~Stage()
+    {
+       #if AIDAX_THREADS
+        if (registered)
+            unregisterJob();
+       #endif
+    }
+
+    bool init(const Sample* const ir, const size_t irLen)
+    {
+        if (! convolver.init(blockSize, ir, irLen))
+            return false;
+
+       #if AIDAX_THREADS
+        registerJob();
+        registered = true;
+       #endif
+        return true;
+    }
+
+    /* Called on every block boundary, picks up the last processed block and starts the next one */
+    void swapBlocks() noexcept
+    {
+       #if AIDAX_THREADS
+        waitForJob();
+       #endif
+
+        std::swap(output, backgroundOutput);
+        std::swap(input, backgroundInput);
+
+       #if AIDAX_THREADS
+        submitJob();
+       #else
+        processJob();
+       #endif
+    }
+
+    void processJob()
+       #if AIDAX_THREADS
+        override
+       #endif
+    {
+        convolver.process(backgroundInput.data(), backgroundOutput.data(), blockSize);
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(Stage)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+PartitionedConvolver::PartitionedConvolver() noexcept
+{
+    std::memset(stages, 0, sizeof(stages));
+    std::memset(blockSizes, 0, sizeof(blockSizes));
+}
+
+PartitionedConvolver::~PartitionedConvolver()
+{
+    clear();
+}
+
+void PartitionedConvolver::clear()
+{
+    for (uint32_t c = 0; c < kMaxChannels; ++c)
+    {
+        for (uint32_t i = 0; i < kMaxStages - 1; ++i)
+        {
+            delete stages[c][i];
+            stages[c][i] = nullptr;
+        }
+
+        firHistory[c].clear();
+    }
+
+    numChannels = 0;
+    numStages = 0;
+    position = 0;
+    length = 0;
+    firTaps.clear();
+}
+
+bool PartitionedConvolver::init(const Sample* const ir, const size_t irLen, const uint32_t bufferSize,
+                                const uint32_t numChannels)
+{
+    clear();
+
+    DISTRHO_SAFE_ASSERT_RETURN(numChannels != 0 && numChannels <= kMaxChannels, false);
+
+    if (irLen == 0)
+        return false;
+
+    // each stage starts in the IR at twice its block size, add stages while the IR goes past that
+    uint32_t blockSize = getHeadBlockSize(bufferSize);
+    blockSizes[numStages++] = blockSize;
+
+    while (numStages < kMaxStages
+        && blockSize * kStageGrowth <= kMaxStageBlockSize
+        && irLen > blockSize * kStageGrowth * 2)
+    {
+        blockSize *= kStageGrowth;
+        blockSizes[numStages++] = blockSize;
+    }
+
+    const size_t headLen = numStages > 1 ? blockSizes[1] * 2 : irLen;
+    const bool firHead = useFirHead(bufferSize);
+
+    if (firHead)
+    {
+        firTaps.resize(headLen);
+        std::reverse_copy(ir, ir + headLen, firTaps.begin());
+    }
+
+    for (uint32_t c = 0; c < numChannels; ++c)
+    {
+        if (firHead)
+        {
+            firHistory[c].resize(headLen - 1 + kFirHeadChunkSize);
+        }
+        else if (! heads[c].init(blockSizes[0], ir, headLen))
+        {
+            clear();
+            return false;
+        }
+
+        for (uint32_t i = 1; i < numStages; ++i)
+        {
+            const size_t offset = blockSizes[i] * 2;
+            const size_t end = i + 1 < numStages ? blockSizes[i + 1] * 2 : irLen;
+
+            stages[c][i - 1] = new Stage(blockSizes[i]);
+
+            if (! stages[c][i - 1]->init(ir + offset, end - offset))
+            {
+                clear();
+                return false;
+            }
+        }
+    }
+
+    this->numChannels = numChannels;
+    length = irLen;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+void PartitionedConvolver::process(const Sample* const* const inputs, Sample* const* const outputs, const size_t len)
+{
+    if (firTaps.empty())
+    {
+        for (uint32_t c = 0; c < numChannels; ++c)
+            heads[c].process(inputs[c], outputs[c], len);
+    }
+    else
+    {
+        processFirHead(inputs, outputs, len);
+    }
+
+    if (numStages == 1)
+        return;
+
+    // positions wrap at the biggest block size, so all stages start their blocks together
+    const uint32_t smallestBlockSize = blockSizes[1];
+    const uint32_t positionMask = blockSizes[numStages - 1] - 1;
+
+    for (size_t processed = 0; processed < len;)
+    {
+        const uint32_t processing = static_cast<uint32_t>(
+            std::min<size_t>(len - processed, smallestBlockSize - (position & (smallestBlockSize - 1))));
+
+        for (uint32_t c = 0; c < numChannels; ++c)
+        {
+            const Sample* const input = inputs[c] + processed;
+            Sample* const output = outputs[c] + processed;
+
+            for (uint32_t i = 0; i < numStages - 1; ++i)
+            {
+                Stage* const stage = stages[c][i];
+                const uint32_t fill = position & (stage->blockSize - 1);
+                const Sample* const precalculated = stage->output.data() + fill;
+
+                for (uint32_t j = 0; j < processing; ++j)
+                    output[j] += precalculated[j];
+
+                std::memcpy(stage->input.data() + fill, input, sizeof(Sample) * processing);
+            }
+        }
+
+        position = (position + processing) & positionMask;
+
+        for (uint32_t i = 0; i < numStages - 1; ++i)
+        {
+            if ((position & (blockSizes[i + 1] - 1)) != 0)
+                continue;
+
+            for (uint32_t c = 0; c < numChannels; ++c)
+                stages[c][i]->swapBlocks();
+        }
+
+        processed += processing;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Direct form FIR over a few hundred taps, the history keeps the last (taps - 1) input samples before the new ones.
+// Looping over taps first and samples second makes the inner loop independent multiply-adds, which compilers
+// vectorize without needing to reorder float sums. All channels go through the same tap loop, loading each tap once.
+
+void PartitionedConvolver::processFirHead(const Sample* const* const inputs, Sample* const* const outputs,
+                                          const size_t len) noexcept
+{
+    const size_t numTaps = firTaps.size();
+    const Sample* const taps = firTaps.data();
+    const uint32_t numChannels = this->numChannels;
+    Sample* history[kMaxChannels];
+
+    for (uint32_t c = 0; c < numChannels; ++c)
+        history[c] = firHistory[c].data();
+
+    for (size_t offset = 0; offset < len;)
+    {
+        const size_t frames = std::min<size_t>(len - offset, kFirHeadChunkSize);
+        Sample acc[kMaxChannels][kFirHeadChunkSize] = {};
+
+        for (uint32_t c = 0; c < numChannels; ++c)
+            std::memcpy(history[c] + numTaps - 1, inputs[c] + offset, sizeof(Sample) * frames);
+
+        // full chunks use a constant trip count, which lets the inner loop be fully vectorized
+        if (frames == kFirHeadChunkSize)
+        {
+            for (size_t k = 0; k < numTaps; ++k)
+            {
+                const Sample tap = taps[k];
+
+                for (uint32_t c = 0; c < numChannels; ++c)
+                {
+                    const Sample* const x = history[c] + k;
+
+                    for (size_t i = 0; i < kFirHeadChunkSize; ++i)
+                        acc[c][i] += tap * x[i];
+                }
+            }
+        }
+        else
+        {
+            for (size_t k = 0; k < numTaps; ++k)
+            {
+                const Sample tap = taps[k];
+
+                for (uint32_t c = 0; c < numChannels; ++c)
+                {
+                    const Sample* const x = history[c] + k;
+
+                    for (size_t i = 0; i < frames; ++i)
+                        acc[c][i] += tap * x[i];
+                }
+            }
+        }
+
+        for (uint32_t c = 0; c < numChannels; ++c)
+        {
+            std::memcpy(outputs[c] + offset, acc[c], sizeof(Sample) * frames);
+            std::memmove(history[c], history[c] + frames, sizeof(Sample) * (numTaps - 1));
+        }
+
+        offset += frames;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
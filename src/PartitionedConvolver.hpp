@@ -0,0 +1,106 @@
+/*
+ * Partitioned Convolver
+ * Copyright (C) 2022-2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include "FFTConvolver.h"
+
+#include "DistrhoUtils.hpp"
+#include "Threading.hpp"
+
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Non-uniformly partitioned convolver, with block sizes picked from the host buffer size and the IR length.
+//
+// The first stage runs without latency at the host buffer size, each following stage uses 4x bigger blocks and
+// starts in the IR at twice its block size, which gives a full block of time for processing it in the background.
+// Background stages go through the shared ConvolutionWorkerPool, or run inline on WASM builds without threads.
+//
+// For example, a 32 sample buffer and a 3000 sample IR gives blocks of 32, 128 and 512 samples,
+// a 1024 sample buffer and a 100000 sample IR gives blocks of 1024, 4096 and 16384 samples.
+//
+// For buffers of up to 64 samples the first stage is a direct form FIR instead, so no FFT runs in the audio thread.
+// Set AIDAX_CONVOLUTION_FIR_HEAD to 0 or 1 to force it off or on.
+//
+// Several channels can be convolved with the same IR, sharing the partition layout and the FIR taps.
+// Each channel has its own stages, so background work for different channels can run in parallel.
+
+class PartitionedConvolver
+{
+public:
+    static constexpr const uint32_t kMaxStages = 6;
+    static constexpr const uint32_t kMaxChannels = 2;
+
+    PartitionedConvolver() noexcept;
+    ~PartitionedConvolver();
+
+    /* Set up the stages for an IR, not realtime safe */
+    bool init(const fftconvolver::Sample* ir, size_t irLen, uint32_t bufferSize, uint32_t numChannels = 1);
+
+    /* Convolve a buffer of each channel, inputs and outputs must not overlap */
+    void process(const fftconvolver::Sample* const* inputs, fftconvolver::Sample* const* outputs, size_t len);
+
+    /* Same for a single channel */
+    void process(const fftconvolver::Sample* const input, fftconvolver::Sample* const output, const size_t len)
+    {
+        process(&input, &output, len);
+    }
+
+    uint32_t getNumChannels() const noexcept
+    {
+        return numChannels;
+    }
+
+    uint32_t getNumStages() const noexcept
+    {
+        return numStages;
+    }
+
+    uint32_t getBlockSize(const uint32_t stage) const noexcept
+    {
+        return stage < numStages ? blockSizes[stage] : 0;
+    }
+
+    /* Number of IR samples being convolved */
+    size_t getLength() const noexcept
+    {
+        return length;
+    }
+
+    /* Number of IR samples handled by the direct form FIR, 0 if not used */
+    uint32_t getFirHeadLength() const noexcept
+    {
+        return static_cast<uint32_t>(firTaps.size());
+    }
+
+private:
+    struct Stage;
+
+    fftconvolver::FFTConvolver heads[kMaxChannels];
+    Stage* stages[kMaxChannels][kMaxStages - 1];
+    uint32_t blockSizes[kMaxStages];
+    uint32_t numChannels = 0;
+    uint32_t numStages = 0;
+    uint32_t position = 0;
+    size_t length = 0;
+
+    // direct form FIR used instead of the head convolvers, taps are stored reversed and shared by all channels
+    std::vector<fftconvolver::Sample> firTaps;
+    std::vector<fftconvolver::Sample> firHistory[kMaxChannels];
+
+    void clear();
+    void processFirHead(const fftconvolver::Sample* const* inputs, fftconvolver::Sample* const* outputs,
+                        size_t len) noexcept;
+
+    DISTRHO_DECLARE_NON_COPYABLE(PartitionedConvolver)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
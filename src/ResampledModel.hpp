@@ -0,0 +1,299 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AidaDSP.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// -Wunused-variable
+#include "CDSPResampler.h"
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Max number of host frames converted at once, longer blocks are split */
+static constexpr const uint32_t kResampledModelMaxFrames = 512;
+
+/* Transition band of the sample rate converters, in percent of the model rate bandwidth.
+   Much wider than the r8brain default to keep filters and their delay short, still passing 21 kHz for 48 kHz models */
+static constexpr const double kResampledModelTransitionBand = 10.0;
+
+/* Stopband attenuation of the sample rate converters, same as r8b::CDSPResampler16 */
+static constexpr const double kResampledModelAttenuation = 136.45;
+
+/* Amount of silence fed through the converters to find their latency, in seconds */
+static constexpr const double kResampledModelProbeTime = 0.25;
+
+// --------------------------------------------------------------------------------------------------------------------
+// Runs a model at the sample rate it was trained at, instead of the host one.
+//
+// Audio is decimated to the model rate, processed, and interpolated back to the host rate with minimum-phase r8brain
+// converters, which keeps their delay short. The converters hand out frames in bursts, so interpolated audio goes
+// through a small output buffer, prefilled with the largest number of frames the converters can fall behind the input.
+// That prefill is the latency of the model, and stays constant for as long as the model is in use.
+// Conditioning parameters are smoothed again at the model rate, following the host rate smoothers.
+
+class ResampledModel : public DynamicModel
+{
+    class Channel
+    {
+        std::unique_ptr<r8b::CDSPResampler> downsampler;
+        std::unique_ptr<r8b::CDSPResampler> upsampler;
+        std::vector<double> convertBuffer;
+        std::vector<float> outputBuffer;
+        uint32_t outputFrames = 0;
+
+    public:
+        /* Frames at the model rate, processed in-place by the model */
+        std::vector<float> modelBuffer;
+
+        Channel(const double hostSampleRate, const double modelSampleRate)
+            : downsampler(new r8b::CDSPResampler(hostSampleRate, modelSampleRate, kResampledModelMaxFrames,
+                                                 kResampledModelTransitionBand, kResampledModelAttenuation, r8b::fprMinPhase))
+        {
+            const int maxModelFrames = downsampler->getMaxOutLen(kResampledModelMaxFrames);
+
+            upsampler.reset(new r8b::CDSPResampler(modelSampleRate, hostSampleRate, maxModelFrames,
+                                                   kResampledModelTransitionBand, kResampledModelAttenuation, r8b::fprMinPhase));
+
+            convertBuffer.resize(std::max<int>(kResampledModelMaxFrames, maxModelFrames));
+            modelBuffer.resize(maxModelFrames);
+        }
+
+       /**
+          Find out how far behind the input the converters output can fall, feeding them silence one frame at a time.
+          Converters are cleared afterwards, as if just created.
+        */
+        uint32_t probeLatency(const uint32_t numProbeFrames)
+        {
+            uint32_t latency = 0;
+            uint32_t numOutputFrames = 0;
+
+            for (uint32_t i = 1; i <= numProbeFrames; ++i)
+            {
+                double silence = 0.0;
+                double* downsampled;
+                double* upsampled;
+
+                if (const int numModelFrames = downsampler->process(&silence, 1, downsampled))
+                    numOutputFrames += upsampler->process(downsampled, numModelFrames, upsampled);
+
+                latency = std::max(latency, i - std::min(i, numOutputFrames));
+            }
+
+            downsampler->clear();
+            upsampler->clear();
+            return latency;
+        }
+
+        /* Allocate the output buffer for @a latency frames, plus the most a single conversion can add */
+        void setLatency(const uint32_t latency)
+        {
+            outputBuffer.resize(latency + kResampledModelMaxFrames + upsampler->getMaxOutLen(modelBuffer.size()));
+        }
+
+        /* Clear converters, prefilling the output buffer with @a latency frames of silence */
+        void reset(const uint32_t latency) noexcept
+        {
+            downsampler->clear();
+            upsampler->clear();
+
+            std::memset(outputBuffer.data(), 0, sizeof(float) * latency);
+            outputFrames = latency;
+        }
+
+        /* Decimate @a numFrames host frames into modelBuffer, returns the number of frames at the model rate */
+        int downsample(const float* const in, const uint32_t numFrames) noexcept
+        {
+            for (uint32_t i = 0; i < numFrames; ++i)
+                convertBuffer[i] = in[i];
+
+            double* downsampled;
+            const int numModelFrames = downsampler->process(convertBuffer.data(), numFrames, downsampled);
+
+            for (int i = 0; i < numModelFrames; ++i)
+                modelBuffer[i] = downsampled[i];
+
+            return numModelFrames;
+        }
+
+        /* Interpolate the first @a numModelFrames frames of modelBuffer, then read @a numFrames of output */
+        void upsample(float* const out, const int numModelFrames, const uint32_t numFrames) noexcept
+        {
+            if (numModelFrames != 0)
+            {
+                for (int i = 0; i < numModelFrames; ++i)
+                    convertBuffer[i] = modelBuffer[i];
+
+                double* upsampled;
+                const int numUpsampledFrames = std::min<int>(upsampler->process(convertBuffer.data(), numModelFrames,
+                                                                                upsampled),
+                                                             outputBuffer.size() - outputFrames);
+
+                for (int i = 0; i < numUpsampledFrames; ++i)
+                    outputBuffer[outputFrames + i] = upsampled[i];
+
+                outputFrames += numUpsampledFrames;
+            }
+
+            // never happens with the probed latency, but do not leave garbage in the output if it does
+            const uint32_t numReadFrames = std::min(numFrames, outputFrames);
+
+            std::memcpy(out, outputBuffer.data(), sizeof(float) * numReadFrames);
+            std::memset(out + numReadFrames, 0, sizeof(float) * (numFrames - numReadFrames));
+
+            outputFrames -= numReadFrames;
+            std::memmove(outputBuffer.data(), outputBuffer.data() + numReadFrames, sizeof(float) * outputFrames);
+        }
+
+        DISTRHO_DECLARE_NON_COPYABLE(Channel)
+    };
+
+    std::unique_ptr<DynamicModel> model;
+    std::unique_ptr<Channel> channels[2];
+    LinearValueSmoother modelParam1;
+    LinearValueSmoother modelParam2;
+
+public:
+   /**
+      Wrap @a model_ to run at its training sample rate, taking ownership of it.
+      @a stereo must match the mode the model was loaded in.
+    */
+    ResampledModel(DynamicModel* const model_, const double hostSampleRate, const bool stereo)
+        : model(model_)
+    {
+        const double modelSampleRate = model->sample_rate;
+
+        input_size = model->input_size;
+        precision = model->precision;
+        sample_rate = model->sample_rate;
+        weights = model->weights;
+
+        for (uint32_t c = 0; c < (stereo ? 2 : 1); ++c)
+            channels[c].reset(new Channel(hostSampleRate, modelSampleRate));
+
+        latency = channels[0]->probeLatency(hostSampleRate * kResampledModelProbeTime);
+
+        for (uint32_t c = 0; c < (stereo ? 2 : 1); ++c)
+            channels[c]->setLatency(latency);
+
+        modelParam1.setSampleRate(modelSampleRate);
+        modelParam1.setTimeConstant(kModelParamSmoothTime);
+        modelParam2.setSampleRate(modelSampleRate);
+        modelParam2.setTimeConstant(kModelParamSmoothTime);
+
+        reset();
+    }
+
+   /**
+      Check if a model should run at its training sample rate with @a hostSampleRate, which needs that rate to be known
+      and lower than the host one.
+    */
+    static bool isNeeded(const DynamicModel* const model, const double hostSampleRate) noexcept
+    {
+        return model->sample_rate != 0 && hostSampleRate > model->sample_rate * 1.01;
+    }
+
+    /* Give up ownership of the wrapped model, to run it at the host sample rate after all */
+    DynamicModel* releaseModel() noexcept
+    {
+        return model.release();
+    }
+
+    void process(float* const out, const uint32_t numSamples,
+                 LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        float* const outs[2] = { out, nullptr };
+        processChannels(outs, 1, numSamples, param1, param2);
+    }
+
+    void processStereo(float* const left, float* const right, const uint32_t numSamples,
+                       LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        if (channels[1] == nullptr)
+        {
+            process(left, numSamples, param1, param2);
+            std::memcpy(right, left, sizeof(float) * numSamples);
+            return;
+        }
+
+        float* const outs[2] = { left, right };
+        processChannels(outs, 2, numSamples, param1, param2);
+    }
+
+    void reset() override
+    {
+        model->reset();
+
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            if (channels[c] != nullptr)
+                channels[c]->reset(latency);
+        }
+
+        modelParam1.clearToTargetValue();
+        modelParam2.clearToTargetValue();
+    }
+
+private:
+    void processChannels(float* const outs[2], const uint32_t numChannels, const uint32_t numSamples,
+                         LinearValueSmoother& param1, LinearValueSmoother& param2) noexcept
+    {
+        followParameter(param1, modelParam1);
+        followParameter(param2, modelParam2);
+
+        for (uint32_t offset = 0; offset < numSamples; offset += kResampledModelMaxFrames)
+        {
+            const uint32_t numFrames = std::min(kResampledModelMaxFrames, numSamples - offset);
+            int numModelFrames = 0;
+
+            // converters of all channels are in the same state, so produce the same number of frames
+            for (uint32_t c = 0; c < numChannels; ++c)
+                numModelFrames = channels[c]->downsample(outs[c] + offset, numFrames);
+
+            if (numModelFrames != 0)
+            {
+                if (numChannels == 2)
+                    model->processStereo(channels[0]->modelBuffer.data(), channels[1]->modelBuffer.data(),
+                                         numModelFrames, modelParam1, modelParam2);
+                else
+                    model->process(channels[0]->modelBuffer.data(), numModelFrames, modelParam1, modelParam2);
+            }
+
+            for (uint32_t c = 0; c < numChannels; ++c)
+                channels[c]->upsample(outs[c] + offset, numModelFrames, numFrames);
+        }
+
+        // host rate smoothers advance as if the model had used them
+        for (uint32_t i = 0; i < numSamples; ++i)
+        {
+            param1.next();
+            param2.next();
+        }
+    }
+
+    /* Ramp towards the host parameter target, jumping to it once the host smoother is there */
+    static void followParameter(const LinearValueSmoother& hostParam, LinearValueSmoother& modelParam) noexcept
+    {
+        if (d_isNotEqual(modelParam.getTargetValue(), hostParam.getTargetValue()))
+            modelParam.setTargetValue(hostParam.getTargetValue());
+
+        if (d_isEqual(hostParam.getCurrentValue(), hostParam.getTargetValue()))
+            modelParam.clearToTargetValue();
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(ResampledModel)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -78,6 +78,18 @@ public:
        #endif
     }
 
+    bool tryWait()
+    {
+       #if defined(DISTRHO_OS_MAC)
+        const struct mach_timespec time = { 0, 0 };
+        return ::semaphore_timedwait(sem, time) == KERN_SUCCESS;
+       #elif defined(DISTRHO_OS_WINDOWS)
+        return ::WaitForSingleObject(handle, 0) == WAIT_OBJECT_0;
+       #else
+        return ::sem_trywait(&sem) == 0;
+       #endif
+    }
+
     bool timedWait(const uint numSecs)
     {
        #if defined(DISTRHO_OS_MAC)
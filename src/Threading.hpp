@@ -0,0 +1,18 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include "DistrhoUtils.hpp"
+
+// Background threads for loaders, convolution and pipeline workers.
+// On wasm these are Web Workers sharing the wasm memory (SharedArrayBuffer), which needs a build with pthreads,
+// see the standalone Makefile. Without them all background work runs inline, outside of the audio processing.
+#if !defined(DISTRHO_OS_WASM) || defined(__EMSCRIPTEN_PTHREADS__)
+# define AIDAX_THREADS 1
+#else
+# define AIDAX_THREADS 0
+#endif
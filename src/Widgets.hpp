@@ -229,12 +229,11 @@ protected:
 };
 
 // --------------------------------------------------------------------------------------------------------------------
-// simple vertical meter
+// simple vertical meter, values are applied by the parent at its own refresh rate and only repainted on visible changes
 
 class AidaMeter : public NanoSubWidget
 {
     NanoTopLevelWidget* const parent;
-    Application& app;
     const String label;
 
     bool clipping = false;
@@ -244,6 +243,12 @@ class AidaMeter : public NanoSubWidget
     float valueDb = kMinimumMeterDb;
     float valueDb2 = kMinimumMeterDb; // average filter
 
+    // what is currently on screen
+    enum ActiveColor { kColorNormal, kColorNearClipping, kColorClipping };
+    ActiveColor activeColor = kColorNormal;
+    int barWidth = 0;
+    char valuestr[32] = {};
+
 public:
     static constexpr const uint kMeterWidth = 150;
     static constexpr const uint kMeterHeight = kSubWidgetsFontSize + kSubWidgetsPadding / 2;
@@ -252,71 +257,96 @@ public:
     AidaMeter(NanoTopLevelWidget* const p, const char* const lbl)
         : NanoSubWidget(p),
           parent(p),
-          app(parent->getApp()),
           label(lbl)
     {
         const double scaleFactor = p->getScaleFactor();
         setSize(kMeterWidth * scaleFactor, kMeterHeight * scaleFactor);
+
+        std::strncpy(valuestr, "-inf dB", sizeof(valuestr)-1);
     }
 
     void setValue(const float v)
     {
-        if (d_isEqual(value, v))
-            return;
-
         value = v;
         valueDb = 20.f * std::log10(v);
-
-        repaint();
     }
 
-protected:
-    void onNanoDisplay() override
+    // advance the average filter with the last value, repainting only if text, color or bar size changed
+    void updateDisplay()
     {
-        const uint width = getWidth();
-        const uint height = getHeight();
-
-        const double scaleFactor = parent->getScaleFactor();
-        const double meterRadius = kMeterRadius * scaleFactor;
-        const double meterPadding = kSubWidgetsPadding * scaleFactor;
-        const double wfontSize = kSubWidgetsFontSize * scaleFactor;
-
         const float filteredDb = valueDb2 = (valueDb + valueDb2) / 2.f;
 
-        fontSize(wfontSize);
-
-        beginPath();
-        roundedRect(0, 0, width, height, meterRadius);
-        fillColor(Color(0x38,0x37,0x5c));
-        fill();
-
-        char valuestr[32] = {};
+        char newvaluestr[32] = {};
 
         if (filteredDb > kMinimumMeterDb)
-            std::snprintf(valuestr, sizeof(valuestr)-1, "%.1f dB", valueDb);
+            std::snprintf(newvaluestr, sizeof(newvaluestr)-1, "%.1f dB", valueDb);
         else
-            std::strncpy(valuestr, "-inf dB", sizeof(valuestr)-1);
+            std::strncpy(newvaluestr, "-inf dB", sizeof(newvaluestr)-1);
 
-        Color activeColor;
+        ActiveColor newActiveColor;
 
         if (valueDb > 0.f || (filteredDb > (clipping ? -3.f : 0.f)))
         {
             clipping = nearClipping = true;
-            activeColor = Color(0xf4,0x4d,0x50); // #F44D50
+            newActiveColor = kColorClipping;
         }
         else if (filteredDb > (nearClipping ? -6.f : -3.f))
         {
             nearClipping = true;
-            activeColor = Color(0xf4,0xf1,0x4d); // #F4F14D
+            newActiveColor = kColorNearClipping;
         }
         else
         {
             clipping = nearClipping = false;
-            activeColor = Color(0xa4,0xf4,0x4d); // #A4F44D
+            newActiveColor = kColorNormal;
         }
 
+        const double scaleFactor = parent->getScaleFactor();
+        const int newBarWidth = valueDb > kMinimumMeterDb
+                              ? d_roundToInt(normalizedLevelMeterValue(filteredDb) * (getWidth() - scaleFactor * 2))
+                              : 0;
+
+        if (activeColor == newActiveColor && barWidth == newBarWidth && std::strcmp(valuestr, newvaluestr) == 0)
+            return;
+
+        activeColor = newActiveColor;
+        barWidth = newBarWidth;
+        std::memcpy(valuestr, newvaluestr, sizeof(valuestr));
+
+        repaint();
+    }
+
+protected:
+    void onNanoDisplay() override
+    {
+        const uint width = getWidth();
+        const uint height = getHeight();
+
+        const double scaleFactor = parent->getScaleFactor();
+        const double meterRadius = kMeterRadius * scaleFactor;
+        const double meterPadding = kSubWidgetsPadding * scaleFactor;
+        const double wfontSize = kSubWidgetsFontSize * scaleFactor;
+
+        fontSize(wfontSize);
+
+        beginPath();
+        roundedRect(0, 0, width, height, meterRadius);
+        fillColor(Color(0x38,0x37,0x5c));
+        fill();
+
         // draw text using active color
-        fillColor(activeColor);
+        switch (activeColor)
+        {
+        case kColorClipping:
+            fillColor(Color(0xf4,0x4d,0x50)); // #F44D50
+            break;
+        case kColorNearClipping:
+            fillColor(Color(0xf4,0xf1,0x4d)); // #F4F14D
+            break;
+        case kColorNormal:
+            fillColor(Color(0xa4,0xf4,0x4d)); // #A4F44D
+            break;
+        }
 
         textAlign(ALIGN_LEFT|ALIGN_MIDDLE);
         text(meterPadding, height/2, label, nullptr);
@@ -324,23 +354,18 @@ protected:
         textAlign(ALIGN_RIGHT|ALIGN_MIDDLE);
         text(width - meterPadding, height/2, valuestr, nullptr);
 
-        if (valueDb > kMinimumMeterDb)
+        if (barWidth > 0)
         {
-            const float vnormal = normalizedLevelMeterValue(filteredDb);
-
             // draw active background
             beginPath();
-            roundedRect(scaleFactor, scaleFactor,
-                        vnormal * (width - scaleFactor * 2),
-                        height - scaleFactor * 2,
-                        meterRadius);
+            roundedRect(scaleFactor, scaleFactor, barWidth, height - scaleFactor * 2, meterRadius);
             fill();
 
             // draw text on top of active color using background color
             fillColor(Color(0x38,0x37,0x5c));
 
             save();
-            scissor(0, 0, vnormal * width, height);
+            scissor(0, 0, barWidth + scaleFactor, height);
 
             textAlign(ALIGN_LEFT|ALIGN_MIDDLE);
             text(meterPadding, height/2, label, nullptr);
@@ -783,6 +808,7 @@ class AidaFilenameButton : public NanoSubWidget
         } labels;
 
         String filename;
+        String details;
         AidaFileSwitch* hoverButton = nullptr;
 
         AidaFileButton(NanoTopLevelWidget* const p, const String& label)
@@ -832,12 +858,21 @@ class AidaFilenameButton : public NanoSubWidget
             fontSize(16 * scaleFactor);
             textAlign(ALIGN_LEFT | ALIGN_MIDDLE);
             save();
-            scissor(buttonMargin, 0, width - buttonMargin, height/2 + 16 * scaleFactor / 2);
-            textBox(buttonMargin, height/2, width - buttonMargin,
+            const double detailsWidth = details.isNotEmpty() ? 60 * scaleFactor : 0.0;
+            scissor(buttonMargin, 0, width - buttonMargin - detailsWidth, height/2 + 16 * scaleFactor / 2);
+            textBox(buttonMargin, height/2, width - buttonMargin - detailsWidth,
                     hoverButton->isHover() ? hoverButton->isChecked() ? labels.disable : labels.enable
                                            : getState() & kButtonStateHover ? labels.load : filename,
                     nullptr);
             restore();
+
+            if (details.isNotEmpty())
+            {
+                fillColor(Color(1.f, 1.f, 1.f, 0.6f));
+                fontSize(13 * scaleFactor);
+                textAlign(ALIGN_RIGHT | ALIGN_MIDDLE);
+                text(width - kSubWidgetsPadding * scaleFactor, height/2, details, nullptr);
+            }
         }
 
         bool onMouse(const MouseEvent& event) override
@@ -891,6 +926,13 @@ public:
         button->repaint();
     }
 
+    /* Extra info shown on the right side, e.g. the cabinet IR length */
+    void setDetails(const char* const details)
+    {
+        button->details = details;
+        button->repaint();
+    }
+
 protected:
     void onNanoDisplay() override {}
 
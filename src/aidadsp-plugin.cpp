@@ -7,16 +7,17 @@
 
 #include "DistrhoPlugin.hpp"
 
-#include "Biquad.h"
+#include "AidaDSP.hpp"
+#include "AsyncModelLoader.hpp"
+#include "ModelBank.hpp"
+#include "DSPPipeline.hpp"
+#include "DSPProfiler.hpp"
 #include "Files.hpp"
 
-#include "model_variant.hpp"
 #include "extra/ScopedDenormalDisable.hpp"
 #include "extra/Sleep.hpp"
-#include "extra/ValueSmoother.hpp"
 
 #include <atomic>
-#include <strstream>
 
 #include "dr_flac.h"
 #include "dr_wav.h"
@@ -24,267 +25,60 @@
 #include "CDSPResampler.h"
 
 // must be last
-#include "TwoStageThreadedConvolver.hpp"
-
-START_NAMESPACE_DISTRHO
-
-// --------------------------------------------------------------------------------------------------------------------
-
-/* Define a constexpr for converting a gain in dB to a coefficient */
-static constexpr float DB_CO(const float g) { return g > -90.f ? std::pow(10.f, g * 0.05f) : 0.f; }
-
-/* Define a macro to re-maps a number from one range to another  */
-static constexpr float MAP(const float x, const float in_min, const float in_max, const float out_min, const float out_max)
-{
-    return ((x - in_min) * (out_max - out_min) / (in_max - in_min)) + out_min;
-}
-
-/* Defines for tone controls */
-static constexpr const float COMMON_Q = 0.707f;
-static constexpr const float DEPTH_FREQ = 75.f;
-static constexpr const float PRESENCE_FREQ = 900.f;
-
-/* Defines for antialiasing filter */
-static constexpr const float INLPF_MAX_CO = 0.99f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
-static constexpr const float INLPF_MIN_CO = 0.25f * 0.5f; /* coeff * ((samplerate / 2) / samplerate) */
-
-/* Gain compensation for cabinet IR (-12dB) */
-static constexpr const float kCabinetMaxGain = 0.251f;
-
-// --------------------------------------------------------------------------------------------------------------------
-
-struct AidaToneControl {
-    Biquad dc_blocker { bq_type_highpass, 0.5f, COMMON_Q, 0.0f };
-    Biquad in_lpf { bq_type_lowpass, 0.5f, COMMON_Q, 0.0f };
-    Biquad bass { bq_type_lowshelf, 0.5f, COMMON_Q, 0.0f };
-    Biquad mid { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
-    Biquad treble { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
-    Biquad depth { bq_type_peak, 0.5f, COMMON_Q, 0.0f };
-    Biquad presence { bq_type_highshelf, 0.5f, COMMON_Q, 0.0f };
-    ExponentialValueSmoother inlevel;
-    ExponentialValueSmoother outlevel;
-    bool net_bypass = false;
-    bool eq_bypass = false;
-    EqPos eq_pos = kEqPost;
-    MidEqType mid_type = kMidEqPeak;
-
-    AidaToneControl()
-    {
-        inlevel.setTimeConstant(1);
-        outlevel.setTimeConstant(1);
-    }
-
-    void setSampleRate(const float parameters[kNumParameters], const double sampleRate)
-    {
-        dc_blocker.setFc(35.0f / sampleRate);
-
-        in_lpf.setFc(MAP(parameters[kParameterINLPF], 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
-
-        bass.setBiquad(bq_type_lowshelf,
-                       parameters[kParameterBASSFREQ] / sampleRate, COMMON_Q, parameters[kParameterBASSGAIN]);
-
-        mid.setBiquad(mid_type == kMidEqBandpass ? bq_type_bandpass : bq_type_peak,
-                      parameters[kParameterMIDFREQ] / sampleRate,
-                      parameters[kParameterMIDQ],
-                      parameters[kParameterMIDGAIN]);
-
-        treble.setBiquad(bq_type_highshelf,
-                         parameters[kParameterTREBLEFREQ] / sampleRate, COMMON_Q, parameters[kParameterTREBLEGAIN]);
-
-        depth.setBiquad(bq_type_peak,
-                        DEPTH_FREQ / sampleRate, COMMON_Q, parameters[kParameterDEPTH]);
-
-        presence.setBiquad(bq_type_highshelf,
-                           PRESENCE_FREQ / sampleRate, COMMON_Q, parameters[kParameterPRESENCE]);
-
-        inlevel.setSampleRate(sampleRate);
-        inlevel.setTargetValue(DB_CO(parameters[kParameterINLEVEL]));
-
-        outlevel.setSampleRate(sampleRate);
-        outlevel.setTargetValue(DB_CO(parameters[kParameterOUTLEVEL]));
-    }
-};
-
+#include "AsyncCabinetLoader.hpp"
 #if AIDAX_WITH_AUDIOFILE
-struct AudioFile {
-    float* buffer;
-    drwav_uint64 currentFrame;
-    drwav_uint64 numFrames;
-    bool resampled;
-
-    AudioFile(float* const buffer_, const drwav_uint64 numFrames_, const bool resampled_) noexcept
-        : buffer(buffer_),
-          currentFrame(0),
-          numFrames(numFrames_),
-          resampled(resampled_) {}
-
-    ~AudioFile() noexcept
-    {
-        if (resampled)
-            delete[] buffer;
-        else
-            drwav_free(buffer, nullptr);
-    }
-};
+# include "AsyncAudioFileReader.hpp"
 #endif
 
-struct DynamicModel {
-    ModelVariantType variant;
-    bool input_skip; /* Means the model has been trained with first input element skipped to the output */
-    float input_gain;
-    float output_gain;
-};
-
-// --------------------------------------------------------------------------------------------------------------------
-// Apply a gain ramp to a buffer
-
-static void applyGainRamp(ExponentialValueSmoother& smoother, float* const out, const uint32_t numSamples)
-{
-    for (uint32_t i=0; i<numSamples; ++i)
-        out[i] *= smoother.next();
-}
-
-// --------------------------------------------------------------------------------------------------------------------
-// Apply filter
-
-static void applyBiquadFilter(Biquad& filter, float* const out, const float* const in, const uint32_t numSamples)
-{
-    for (uint32_t i=0; i<numSamples; ++i)
-        out[i] = filter.process(in[i]);
-}
-
-static void applyBiquadFilter(Biquad& filter, float* const out, const uint32_t numSamples)
-{
-    for (uint32_t i=0; i<numSamples; ++i)
-        out[i] = filter.process(out[i]);
-}
+START_NAMESPACE_DISTRHO
 
 // --------------------------------------------------------------------------------------------------------------------
-// Apply biquad cascade filters
 
-static void applyToneControls(AidaToneControl& aida, float* const out, uint32_t numSamples)
-{
-    if (aida.mid_type == kMidEqBandpass)
-    {
-        applyBiquadFilter(aida.mid, out, numSamples);
-    }
-    else
-    {
-        applyBiquadFilter(aida.depth, out, numSamples);
-        applyBiquadFilter(aida.bass, out, numSamples);
-        applyBiquadFilter(aida.mid, out, numSamples);
-        applyBiquadFilter(aida.treble, out, numSamples);
-        applyBiquadFilter(aida.presence, out, numSamples);
-    }
-}
+/* Crossfade time when switching between models */
+static constexpr const double kModelCrossfadeTime = 0.05;
 
-// --------------------------------------------------------------------------------------------------------------------
-// This function carries model calculations
+/* Crossfade time when switching between cabinets */
+static constexpr const double kCabinetCrossfadeTime = 0.05;
 
-void applyModel(DynamicModel* model, float* const out, uint32_t numSamples,
-                LinearValueSmoother& param1, LinearValueSmoother& param2)
-{
-    const bool input_skip = model->input_skip;
-    const float input_gain = model->input_gain;
-    const float output_gain = model->output_gain;
+/* Level below which both input and output need to stay for processing to go idle */
+static constexpr const float kIdleThresholdDb = -80.f;
 
-    std::visit(
-        [&out, numSamples, input_skip, input_gain, output_gain, &param1, &param2] (auto&& custom_model)
-        {
-            using ModelType = std::decay_t<decltype (custom_model)>;
+/* Time input needs to be silent before going idle, in addition to the cabinet IR length */
+static constexpr const double kIdleHoldTime = 0.5;
 
-            if (d_isNotEqual(input_gain, 1.f))
-            {
-                for (uint32_t i=0; i<numSamples; ++i)
-                    out[i] *= input_gain;
-            }
-
-            if constexpr (ModelType::input_size == 1)
-            {
-                if (input_skip)
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                        out[i] += custom_model.forward(out + i);
-                }
-                else
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                        out[i] = custom_model.forward(out + i) * output_gain;
-                }
-            }
-            else if constexpr (ModelType::input_size == 2)
-            {
-                float inArray1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[2];
-
-                if (input_skip)
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray1[0] = out[i];
-                        inArray1[1] = param1.next();
-                        out[i] += custom_model.forward(inArray1);
-                    }
-                }
-                else
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray1[0] = out[i];
-                        inArray1[1] = param1.next();
-                        out[i] = custom_model.forward(inArray1) * output_gain;
-                    }
-                }
-            }
-            else if constexpr (ModelType::input_size == 3)
-            {
-                float inArray2 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3];
-
-                if (input_skip)
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray2[0] = out[i];
-                        inArray2[1] = param1.next();
-                        inArray2[2] = param2.next();
-                        out[i] += custom_model.forward(inArray2);
-                    }
-                }
-                else
-                {
-                    for (uint32_t i=0; i<numSamples; ++i)
-                    {
-                        inArray2[0] = out[i];
-                        inArray2[1] = param1.next();
-                        inArray2[2] = param2.next();
-                        out[i] = custom_model.forward(inArray2) * output_gain;
-                    }
-                }
-            }
-
-            if (input_skip && d_isNotEqual(output_gain, 1.f))
-            {
-                for (uint32_t i=0; i<numSamples; ++i)
-                    out[i] *= output_gain;
-            }
-        },
-        model->variant
-    );
-}
+/* Fade-in time when processing resumes from idle */
+static constexpr const double kIdleWakeFadeTime = 0.001;
 
 // --------------------------------------------------------------------------------------------------------------------
 
 class AidaDSPLoaderPlugin : public Plugin
 {
     AidaToneControl aida;
+    AsyncModelLoader modelLoader;
+    // warm models for instant switching, the one playing is checked out into model
+    ModelBank modelBank;
+    uint32_t modelSlot = 0;
+    uint32_t playingSlot = 0;
     DynamicModel* model = nullptr;
-    TwoStageThreadedConvolver* cabsim = nullptr;
-    std::atomic<bool> activeModel { false };
-    std::atomic<bool> activeConvolver { false };
-    String cabsimFilename;
+    DynamicModel* fadingModel = nullptr;
+    // bank slot the fading model goes back to, -1 to retire it
+    int fadingSlot = -1;
+    float* fadingModelInplaceBuffer[kNumDSPChannels] = {};
+    uint32_t modelFadeFrames = 0;
+    uint32_t modelFadeFramesLeft = 0;
+    AsyncCabinetLoader cabinetLoader;
+    PartitionedConvolver* cabsim = nullptr;
+    PartitionedConvolver* fadingCabsim = nullptr;
+    float* fadingCabsimInplaceBuffer[kNumDSPChannels] = {};
+    uint32_t cabsimFadeFrames = 0;
+    uint32_t cabsimFadeFramesLeft = 0;
     ExponentialValueSmoother cabsimGain;
-    float* cabsimInplaceBuffer = nullptr;
+    float* cabsimInplaceBuffer[kNumDSPChannels] = {};
     ExponentialValueSmoother bypassGain;
-    float* bypassInplaceBuffer = nullptr;
+    float* bypassInplaceBuffer[kNumDSPChannels] = {};
+    // dry and model bypass signals, delayed by the latency of the model
+    LatencyDelay dryDelay[kNumDSPChannels];
+    LatencyDelay modelBypassDelay[kNumDSPChannels];
     float parameters[kNumParameters];
     LinearValueSmoother param1;
     LinearValueSmoother param2;
@@ -292,16 +86,40 @@ class AidaDSPLoaderPlugin : public Plugin
     bool enabledDC = true;
     bool paramFirstRun = true;
     std::atomic<bool> resetMeters { true };
+    std::atomic<uint32_t> dirtyFilters { 0 };
     float tmpMeterIn, tmpMeterOut;
     uint32_t tmpMeterFrames, meterMaxFrameCount;
+    // model, DC blocker and cabinet are not processed while idle, keeping their state for when signal returns
+    bool idle = false;
+    uint32_t idleSilentFrames = 0;
+    uint32_t idleHoldFrames = 0;
+    uint32_t idleWakeFrames = 0;
+    uint32_t idleWakeFramesLeft = 0;
+    // DC blocker and cabinet running one block behind the model, on a worker thread
+    struct CabinetPipeline : DSPPipeline {
+        AidaDSPLoaderPlugin& plugin;
+
+        explicit CabinetPipeline(AidaDSPLoaderPlugin& p) noexcept
+            : plugin(p) {}
+
+    protected:
+        void processPipelineStage(float* outs[kNumDSPChannels], const uint32_t numSamples, const bool idle) override
+        {
+            plugin.processDCBlocker(outs, numSamples, idle);
+            plugin.processCabinet(outs, numSamples, idle);
+        }
+    } pipeline;
+    bool enabledPipeline = false;
+    bool pipelined = false;
+    DSPProfiler profiler;
    #if AIDAX_WITH_AUDIOFILE
-    AudioFile* audiofile = nullptr;
-    std::atomic<bool> activeAudiofile { false };
+    AsyncAudioFileReader audiofileReader;
    #endif
 
 public:
     AidaDSPLoaderPlugin()
-        : Plugin(kNumParameters, 0, kStateCount) // parameters, programs, states
+        : Plugin(kNumParameters, 0, kStateCount), // parameters, programs, states
+          pipeline(*this)
     {
         // Initialize parameters to their defaults
         for (uint i=0; i<kNumParameters; ++i)
@@ -313,29 +131,55 @@ public:
         cabsimGain.setTimeConstant(0.1f);
         cabsimGain.setTargetValue(kCabinetMaxGain);
 
-        param1.setTimeConstant(0.1f);
+        param1.setTimeConstant(kModelParamSmoothTime);
         param1.setTargetValue(parameters[kParameterPARAM1]);
 
-        param2.setTimeConstant(0.1f);
+        param2.setTimeConstant(kModelParamSmoothTime);
         param2.setTargetValue(parameters[kParameterPARAM2]);
 
         // initialize
         bufferSizeChanged(getBufferSize());
         sampleRateChanged(getSampleRate());
 
-        // load default model
-        loadDefaultModel();
+        // load default model, right away as we are not processing yet
+        {
+            using namespace Files;
+
+            modelLoader.loadModel(tw40_california_clean_deerinkstudiosData,
+                                  tw40_california_clean_deerinkstudiosDataSize,
+                                  parameters[kParameterPARAM1],
+                                  parameters[kParameterPARAM2]);
+            modelBank.takePreparedModels(modelLoader);
+            model = modelBank.takeModel(0);
+
+            if (model != nullptr)
+                parameters[kParameterModelInputSize] = model->input_size;
+
+            updateLatency();
+        }
+
+        // same for the default cabinet
+        cabinetLoader.loadCabinet(nullptr);
+        cabsim = cabinetLoader.takeCabinet();
+        updateCabinetLength();
+
+        // PIPELINE can be switched on from the audio thread at any time, where the worker pool cannot be changed
+        pipeline.registerWorker();
     }
 
     ~AidaDSPLoaderPlugin()
     {
         delete model;
+        delete fadingModel;
         delete cabsim;
-       #if AIDAX_WITH_AUDIOFILE
-        delete audiofile;
-       #endif
-        delete[] bypassInplaceBuffer;
-        delete[] cabsimInplaceBuffer;
+        delete fadingCabsim;
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            delete[] bypassInplaceBuffer[c];
+            delete[] cabsimInplaceBuffer[c];
+            delete[] fadingCabsimInplaceBuffer[c];
+            delete[] fadingModelInplaceBuffer[c];
+        }
     }
 
 protected:
@@ -398,7 +242,11 @@ protected:
     */
     int64_t getUniqueId() const override
     {
+       #if AIDAX_STEREO
+        return d_cconst('a', 'i', 'd', 's');
+       #else
         return d_cconst('a', 'i', 'd', 'a');
+       #endif
     }
 
    /* -----------------------------------------------------------------------------------------------------------------
@@ -410,8 +258,12 @@ protected:
     */
     void initAudioPort(const bool input, const uint32_t index, AudioPort& port) override
     {
-        // treat meter audio ports as mono
+        // stereo builds have a left/right pair, mono ones a single channel
+       #if AIDAX_STEREO
+        port.groupId = kPortGroupStereo;
+       #else
         port.groupId = kPortGroupMono;
+       #endif
 
         // everything else is as default
         Plugin::initAudioPort(input, index, port);
@@ -436,6 +288,24 @@ protected:
                 parameter.enumValues.deleteLater = false;
             }
             break;
+        case kParameterCABSIMMAXLEN:
+            {
+                static ParameterEnumerationValue values[1] = {
+                    { 0.f, "Unlimited" }
+                };
+                parameter.enumValues.values = values;
+                parameter.enumValues.deleteLater = false;
+            }
+            break;
+        case kParameterBANK:
+            {
+                static ParameterEnumerationValue values[1] = {
+                    { 0.f, "Main model" }
+                };
+                parameter.enumValues.values = values;
+                parameter.enumValues.deleteLater = false;
+            }
+            break;
         case kParameterGLOBALBYPASS:
             parameter.designation = kParameterDesignationBypass;
             {
@@ -478,6 +348,12 @@ protected:
             state.fileTypes = "cabsim";
            #endif
             break;
+        case kStateModelBank:
+            state.key = "bank";
+            state.defaultValue = "";
+            state.label = "Model Bank";
+            state.description = "Model files for bank slots 1 to 8, one per line";
+            break;
        #if AIDAX_WITH_AUDIOFILE
         case kStateAudioFile:
             state.hints = kStateIsFilenamePath;
@@ -513,12 +389,10 @@ protected:
     {
         parameters[index] = value;
 
-        const double sampleRate = getSampleRate();
-
         switch (static_cast<Parameters>(index))
         {
         case kParameterINLPF:
-            aida.in_lpf.setFc(MAP(value, 0.0f, 100.0f, INLPF_MAX_CO, INLPF_MIN_CO));
+            dirtyFilters |= kFilterInLPF;
             enabledLPF = d_isNotZero(value);
             break;
         case kParameterINLEVEL:
@@ -534,34 +408,35 @@ protected:
             aida.eq_pos = value > 0.5f ? kEqPre : kEqPost;
             break;
         case kParameterBASSGAIN:
-            aida.bass.setPeakGain(value);
+            dirtyFilters |= kFilterBass;
             break;
         case kParameterBASSFREQ:
-            aida.bass.setFc(value / sampleRate);
+            dirtyFilters |= kFilterBass;
             break;
         case kParameterMIDGAIN:
-            aida.mid.setPeakGain(value);
+            dirtyFilters |= kFilterMid;
             break;
         case kParameterMIDFREQ:
-            aida.mid.setFc(value / sampleRate);
+            dirtyFilters |= kFilterMid;
             break;
         case kParameterMIDQ:
-            aida.mid.setQ(value);
+            dirtyFilters |= kFilterMid;
             break;
         case kParameterMTYPE:
             aida.mid_type = value > 0.5f ? kMidEqBandpass : kMidEqPeak;
+            dirtyFilters |= kFilterMid;
             break;
         case kParameterTREBLEGAIN:
-            aida.treble.setPeakGain(value);
+            dirtyFilters |= kFilterTreble;
             break;
         case kParameterTREBLEFREQ:
-            aida.treble.setFc(value / sampleRate);
+            dirtyFilters |= kFilterTreble;
             break;
         case kParameterDEPTH:
-            aida.depth.setPeakGain(value);
+            dirtyFilters |= kFilterDepth;
             break;
         case kParameterPRESENCE:
-            aida.presence.setPeakGain(value);
+            dirtyFilters |= kFilterPresence;
             break;
         case kParameterOUTLEVEL:
             aida.outlevel.setTargetValue(DB_CO(value));
@@ -581,9 +456,26 @@ protected:
         case kParameterDCBLOCKER:
             enabledDC = value > 0.5f;
             break;
+        case kParameterCABSIMMAXLEN:
+            cabinetLoader.setMaxLength(static_cast<uint32_t>(value + 0.5f));
+            break;
+        case kParameterMODELRATE:
+            modelLoader.setModelRate(value > 0.5f);
+            break;
+        case kParameterPIPELINE:
+            enabledPipeline = value > 0.5f;
+            break;
+        case kParameterBANK:
+            modelSlot = std::min<uint32_t>(kModelBankSlots, std::max(0.f, value) + 0.5f);
+            break;
         case kParameterModelInputSize:
         case kParameterMeterIn:
         case kParameterMeterOut:
+        case kParameterCabinetLength:
+        case kParameterDSPLoad:
+        case kParameterDSPLoadPeak:
+        case kParameterDSPOverruns:
+        case kParameterDSPOverrunStage:
         case kParameterCount:
             break;
         }
@@ -591,6 +483,13 @@ protected:
 
     void setState(const char* const key, const char* const value) override
     {
+        // without threads the UI sends this regularly, for the loaders to handle changes made from setParameterValue
+        modelLoader.idle();
+        cabinetLoader.idle();
+
+        if (std::strcmp(key, "idle") == 0)
+            return;
+
         if (std::strcmp(key, "reset-meters") == 0)
         {
             resetMeters.store(true);
@@ -603,6 +502,8 @@ protected:
             return isDefault ? loadDefaultModel() : loadModelFromFile(value);
         if (std::strcmp(key, "cabinet") == 0)
             return isDefault ? loadDefaultCabinet() : loadCabinetFromFile(value);
+        if (std::strcmp(key, "bank") == 0)
+            return loadModelBank(value != nullptr ? value : "");
        #if AIDAX_WITH_AUDIOFILE
         if (std::strcmp(key, "audiofile") == 0)
             return loadAudioFile(value);
@@ -616,211 +517,159 @@ protected:
     {
         using namespace Files;
 
-        try {
-            std::istrstream jsonStream(static_cast<const char*>(static_cast<const void*>(tw40_california_clean_deerinkstudiosData)),
-                                       tw40_california_clean_deerinkstudiosDataSize);
-            loadModelFromStream(jsonStream);
-        }
-        catch (const std::exception& e) {
-            d_stderr2("Unable to load json, error: %s", e.what());
-        };
+        modelLoader.requestModel(tw40_california_clean_deerinkstudiosData,
+                                 tw40_california_clean_deerinkstudiosDataSize,
+                                 parameters[kParameterPARAM1],
+                                 parameters[kParameterPARAM2]);
     }
 
     void loadModelFromFile(const char* const filename)
     {
-        try {
-            std::ifstream jsonStream(filename, std::ifstream::binary);
-            loadModelFromStream(jsonStream);
-        }
-        catch (const std::exception& e) {
-            d_stderr2("Unable to load json file: %s\nError: %s", filename, e.what());
-        };
+        modelLoader.requestModel(filename, parameters[kParameterPARAM1], parameters[kParameterPARAM2]);
     }
 
-    void loadModelFromStream(std::istream& jsonStream)
+    void loadModelBank(const char* const fileList)
     {
-        int input_size;
-        int input_skip;
-        float input_gain;
-        float output_gain;
-        nlohmann::json model_json;
-
-        try {
-            jsonStream >> model_json;
-
-            /* Understand which model type to load */
-            input_size = model_json["in_shape"].back().get<int>();
-            if (input_size > MAX_INPUT_SIZE) {
-                throw std::invalid_argument("Value for input_size not supported");
-            }
+        // warm models only need a worker once there are some
+        if (fileList[0] != '\0')
+            modelBank.registerWorker();
 
-            if (model_json["in_skip"].is_number()) {
-                input_skip = model_json["in_skip"].get<int>();
-                if (input_skip > 1)
-                    throw std::invalid_argument("Values for in_skip > 1 are not supported");
-            }
-            else {
-                input_skip = 0;
-            }
+        modelLoader.requestBankModels(fileList);
+    }
 
-            if (model_json["in_gain"].is_number()) {
-                input_gain = DB_CO(model_json["in_gain"].get<float>());
-            }
-            else {
-                input_gain = 1.0f;
-            }
+   /**
+      Pick up models prepared by the loader thread, and switch to the selected bank slot, fading out the current model.
+      Must be called from the audio thread.
+    */
+    void swapPreparedModel()
+    {
+        modelBank.takePreparedModels(modelLoader);
 
-            if (model_json["out_gain"].is_number()) {
-                output_gain = DB_CO(model_json["out_gain"].get<float>());
-            }
-            else {
-                output_gain = 1.0f;
-            }
-        }
-        catch (const std::exception& e) {
-            d_stderr2("Unable to load json, error: %s", e.what());
+        // make sure the fading model can be retired without blocking
+        if (! modelLoader.canRetireModels(1))
             return;
-        }
 
-        std::unique_ptr<DynamicModel> newmodel = std::make_unique<DynamicModel>();
+        // empty bank slots play the main model
+        const uint32_t slot = modelBank.isAvailable(modelSlot) ? modelSlot : 0;
 
-        try {
-            if (! custom_model_creator (model_json, newmodel->variant))
-                throw std::runtime_error ("Unable to identify a known model architecture!");
+        // nothing to do unless switching slots, or a newer model came in for the one playing
+        if (slot == playingSlot && ! modelBank.hasModel(slot))
+            return;
 
-            std::visit (
-                [&model_json] (auto&& custom_model)
-                {
-                    using ModelType = std::decay_t<decltype (custom_model)>;
-                    if constexpr (! std::is_same_v<ModelType, NullModel>)
-                    {
-                        custom_model.parseJson (model_json, true);
-                        custom_model.reset();
-                    }
-                },
-                newmodel->variant);
-        }
-        catch (const std::exception& e) {
-            d_stderr2("Error loading model: %s", e.what());
+        // the fading model may be the one to switch back to, in which case it has to go back to the bank first
+        if (! modelBank.hasModel(slot) && (fadingModel == nullptr || fadingSlot != static_cast<int>(slot)))
             return;
-        }
 
-        param1.clearToTargetValue();
-        param2.clearToTargetValue();
-        paramFirstRun = true;
+        // a warm model still busy with the last block is picked up on the next one
+        if (modelBank.hasModel(slot) && ! modelBank.canTakeModel(slot))
+            return;
 
-        // save extra info
-        newmodel->input_skip = input_skip != 0;
-        newmodel->input_gain = input_gain;
-        newmodel->output_gain = output_gain;
+        if (fadingModel != nullptr)
+            releaseFadingModel();
 
-        // Pre-buffer to avoid "clicks" during initialization
-        float out[2048] = {};
-        applyModel(newmodel.get(), out, ARRAY_SIZE(out), param1, param2);
+        DynamicModel* const newmodel = modelBank.takeModel(slot);
 
-        // swap active model
-        DynamicModel* const oldmodel = model;
-        model = newmodel.release();
+        if (newmodel == nullptr)
+            return;
 
-        // if processing, wait for process cycle to complete
-        while (oldmodel != nullptr && activeModel.load())
-            d_msleep(1);
+        fadingModel = model;
+        fadingSlot = slot != playingSlot ? static_cast<int>(playingSlot) : -1;
+        model = newmodel;
+        playingSlot = slot;
+        modelFadeFramesLeft = fadingModel != nullptr ? modelFadeFrames : 0;
+        paramFirstRun = true;
 
         // report model in dim
-        parameters[kParameterModelInputSize] = input_size;
-
-        delete oldmodel;
+        parameters[kParameterModelInputSize] = newmodel->input_size;
+        updateLatency();
     }
 
-   /* -----------------------------------------------------------------------------------------------------------------
-    * Cabinet loader */
-
-    void loadDefaultCabinet()
+    /* give the fading model back to its bank slot, or retire it if it has none or was replaced in the meantime */
+    void releaseFadingModel()
     {
-        using namespace Files;
+        DynamicModel* const oldmodel = fadingSlot >= 0 ? modelBank.returnModel(fadingSlot, fadingModel) : fadingModel;
 
-        uint channels;
-        uint sampleRate;
-        drwav_uint64 numFrames;
-        float* const ir = drwav_open_memory_and_read_pcm_frames_f32(V30_P2_audix_i5_deerinkstudiosData,
-                                                                    V30_P2_audix_i5_deerinkstudiosDataSize,
-                                                                    &channels,
-                                                                    &sampleRate,
-                                                                    &numFrames,
-                                                                    nullptr);
-        DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr,);
-        DISTRHO_SAFE_ASSERT_RETURN(channels == 1,);
-
-        loadCabinet(channels, sampleRate, numFrames, ir);
+        if (oldmodel != nullptr)
+            modelLoader.retireModel(oldmodel);
+
+        fadingModel = nullptr;
+        fadingSlot = -1;
+        modelFadeFramesLeft = 0;
     }
 
-    void loadCabinetFromFile(const char* const filename)
+    /* report latency of the model in use and of pipelined processing, delaying signals that skip them to match */
+    void updateLatency()
     {
-        uint channels;
-        uint sampleRate;
-        drwav_uint64 numFrames;
-        const size_t valuelen = std::strlen(filename);
-
-        float* ir;
-        if (::strncasecmp(filename + std::max(0, static_cast<int>(valuelen) - 5), ".flac", 5) == 0)
-            ir = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        else
-            ir = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr,);
+        const uint32_t modelLatency = model != nullptr ? model->latency : 0;
+        const uint32_t latency = modelLatency + (pipelined ? pipeline.getLatency() : 0);
 
-        loadCabinet(channels, sampleRate, numFrames, ir);
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            dryDelay[c].setDelay(latency);
+            modelBypassDelay[c].setDelay(modelLatency);
+        }
 
-        cabsimFilename = filename;
+        setLatency(latency);
     }
 
-    void loadCabinet(const uint channels, const uint sampleRate, drwav_uint64 numFrames, float* const ir)
+   /**
+      Switch pipelined processing on or off as requested, dropping the frames it had in flight.
+      Must be called from the audio thread.
+    */
+    void updatePipelined()
     {
-        if (channels > 1)
-        {
-            for (drwav_uint64 i=0, j=0; j<numFrames; ++i, j+=channels)
-                ir[i] = ir[j];
-            numFrames /= channels;
-        }
+        // the extra delay no longer fits with huge host buffers, nor is pipelining needed there
+        const bool newPipelined = enabledPipeline && pipeline.getLatency() <= kMaxModelLatency;
 
-        d_stdout("Loading cabinet with %u channels, %u Hz sample rate and %lu frames",
-                 channels, sampleRate, (ulong)numFrames);
-
-        const double hostSampleRate = getSampleRate();
-        float* irBuf = ir;
+        if (pipelined == newPipelined)
+            return;
 
-        if (sampleRate != hostSampleRate)
-        {
-            r8b::CDSPResampler16IR resampler(sampleRate, hostSampleRate, numFrames);
-            const int numResampledFrames = resampler.getMaxOutLen(0);
-            DISTRHO_SAFE_ASSERT_RETURN(numResampledFrames > 0,);
+        pipelined = newPipelined;
+        pipeline.reset();
+        updateLatency();
+    }
 
-            d_stdout("Resampling to %f Hz sample rate and %d frames",
-                     hostSampleRate, numResampledFrames);
+   /* -----------------------------------------------------------------------------------------------------------------
+    * Cabinet loader */
 
-            float* const irBufResampled = new float[numResampledFrames];
-            resampler.oneshot(ir, numFrames, irBufResampled, numResampledFrames);
-            irBuf = irBufResampled;
+    void loadDefaultCabinet()
+    {
+        cabinetLoader.requestCabinet(nullptr);
+    }
 
-            numFrames = numResampledFrames;
-        }
+    void loadCabinetFromFile(const char* const filename)
+    {
+        cabinetLoader.requestCabinet(filename);
+    }
 
-        TwoStageThreadedConvolver* const newConvolver = new TwoStageThreadedConvolver();
-        newConvolver->init(irBuf, numFrames);
+   /**
+      Pick up a cabinet prepared by the loader thread, fading out the current one.
+      Must be called from the audio thread.
+    */
+    void swapPreparedCabinet()
+    {
+        // make sure both current and fading cabinets can be retired without blocking
+        if (! cabinetLoader.canRetireCabinets(2))
+            return;
 
-        if (irBuf != ir)
-            delete[] irBuf;
+        PartitionedConvolver* const newcabsim = cabinetLoader.takeCabinet();
 
-        drwav_free(ir, nullptr);
+        if (newcabsim == nullptr)
+            return;
 
-        // swap active cabsim
-        TwoStageThreadedConvolver* const oldcabsim = cabsim;
-        cabsim = newConvolver;
+        if (fadingCabsim != nullptr)
+            cabinetLoader.retireCabinet(fadingCabsim);
 
-        // if processing, wait for process cycle to complete
-        while (oldcabsim != nullptr && activeConvolver.load())
-            d_msleep(1);
+        fadingCabsim = cabsim;
+        cabsim = newcabsim;
+        cabsimFadeFramesLeft = fadingCabsim != nullptr ? cabsimFadeFrames : 0;
+        updateCabinetLength();
+    }
 
-        delete oldcabsim;
+    /* report effective IR length, after trimming and length limit */
+    void updateCabinetLength()
+    {
+        parameters[kParameterCabinetLength] = cabsim != nullptr ? cabsim->getLength() * 1000.0 / getSampleRate() : 0.f;
     }
 
    #if AIDAX_WITH_AUDIOFILE
@@ -830,58 +679,7 @@ protected:
 public:
     void loadAudioFile(const char* const filename)
     {
-        d_stdout("Loading filename %s", filename);
-
-        uint channels;
-        uint sampleRate;
-        drwav_uint64 numFrames;
-        float* data;
-        if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
-            data = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        else
-            data = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
-        DISTRHO_SAFE_ASSERT_RETURN(data != nullptr,);
-
-        // use left channel if not mono
-        if (channels > 1)
-        {
-            for (drwav_uint64 i=0, j=0; j<numFrames; ++i, j+=channels)
-                data[i] = data[j];
-            numFrames /= channels;
-        }
-
-        const double hostSampleRate = getSampleRate();
-
-        float* dataResampled;
-        if (sampleRate != hostSampleRate)
-        {
-            r8b::CDSPResampler24 resampler(sampleRate, hostSampleRate, numFrames);
-            const int numResampledFrames = resampler.getMaxOutLen(0);
-            DISTRHO_SAFE_ASSERT_RETURN(numResampledFrames > 0,);
-
-            dataResampled = new float[numResampledFrames];
-            resampler.oneshot(data, numFrames, dataResampled, numResampledFrames);
-
-            numFrames = numResampledFrames;
-        }
-        else
-        {
-            dataResampled = data;
-        }
-
-        if (dataResampled != data)
-            drwav_free(data, nullptr);
-
-        // swap active cabsim
-        AudioFile* const newaudiofile = new AudioFile(dataResampled, numFrames, dataResampled != data);
-        AudioFile* const oldaudiofile = audiofile;
-        audiofile = newaudiofile;
-
-        // if processing, wait for process cycle to complete
-        while (oldaudiofile != nullptr && activeAudiofile.load())
-            d_msleep(1);
-
-        delete oldaudiofile;
+        audiofileReader.requestFile(filename);
     }
 
 protected:
@@ -900,89 +698,117 @@ protected:
         bypassGain.clearToTargetValue();
         cabsimGain.clearToTargetValue();
         resetMeters.store(true);
+        profiler.reset();
+
+        idle = false;
+        idleSilentFrames = idleWakeFramesLeft = 0;
+
+        // pick up models prepared while not processing, without crossfading
+        swapPreparedModel();
+
+        if (fadingModel != nullptr)
+            releaseFadingModel();
+
+        if (PartitionedConvolver* const newcabsim = cabinetLoader.takeCabinet())
+        {
+            delete cabsim;
+            cabsim = newcabsim;
+            updateCabinetLength();
+        }
+
+        delete fadingCabsim;
+        fadingCabsim = nullptr;
+        cabsimFadeFramesLeft = 0;
+
+        pipeline.reset();
+        updatePipelined();
+        updateLatency();
 
         if (model != nullptr)
         {
             // Pre-buffer to avoid "clicks" during initialization
-            float out[2048] = {};
+            float out[kNumDSPChannels][2048] = {};
+            float* outs[kNumDSPChannels];
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                outs[c] = out[c];
 
-            activeModel.store(true);
-
-            std::visit (
-                [] (auto&& custom_model)
-                {
-                    using ModelType = std::decay_t<decltype (custom_model)>;
-                    if constexpr (! std::is_same_v<ModelType, NullModel>)
-                    {
-                        custom_model.reset();
-                    }
-                },
-                model->variant);
+            resetModel(model);
 
             param1.clearToTargetValue();
             param2.clearToTargetValue();
             paramFirstRun = true;
 
-            applyModel(model, out, ARRAY_SIZE(out), param1, param2);
-
-            activeModel.store(false);
+            if (! model->settled_reset)
+                applyModel(model, outs, ARRAY_SIZE(out[0]), param1, param2);
         }
     }
 
    /**
-      Run/process function for plugins without MIDI input.
+      Run/process function for plugins with MIDI input.
     */
-    void run(const float** inputs, float** outputs, uint32_t numSamples) override
+    void run(const float** inputs, float** outputs, uint32_t numSamples,
+             const MidiEvent* midiEvents, uint32_t midiEventCount) override
     {
-       #if DISTRHO_PLUGIN_NUM_INPUTS != 0
-        const float* const in = inputs[0];
-       #endif
-        /* */ float* const out = outputs[0];
+        // in stereo builds each channel has its own filter, model and convolver state, with shared parameters
+        float* outs[kNumDSPChannels];
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            outs[c] = outputs[c];
 
         // optimize for non-denormal usage
         const ScopedDenormalDisable sdd;
-        for (uint32_t i = 0; i < numSamples; ++i)
+
+        profiler.begin(numSamples);
+
+        // recompute filter coefficients changed since the last block, once regardless of how many events came in
+        if (const uint32_t filters = dirtyFilters.exchange(0))
+            aida.updateFilters(parameters, getSampleRate(), filters);
+
+        updatePipelined();
+
+        // program changes select the main model (0) or a bank slot, for the whole block
+        for (uint32_t i = 0; i < midiEventCount; ++i)
         {
-           #if DISTRHO_PLUGIN_NUM_INPUTS != 0
-            if (!std::isfinite(in[i]))
-                __builtin_unreachable();
-           #endif
-            if (!std::isfinite(out[i]))
-                __builtin_unreachable();
+            if (midiEvents[i].size == 2 && (midiEvents[i].data[0] & 0xF0) == 0xC0 && midiEvents[i].data[1] <= kModelBankSlots)
+                parameters[kParameterBANK] = modelSlot = midiEvents[i].data[1];
         }
 
-       #if AIDAX_WITH_AUDIOFILE
-        if (audiofile != nullptr)
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
         {
-            activeAudiofile.store(true);
-            const uint32_t numPartialSamples = std::min((uint32_t)(audiofile->numFrames - audiofile->currentFrame), numSamples);
-            std::memcpy(bypassInplaceBuffer, audiofile->buffer + audiofile->currentFrame, sizeof(float) * numPartialSamples);
-
-            if (numSamples != numPartialSamples)
-            {
-                const uint32_t extraSamples = numSamples - numPartialSamples;
-                std::memcpy(bypassInplaceBuffer, audiofile->buffer, sizeof(float) * extraSamples);
-                audiofile->currentFrame = extraSamples;
-            }
-            else
+            for (uint32_t i = 0; i < numSamples; ++i)
             {
-                audiofile->currentFrame += numSamples;
+               #if DISTRHO_PLUGIN_NUM_INPUTS != 0
+                if (!std::isfinite(inputs[c][i]))
+                    __builtin_unreachable();
+               #endif
+                if (!std::isfinite(outs[c][i]))
+                    __builtin_unreachable();
             }
-            activeAudiofile.store(false);
+        }
+
+       #if AIDAX_WITH_AUDIOFILE
+        if (audiofileReader.read(bypassInplaceBuffer[0], numSamples))
+        {
+            for (uint32_t c = 1; c < kNumDSPChannels; ++c)
+                std::memcpy(bypassInplaceBuffer[c], bypassInplaceBuffer[0], sizeof(float)*numSamples);
         }
         else
        #endif
         {
-           #if DISTRHO_PLUGIN_NUM_INPUTS != 0
-            // Copy input for bypass buffer
-            std::memcpy(bypassInplaceBuffer, in, sizeof(float)*numSamples);
-           #else
-            std::memset(bypassInplaceBuffer, 0, sizeof(float)*numSamples);
-           #endif
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            {
+               #if DISTRHO_PLUGIN_NUM_INPUTS != 0
+                // Copy input for bypass buffer
+                std::memcpy(bypassInplaceBuffer[c], inputs[c], sizeof(float)*numSamples);
+               #else
+                std::memset(bypassInplaceBuffer[c], 0, sizeof(float)*numSamples);
+               #endif
+            }
         }
 
         // peak meters
         float meterIn, meterOut;
+        float inputPeak = 0.f;
+        float outputPeak = 0.f;
 
         if (resetMeters.exchange(false))
         {
@@ -996,8 +822,15 @@ protected:
             tmpMeterFrames += numSamples;
         }
 
-        for (uint32_t i = 0; i < numSamples; ++i)
-            meterIn = std::max(meterIn, std::abs(bypassInplaceBuffer[i]));
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            for (uint32_t i = 0; i < numSamples; ++i)
+                inputPeak = std::max(inputPeak, std::abs(bypassInplaceBuffer[c][i]));
+        }
+
+        meterIn = std::max(meterIn, inputPeak);
+
+        profiler.stage(kDSPStageInput);
 
        #ifdef MOD_BUILD
         // Special handling for MOD web version: stop further audio processing on bypass
@@ -1009,22 +842,67 @@ protected:
        #endif
 
         // High frequencies roll-off (lowpass)
-        if (enabledLPF)
-            applyBiquadFilter(aida.in_lpf, out, bypassInplaceBuffer, numSamples);
-        else
-            std::memcpy(out, bypassInplaceBuffer, sizeof(float)*numSamples);
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            if (enabledLPF)
+                applyBiquadFilter(aida.in_lpf_stage[c], aida.in_lpf, outs[c], bypassInplaceBuffer[c], numSamples);
+            else
+                std::memcpy(outs[c], bypassInplaceBuffer[c], sizeof(float)*numSamples);
+        }
+
+        // dry signal is only used again for bypass
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            dryDelay[c].process(bypassInplaceBuffer[c], numSamples);
+
+        profiler.stage(kDSPStageLPF);
 
         // Pre-gain
-        applyGainRamp(aida.inlevel, out, numSamples);
+        applyGainRamp(aida.inlevel, outs, numSamples);
+        profiler.stage(kDSPStageInLevel);
 
         // Equalizer section
         if (!aida.eq_bypass && aida.eq_pos == kEqPre)
-            applyToneControls(aida, out, numSamples);
+        {
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                applyToneControls(aida, outs[c], numSamples, c);
+        }
+
+        profiler.stage(kDSPStageEqPre);
 
-        if (!aida.net_bypass && model != nullptr)
+        swapPreparedModel();
+
+        // the pipelined cabinet stages must not see it change while running
+        if (pipelined)
+            swapPreparedCabinet();
+
+        // Idle detection, any signal or pending crossfade resumes processing right away
+        if (inputPeak > DB_CO(kIdleThresholdDb) || fadingModel != nullptr || fadingCabsim != nullptr)
         {
-            activeModel.store(true);
+            idleSilentFrames = 0;
 
+            if (idle)
+            {
+                idle = false;
+                idleWakeFramesLeft = idleWakeFrames;
+            }
+        }
+        else if (idleSilentFrames < UINT32_MAX - numSamples)
+        {
+            idleSilentFrames += numSamples;
+        }
+
+        // cabinet stages of the previous block run on a worker while the model processes this one
+        if (pipelined)
+            pipeline.start();
+
+        if (idle)
+        {
+            // model state and parameter smoothing are left untouched until processing resumes
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                std::memset(outs[c], 0, sizeof(float)*numSamples);
+        }
+        else if (!aida.net_bypass && model != nullptr)
+        {
             if (paramFirstRun)
             {
                 paramFirstRun = false;
@@ -1032,57 +910,113 @@ protected:
                 param2.clearToTargetValue();
             }
 
-            applyModel(model, out, numSamples, param1, param2);
-            activeModel.store(false);
-        }
+            // other bank models run over the same input on workers, staying ready for switching
+            modelBank.warm(outs, numSamples, param1, param2);
 
-        // DC blocker filter (highpass)
-        if (enabledDC)
-            applyBiquadFilter(aida.dc_blocker, out, numSamples);
+            if (fadingModel != nullptr)
+            {
+                // old model runs on a copy of the input and parameter smoothers
+                LinearValueSmoother fadingParam1 = param1;
+                LinearValueSmoother fadingParam2 = param2;
 
-        // Cabinet convolution
-        if (cabsim != nullptr)
-        {
-            std::memcpy(cabsimInplaceBuffer, out, sizeof(float)*numSamples);
+                for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                    std::memcpy(fadingModelInplaceBuffer[c], outs[c], sizeof(float)*numSamples);
 
-            activeConvolver.store(true);
-            cabsim->process(cabsimInplaceBuffer, out, numSamples);
-            activeConvolver.store(false);
+                applyModel(fadingModel, fadingModelInplaceBuffer, numSamples, fadingParam1, fadingParam2);
+            }
 
-            // cabsim smooth bypass and -12dB compensation
-            for (uint32_t i = 0; i < numSamples; ++i)
+            applyModel(model, outs, numSamples, param1, param2);
+
+            if (fadingModel != nullptr)
             {
-                const float b = cabsimGain.next();
-                out[i] = out[i] * b + cabsimInplaceBuffer[i] * ((kCabinetMaxGain - b) / kCabinetMaxGain);
+                for (uint32_t i = 0; i < numSamples && modelFadeFramesLeft != 0; ++i, --modelFadeFramesLeft)
+                {
+                    const float g = static_cast<float>(modelFadeFramesLeft) / modelFadeFrames;
+
+                    for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                        outs[c][i] += (fadingModelInplaceBuffer[c][i] - outs[c][i]) * g;
+                }
+
+                if (modelFadeFramesLeft == 0)
+                    releaseFadingModel();
             }
         }
+        else if (fadingModel != nullptr)
+        {
+            // nothing to crossfade while the model is bypassed
+            releaseFadingModel();
+        }
+
+        // keep the model latency while it is bypassed
+        if (!idle && aida.net_bypass)
+        {
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                modelBypassDelay[c].process(outs[c], numSamples);
+        }
+
+        profiler.stage(kDSPStageModel);
+
+        if (pipelined)
+        {
+            // hand the model output over, getting back the cabinet output of one host buffer ago
+            pipeline.finish(outs, numSamples, idle);
+        }
+        else
+        {
+            processDCBlocker(outs, numSamples, idle);
+            profiler.stage(kDSPStageDCBlocker);
+
+            swapPreparedCabinet();
+            processCabinet(outs, numSamples, idle);
+        }
+
+        profiler.stage(kDSPStageCabinet);
 
         // Equalizer section
         if (!aida.eq_bypass && aida.eq_pos == kEqPost)
-            applyToneControls(aida, out, numSamples);
+        {
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                applyToneControls(aida, outs[c], numSamples, c);
+        }
+
+        profiler.stage(kDSPStageEqPost);
 
         // Output volume
-        applyGainRamp(aida.outlevel, out, numSamples);
+        applyGainRamp(aida.outlevel, outs, numSamples);
 
         // Bypass and output meter
         for (uint32_t i = 0; i < numSamples; ++i)
         {
-           #ifndef MOD_BUILD
             const float b = bypassGain.next();
-            out[i] = out[i] * b + bypassInplaceBuffer[i] * (1.f - b);
-           #else
-            out[i] *= bypassGain.next();
-           #endif
-            meterOut = std::max(meterOut, std::abs(out[i]));
+
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+            {
+               #ifndef MOD_BUILD
+                outs[c][i] = outs[c][i] * b + bypassInplaceBuffer[c][i] * (1.f - b);
+               #else
+                outs[c][i] *= b;
+               #endif
+                outputPeak = std::max(outputPeak, std::abs(outs[c][i]));
+            }
         }
 
+        meterOut = std::max(meterOut, outputPeak);
+
+        // Go idle once input has been silent for long enough to let the model state and cabinet tail die out
+        if (!idle && outputPeak < DB_CO(kIdleThresholdDb)
+            && idleSilentFrames >= idleHoldFrames + (cabsim != nullptr ? cabsim->getLength() : 0))
+            idle = true;
+
 #ifdef MOD_BUILD
 the_end:
 #endif
+        profiler.end(kDSPStageOutput);
+
         if (tmpMeterFrames >= meterMaxFrameCount)
         {
             parameters[kParameterMeterIn] = tmpMeterIn = meterIn;
             parameters[kParameterMeterOut] = tmpMeterOut = meterOut;
+            profiler.publish(parameters);
             tmpMeterFrames -= meterMaxFrameCount;
         }
         else
@@ -1091,17 +1025,98 @@ the_end:
             tmpMeterOut = meterOut;
         }
 
-       #if DISTRHO_PLUGIN_NUM_OUTPUTS == 2
-        std::memcpy(outputs[1], out, sizeof(float)*numSamples);
+       #if DISTRHO_PLUGIN_NUM_OUTPUTS == 2 && ! AIDAX_STEREO
+        std::memcpy(outputs[1], outputs[0], sizeof(float)*numSamples);
        #endif
     }
 
+   /**
+      DC blocker filter (highpass), skipped while @a idle.
+      Called from the run function or, in pipelined mode, from a worker thread.
+    */
+    void processDCBlocker(float* outs[kNumDSPChannels], const uint32_t numSamples, const bool idle) noexcept
+    {
+        if (enabledDC && !idle)
+        {
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                applyBiquadFilter(aida.dc_blocker_stage[c], aida.dc_blocker, outs[c], numSamples);
+        }
+    }
+
+   /**
+      Cabinet convolution and fade-in after idle, skipped while @a idle.
+      Called from the run function or, in pipelined mode, from a worker thread.
+    */
+    void processCabinet(float* outs[kNumDSPChannels], const uint32_t numSamples, const bool idle) noexcept
+    {
+        if (idle)
+            return;
+
+        if (cabsim != nullptr)
+        {
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                std::memcpy(cabsimInplaceBuffer[c], outs[c], sizeof(float)*numSamples);
+
+            cabsim->process(cabsimInplaceBuffer, outs, numSamples);
+
+            if (fadingCabsim != nullptr)
+            {
+                fadingCabsim->process(cabsimInplaceBuffer, fadingCabsimInplaceBuffer, numSamples);
+
+                for (uint32_t i = 0; i < numSamples && cabsimFadeFramesLeft != 0; ++i, --cabsimFadeFramesLeft)
+                {
+                    const float g = static_cast<float>(cabsimFadeFramesLeft) / cabsimFadeFrames;
+
+                    for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                        outs[c][i] += (fadingCabsimInplaceBuffer[c][i] - outs[c][i]) * g;
+                }
+
+                if (cabsimFadeFramesLeft == 0)
+                {
+                    cabinetLoader.retireCabinet(fadingCabsim);
+                    fadingCabsim = nullptr;
+                }
+            }
+
+            // cabsim smooth bypass and -12dB compensation
+            for (uint32_t i = 0; i < numSamples; ++i)
+            {
+                const float b = cabsimGain.next();
+
+                for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                    outs[c][i] = outs[c][i] * b + cabsimInplaceBuffer[c][i] * ((kCabinetMaxGain - b) / kCabinetMaxGain);
+            }
+        }
+
+        // Fade in when resuming from idle
+        for (uint32_t i = 0; i < numSamples && idleWakeFramesLeft != 0; ++i, --idleWakeFramesLeft)
+        {
+            const float g = 1.f - static_cast<float>(idleWakeFramesLeft) / idleWakeFrames;
+
+            for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+                outs[c][i] *= g;
+        }
+    }
+
     void bufferSizeChanged(const uint newBufferSize) override
     {
-        delete[] bypassInplaceBuffer;
-        delete[] cabsimInplaceBuffer;
-        bypassInplaceBuffer = new float[newBufferSize];
-        cabsimInplaceBuffer = new float[newBufferSize];
+        for (uint32_t c = 0; c < kNumDSPChannels; ++c)
+        {
+            delete[] bypassInplaceBuffer[c];
+            delete[] cabsimInplaceBuffer[c];
+            delete[] fadingCabsimInplaceBuffer[c];
+            delete[] fadingModelInplaceBuffer[c];
+            bypassInplaceBuffer[c] = new float[newBufferSize];
+            cabsimInplaceBuffer[c] = new float[newBufferSize];
+            fadingCabsimInplaceBuffer[c] = new float[newBufferSize];
+            fadingModelInplaceBuffer[c] = new float[newBufferSize];
+        }
+
+        pipeline.setBufferSize(newBufferSize);
+        modelBank.setBufferSize(newBufferSize);
+
+        // convolver partitions depend on buffer size, new one is picked up on activate
+        cabinetLoader.setAudioSettings(getSampleRate(), newBufferSize);
     }
 
    /**
@@ -1119,17 +1134,21 @@ the_end:
         paramFirstRun = true;
 
         meterMaxFrameCount = newSampleRate * 0.016666; // max 60fps
+        profiler.setSampleRate(newSampleRate);
+        modelFadeFrames = std::max<uint32_t>(1, newSampleRate * kModelCrossfadeTime);
+        cabsimFadeFrames = std::max<uint32_t>(1, newSampleRate * kCabinetCrossfadeTime);
+        idleHoldFrames = newSampleRate * kIdleHoldTime;
+        idleWakeFrames = std::max<uint32_t>(1, newSampleRate * kIdleWakeFadeTime);
 
-        // reload cabsim file
-        if (char* const filename = cabsimFilename.getAndReleaseBuffer())
-        {
-            setState("cabinet", filename);
-            std::free(filename);
-        }
-        else
-        {
-            loadDefaultCabinet();
-        }
+        // resampled cabinet IR is cached, new one is picked up on activate
+        cabinetLoader.setAudioSettings(newSampleRate, getBufferSize());
+
+        // same for models running at their training sample rate
+        modelLoader.setSampleRate(newSampleRate);
+
+       #if AIDAX_WITH_AUDIOFILE
+        audiofileReader.setSampleRate(newSampleRate);
+       #endif
     }
 
     // ----------------------------------------------------------------------------------------------------------------
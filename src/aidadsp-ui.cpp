@@ -11,14 +11,21 @@
 
 #include "Graphics.hpp"
 #include "Layout.hpp"
+#include "Threading.hpp"
 #include "Widgets.hpp"
 
+#include "extra/Time.hpp"
+
 #if AIDAX_WITH_STANDALONE_CONTROLS
 # include "Blendish.hpp"
 #endif
 
 START_NAMESPACE_DISTRHO
 
+// meters (and DSP load overlay) refresh rate, can be lowered with AIDAX_UI_METER_RATE to save CPU on many open UIs
+static constexpr const uint kDefaultMeterRefreshRate = 30;
+static constexpr const uint kMaximumMeterRefreshRate = 60;
+
 // --------------------------------------------------------------------------------------------------------------------
 
 enum ButtonIds {
@@ -90,8 +97,14 @@ class AidaDSPLoaderUI : public UI,
         ScopedPointer<AidaMeter> in;
         ScopedPointer<AidaMeter> out;
         bool resetOnNextIdle = false;
+        uint32_t refreshInterval = 1000 / kDefaultMeterRefreshRate; // in ms
+        uint32_t lastRefresh = 0;
     } meters;
 
+    // DSP load overlay, toggled by clicking the AIDA-X logo
+    bool showProfiler = false;
+    bool profilerNeedsRepaint = false;
+
    #if AIDAX_WITH_STANDALONE_CONTROLS
     EnableInputState enableInputState = kEnableInputUnsupported;
     ScopedPointer<BlendishSubWidgetSharedContext> blendishParent;
@@ -168,6 +181,14 @@ public:
         meters.in = new AidaMeter(this, "INPUT");
         meters.out = new AidaMeter(this, "OUTPUT");
 
+        if (const char* const meterRate = std::getenv("AIDAX_UI_METER_RATE"))
+        {
+            const int rate = std::atoi(meterRate);
+            if (rate > 0)
+                meters.refreshInterval = 1000 / (rate < static_cast<int>(kMaximumMeterRefreshRate) ? rate
+                                                                                                  : kMaximumMeterRefreshRate);
+        }
+
        #if AIDAX_WITH_STANDALONE_CONTROLS
         if (isUsingNativeAudio())
         {
@@ -318,6 +339,21 @@ protected:
             meters.out->setValue(value);
             meters.resetOnNextIdle = true;
             break;
+        case kParameterCabinetLength:
+            {
+                char details[32] = {};
+                if (d_isNotZero(value))
+                    std::snprintf(details, sizeof(details) - 1, "%d ms", d_roundToInt(value));
+                loaders.cabsim->setDetails(details);
+            }
+            break;
+        case kParameterDSPLoad:
+        case kParameterDSPLoadPeak:
+        case kParameterDSPOverruns:
+        case kParameterDSPOverrunStage:
+            // coalesced into the next meter refresh
+            profilerNeedsRepaint = showProfiler;
+            break;
         case kParameterBASSFREQ:
         case kParameterMIDFREQ:
         case kParameterMIDQ:
@@ -325,6 +361,10 @@ protected:
         case kParameterPARAM1:
         case kParameterPARAM2:
         case kParameterDCBLOCKER:
+        case kParameterCABSIMMAXLEN:
+        case kParameterMODELRATE:
+        case kParameterPIPELINE:
+        case kParameterBANK:
         case kParameterCount:
             break;
         }
@@ -480,6 +520,9 @@ protected:
         textAlign(ALIGN_CENTER | ALIGN_BASELINE);
         text(marginHorizontal + widthPedal/2, marginVertical + heightHead - marginHead, "AI CRAFTED TONE", nullptr);
 
+        if (showProfiler)
+            drawProfilerOverlay(marginHorizontal + widthPedal - marginHead * 2, marginVertical + marginHead * 2);
+
        #ifndef MOD_BUILD
         fillColor(Color(1.f,1.f,1.f));
         fontSize((kSubWidgetsFontSize + 2) * scaleFactor);
@@ -510,6 +553,69 @@ protected:
        #endif
     }
 
+    void drawProfilerOverlay(const double right, const double top)
+    {
+        const double scaleFactor = getScaleFactor();
+        const double padding = kSubWidgetsPadding * scaleFactor;
+        const double lineHeight = kSubWidgetsFontSize * scaleFactor;
+        const double boxWidth = 190 * scaleFactor;
+
+        const uint overruns = d_roundToInt(parameters[kParameterDSPOverruns]);
+        const int stage = d_roundToInt(parameters[kParameterDSPOverrunStage]);
+
+        char lines[3][48] = {};
+        std::snprintf(lines[0], sizeof(lines[0]) - 1, "DSP load %.1f%%", parameters[kParameterDSPLoad]);
+        std::snprintf(lines[1], sizeof(lines[1]) - 1, "Worst block %.1f%% (last %ds)",
+                      parameters[kParameterDSPLoadPeak], static_cast<int>(kDSPProfilerPeakWindow));
+        if (overruns != 0 && stage > kDSPStageNone && stage < kDSPStageCount)
+            std::snprintf(lines[2], sizeof(lines[2]) - 1, "Overruns %u, last in %s", overruns, kDSPStages[stage].label.buffer());
+        else
+            std::snprintf(lines[2], sizeof(lines[2]) - 1, "Overruns %u", overruns);
+
+        beginPath();
+        roundedRect(right - boxWidth, top, boxWidth, lineHeight * 3 + padding * 2, padding / 2);
+        fillColor(Color(0, 0, 0, 0.6f));
+        fill();
+
+        if (overruns != 0 || parameters[kParameterDSPLoadPeak] >= 100.f)
+            fillColor(Color(0xf4,0x4d,0x50)); // #F44D50
+        else
+            fillColor(Color(1.f,1.f,1.f));
+
+        fontSize(kSubWidgetsFontSize * scaleFactor);
+        textAlign(ALIGN_LEFT | ALIGN_TOP);
+
+        for (int i = 0; i < 3; ++i)
+            text(right - boxWidth + padding, top + padding + lineHeight * i, lines[i], nullptr);
+    }
+
+    bool onMouse(const MouseEvent& event) override
+    {
+        if (event.press && event.button == kMouseButtonLeft)
+        {
+            const double scaleFactor = getScaleFactor();
+            const double marginHead = 12 * scaleFactor;
+            const double widthPedal = kPedalWidth * scaleFactor;
+            const double marginHorizontal = kPedalMargin * scaleFactor + (getWidth() - DISTRHO_UI_DEFAULT_WIDTH * scaleFactor) / 2;
+            const double marginVertical = kPedalMarginTop * scaleFactor;
+            const Size<uint> headBgSize(images.background.getSize() / 2 * scaleFactor);
+            const Size<uint> axLogoSize(100 * scaleFactor * 1548 / 727, 100 * scaleFactor);
+            const Rectangle<double> axLogoArea(marginHorizontal + widthPedal/2 - axLogoSize.getWidth()/2,
+                                               marginVertical + marginHead + headBgSize.getHeight() / 6,
+                                               axLogoSize.getWidth(),
+                                               axLogoSize.getHeight());
+
+            if (axLogoArea.contains(event.pos.getX(), event.pos.getY()))
+            {
+                showProfiler = !showProfiler;
+                repaint();
+                return true;
+            }
+        }
+
+        return UI::onMouse(event);
+    }
+
     void onResize(const ResizeEvent& event) override
     {
         UI::onResize(event);
@@ -675,12 +781,33 @@ protected:
 
     void uiIdle() override
     {
-        if (meters.resetOnNextIdle)
+        const uint32_t now = d_gettime_ms();
+
+        // nothing is drawn while the window is hidden or minimized, the DSP keeps holding the meter peaks until then
+        if (now - meters.lastRefresh >= meters.refreshInterval && getWindow().isVisible())
         {
-            meters.resetOnNextIdle = false;
-            setState("reset-meters", "");
+            meters.lastRefresh = now;
+            meters.in->updateDisplay();
+            meters.out->updateDisplay();
+
+            if (meters.resetOnNextIdle)
+            {
+                meters.resetOnNextIdle = false;
+                setState("reset-meters", "");
+            }
+
+            if (profilerNeedsRepaint)
+            {
+                profilerNeedsRepaint = false;
+                repaint();
+            }
         }
 
+       #if ! AIDAX_THREADS
+        // lets the DSP handle changes deferred from setParameterValue, see AsyncModelLoader::idle
+        setState("idle", "");
+       #endif
+
        #if AIDAX_WITH_STANDALONE_CONTROLS
         if (enableInputButton != nullptr)
         {
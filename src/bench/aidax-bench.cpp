@@ -0,0 +1,375 @@
+/*
+ * AIDA-X model inference benchmark
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "DistrhoPluginInfo.h"
+
+#include "AidaDSP.hpp"
+#include "model_variant.hpp"
+
+#include "extra/ScopedDenormalDisable.hpp"
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static constexpr const double kBenchSampleRate = 48000.0;
+static constexpr const uint32_t kBenchBufferSizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+
+#if defined(RTNEURAL_USE_XSIMD)
+static constexpr const char* const kBackendName = "xsimd";
+#elif defined(RTNEURAL_USE_EIGEN)
+static constexpr const char* const kBackendName = "Eigen";
+#else
+static constexpr const char* const kBackendName = "STL";
+#endif
+
+struct BenchOptions {
+    double seconds = 1.0;
+    uint repeats = 3;
+    std::string filter;
+    uint streams = 0;
+    ModelPrecision precision = kModelPrecisionFloat;
+    bool csv = false;
+};
+
+struct BenchArch {
+    std::string type;
+    int hidden_size;
+    int input_size;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Generate a model json in the same layout as the trainer exports, filled with random weights
+
+static std::vector<std::vector<float>> randomMatrix(std::mt19937& rng, const int rows, const int cols, const float scale)
+{
+    std::uniform_real_distribution<float> dist(-scale, scale);
+    std::vector<std::vector<float>> m(rows, std::vector<float>(cols));
+
+    for (std::vector<float>& row : m)
+        for (float& v : row)
+            v = dist(rng);
+
+    return m;
+}
+
+static std::vector<float> randomVector(std::mt19937& rng, const int size, const float scale)
+{
+    std::uniform_real_distribution<float> dist(-scale, scale);
+    std::vector<float> v(size);
+
+    for (float& x : v)
+        x = dist(rng);
+
+    return v;
+}
+
+static nlohmann::json createRandomModelJson(const BenchArch& arch, std::mt19937& rng)
+{
+    const bool isLSTM = arch.type == "lstm";
+    const int numGates = isLSTM ? 4 : 3;
+    const int gatesSize = arch.hidden_size * numGates;
+
+    /* keep recurrent gain below 1 so the state does not blow up with random weights */
+    const float scale = 1.f / std::sqrt(static_cast<float>(arch.hidden_size));
+
+    nlohmann::json rnn;
+    rnn["type"] = arch.type;
+    rnn["activation"] = "";
+    rnn["shape"] = { nullptr, nullptr, arch.hidden_size };
+
+    if (isLSTM)
+        rnn["weights"] = { randomMatrix(rng, arch.input_size, gatesSize, scale),
+                           randomMatrix(rng, arch.hidden_size, gatesSize, scale),
+                           randomVector(rng, gatesSize, scale) };
+    else
+        rnn["weights"] = { randomMatrix(rng, arch.input_size, gatesSize, scale),
+                           randomMatrix(rng, arch.hidden_size, gatesSize, scale),
+                           randomMatrix(rng, 2, gatesSize, scale) };
+
+    nlohmann::json dense;
+    dense["type"] = "dense";
+    dense["activation"] = "";
+    dense["shape"] = { nullptr, nullptr, 1 };
+    dense["weights"] = { randomMatrix(rng, arch.hidden_size, 1, scale), randomVector(rng, 1, scale) };
+
+    nlohmann::json model_json;
+    model_json["in_shape"] = { nullptr, nullptr, arch.input_size };
+    model_json["layers"] = { rnn, dense };
+
+    return model_json;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Collect the architecture of every ModelVariantType entry
+
+template <size_t Index = 1>
+static void collectArchitectures(std::vector<BenchArch>& archs)
+{
+    if constexpr (Index < std::variant_size_v<ModelVariantType>)
+    {
+        using ModelType = std::variant_alternative_t<Index, ModelVariantType>;
+        using RNNLayerType = std::decay_t<decltype(std::declval<ModelType&>().template get<0>())>;
+
+        archs.push_back({ RNNLayerType().getName(), RNNLayerType::out_size, ModelType::input_size });
+
+        collectArchitectures<Index + 1>(archs);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static double benchmarkModel(DynamicModel* const model, const std::vector<float>& input,
+                             const uint32_t bufferSize, const BenchOptions& options)
+{
+    const uint32_t numBlocks = std::max<uint32_t>(1, options.seconds * kBenchSampleRate / bufferSize);
+    std::vector<float> buffer(bufferSize);
+
+    LinearValueSmoother param1, param2;
+    param1.setSampleRate(kBenchSampleRate);
+    param1.setTimeConstant(0.1f);
+    param1.setTargetValue(0.5f);
+    param1.clearToTargetValue();
+    param2.setSampleRate(kBenchSampleRate);
+    param2.setTimeConstant(0.1f);
+    param2.setTargetValue(0.5f);
+    param2.clearToTargetValue();
+
+    double best = 0.0;
+
+    for (uint r = 0; r <= options.repeats; ++r)
+    {
+        resetModel(model);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t b = 0; b < numBlocks; ++b)
+        {
+            const size_t offset = (static_cast<size_t>(b) * bufferSize) % (input.size() - bufferSize);
+            std::memcpy(buffer.data(), input.data() + offset, sizeof(float) * bufferSize);
+            applyModel(model, buffer.data(), bufferSize, param1, param2);
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const double nsPerSample = std::chrono::duration<double, std::nano>(end - start).count()
+                                 / (static_cast<double>(numBlocks) * bufferSize);
+
+        // first run is warm-up only
+        if (r == 0)
+            continue;
+
+        if (best == 0.0 || nsPerSample < best)
+            best = nsPerSample;
+    }
+
+    return best;
+}
+
+/* Same for a batched model, with time reported per sample of each stream */
+static double benchmarkBatchedModel(BatchedModel* const model, const std::vector<float>& input,
+                                    const uint32_t bufferSize, const BenchOptions& options)
+{
+    const uint32_t numBlocks = std::max<uint32_t>(1, options.seconds * kBenchSampleRate / bufferSize);
+    std::vector<std::vector<float>> buffers(options.streams, std::vector<float>(bufferSize));
+    std::vector<float*> bufferPtrs;
+    std::vector<int> streams;
+
+    for (std::vector<float>& buffer : buffers)
+        bufferPtrs.push_back(buffer.data());
+
+    double best = 0.0;
+
+    for (uint r = 0; r <= options.repeats; ++r)
+    {
+        for (const int stream : streams)
+            model->removeStream(stream);
+
+        streams.clear();
+
+        for (uint s = 0; s < options.streams; ++s)
+        {
+            streams.push_back(model->addStream());
+            model->setStreamParameters(streams.back(), 0.5f, 0.5f);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t b = 0; b < numBlocks; ++b)
+        {
+            // streams read the input at different offsets
+            for (uint s = 0; s < options.streams; ++s)
+            {
+                const size_t offset = (static_cast<size_t>(b + s) * bufferSize) % (input.size() - bufferSize);
+                std::memcpy(buffers[streams[s]].data(), input.data() + offset, sizeof(float) * bufferSize);
+            }
+
+            model->process(bufferPtrs.data(), bufferSize);
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const double nsPerSample = std::chrono::duration<double, std::nano>(end - start).count()
+                                 / (static_cast<double>(numBlocks) * bufferSize * options.streams);
+
+        // first run is warm-up only
+        if (r == 0)
+            continue;
+
+        if (best == 0.0 || nsPerSample < best)
+            best = nsPerSample;
+    }
+
+    return best;
+}
+
+static int runBenchmarks(const BenchOptions& options)
+{
+    std::vector<BenchArch> archs;
+    collectArchitectures(archs);
+
+    std::mt19937 rng(0x41494441); // fixed seed for reproducible weights
+
+    // guitar-like level white noise as input
+    std::vector<float> input(static_cast<size_t>(kBenchSampleRate) + 2048);
+    {
+        std::uniform_real_distribution<float> dist(-0.25f, 0.25f);
+        for (float& x : input)
+            x = dist(rng);
+    }
+
+    if (options.csv)
+        d_stdout("backend,kernel,precision,model,input_size,buffer_size,ns_per_sample,realtime_factor");
+    else
+        d_stdout("RTNeural backend: %s, model kernel: %s, precision: %s, sample rate %.0f Hz",
+                 kBackendName, getModelKernelName(), getModelPrecisionName(options.precision), kBenchSampleRate);
+
+    if (options.streams != 0 && ! options.csv)
+        d_stdout("Batched inference of %u streams, times are per sample of each stream", options.streams);
+
+    // optimize for non-denormal usage
+    const ScopedDenormalDisable sdd;
+
+    for (const BenchArch& arch : archs)
+    {
+        char name[32] = {};
+        std::snprintf(name, sizeof(name) - 1, "%s_%d_%d",
+                      arch.type == "lstm" ? "LSTM" : "GRU", arch.hidden_size, arch.input_size);
+
+        if (!options.filter.empty() && std::strstr(name, options.filter.c_str()) == nullptr)
+            continue;
+
+        std::istringstream jsonStream(createRandomModelJson(arch, rng).dump());
+        int input_size = 0;
+        std::unique_ptr<DynamicModel> model;
+        std::unique_ptr<BatchedModel> batchedModel;
+
+        if (options.streams != 0)
+            batchedModel.reset(loadBatchedModel(jsonStream, options.streams));
+        else
+            model.reset(loadDynamicModel(jsonStream, input_size, false, options.precision));
+
+        if (model == nullptr && batchedModel == nullptr)
+        {
+            d_stderr2("Failed to create model %s", name);
+            return 1;
+        }
+
+        if (! options.csv)
+            d_stdout("%-12s %8s %12s %12s", name, "buffer", "ns/sample", "x realtime");
+
+        for (const uint32_t bufferSize : kBenchBufferSizes)
+        {
+            const double nsPerSample = batchedModel != nullptr
+                                     ? benchmarkBatchedModel(batchedModel.get(), input, bufferSize, options)
+                                     : benchmarkModel(model.get(), input, bufferSize, options);
+            const double realtimeFactor = 1e9 / (nsPerSample * kBenchSampleRate);
+
+            if (options.csv)
+                d_stdout("%s,%s,%s,%s,%d,%u,%.3f,%.2f",
+                         kBackendName, getModelKernelName(), getModelPrecisionName(options.precision),
+                         name, arch.input_size, bufferSize, nsPerSample, realtimeFactor);
+            else
+                d_stdout("%-12s %8u %12.3f %12.2f", "", bufferSize, nsPerSample, realtimeFactor);
+        }
+    }
+
+    return 0;
+}
+
+static void printUsage(const char* const progname)
+{
+    d_stdout("Usage: %s [options]", progname);
+    d_stdout("Options:");
+    d_stdout("  -t, --time SECONDS     Amount of audio to process per measurement (default: 1)");
+    d_stdout("  -r, --repeats N        Measurements per buffer size, best is reported (default: 3)");
+    d_stdout("  -f, --filter TEXT      Only run models whose name contains TEXT, e.g. LSTM_40");
+    d_stdout("  -s, --streams N        Run N streams through a batched model instead (default: 0, off)");
+    d_stdout("  -q, --precision P      Model weights precision: float, bf16 or int8 (default: float)");
+    d_stdout("      --csv              Print results as CSV");
+    d_stdout("  -h, --help             Show this help");
+}
+
+static bool parseArguments(BenchOptions& options, const int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+
+        if (std::strcmp(arg, "--csv") == 0)
+        {
+            options.csv = true;
+            continue;
+        }
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0 || i + 1 >= argc)
+            return false;
+
+        const char* const value = argv[++i];
+
+        if (std::strcmp(arg, "-t") == 0 || std::strcmp(arg, "--time") == 0)
+            options.seconds = std::max(0.01, std::atof(value));
+        else if (std::strcmp(arg, "-r") == 0 || std::strcmp(arg, "--repeats") == 0)
+            options.repeats = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "-f") == 0 || std::strcmp(arg, "--filter") == 0)
+            options.filter = value;
+        else if (std::strcmp(arg, "-s") == 0 || std::strcmp(arg, "--streams") == 0)
+            options.streams = std::max(0, std::atoi(value));
+        else if (std::strcmp(arg, "-q") == 0 || std::strcmp(arg, "--precision") == 0)
+        {
+            if (! parseModelPrecision(value, options.precision))
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
+
+int main(int argc, char* argv[])
+{
+    USE_NAMESPACE_DISTRHO;
+
+    BenchOptions options;
+
+    if (! parseArguments(options, argc, argv))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    return runBenchmarks(options);
+}
@@ -0,0 +1,20 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+// same ports as the standalone, without any UI
+#define AIDAX_HEADLESS 1
+
+#define DISTRHO_PLUGIN_NUM_INPUTS      1
+#define DISTRHO_PLUGIN_NUM_OUTPUTS     2
+#define DISTRHO_UI_USER_RESIZABLE      0
+
+#define DISTRHO_PLUGIN_VARIANT_PLUGIN     0
+#define DISTRHO_PLUGIN_VARIANT_STANDALONE 1
+
+#include "../DistrhoPluginCommon.hpp"
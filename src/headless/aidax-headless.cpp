@@ -0,0 +1,709 @@
+/*
+ * AIDA-X headless engine
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define createPlugin createStaticPlugin
+#include "src/DistrhoPluginInternal.hpp"
+
+#include "extra/Sleep.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <jack/thread.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+# include <malloc.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Heap touched once at startup and kept by the allocator, so the audio thread never waits on new pages */
+static constexpr const size_t kHeapPrefaultSize = 32 * 1024 * 1024;
+
+/* Stack touched at the start of the process thread */
+static constexpr const size_t kStackPrefaultSize = 256 * 1024;
+
+/* Interval between DSP load reports in verbose mode, in seconds */
+static constexpr const uint kStatsInterval = 5;
+
+struct HeadlessOptions {
+    std::string clientName = DISTRHO_PLUGIN_NAME;
+    std::string modelFilename;   /* empty means built-in model */
+    std::string cabinetFilename; /* empty means built-in cabinet */
+    std::string bankFileList;    /* model bank files, one per line */
+    std::vector<std::string> inputPorts;
+    std::vector<std::string> outputPorts;
+    std::vector<int> cores;
+    float parameters[kNumParameters];
+    int ccParameters[128];       /* parameter index per MIDI CC, -1 if not mapped */
+    int midiChannel = 0;         /* 1 to 16, 0 for all channels */
+    int priority = 0;            /* 0 keeps the JACK priority */
+    bool autoConnect = true;
+    bool lockMemory = true;
+    bool verbose = false;
+
+    HeadlessOptions()
+    {
+        for (uint i=0; i<kNumParameters; ++i)
+            parameters[i] = kParameters[i].ranges.def;
+
+        std::fill(ccParameters, ccParameters + ARRAY_SIZE(ccParameters), -1);
+    }
+};
+
+static volatile std::sig_atomic_t gRunning = 1;
+
+static void signalHandler(int)
+{
+    gRunning = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Memory locking, so nothing the audio thread touches can be paged out or faulted in late
+
+static void prefaultStack()
+{
+    volatile char stack[kStackPrefaultSize];
+
+    for (size_t i = 0; i < kStackPrefaultSize; i += 1024)
+        stack[i] = 0;
+}
+
+static void lockMemory()
+{
+   #ifdef __linux__
+    // never give freed memory back to the system, nor serve big allocations from fresh mappings
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+   #endif
+
+    if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        d_stderr2("Unable to lock memory (%s), check the memlock limit of this user", std::strerror(errno));
+        return;
+    }
+
+    if (char* const reserve = static_cast<char*>(std::malloc(kHeapPrefaultSize)))
+    {
+        std::memset(reserve, 0, kHeapPrefaultSize);
+        std::free(reserve);
+    }
+
+    prefaultStack();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// JACK client hosting the plugin DSP, with parameters set from the command line and MIDI
+
+class AidaHeadlessEngine
+{
+    const HeadlessOptions& options;
+    jack_client_t* const client;
+    jack_port_t* audioIn = nullptr;
+    jack_port_t* audioOuts[DISTRHO_PLUGIN_NUM_OUTPUTS] = {};
+    jack_port_t* midiIn = nullptr;
+    PluginExporter plugin;
+    MidiEvent midiEvents[kMaxMidiEvents];
+    std::atomic<uint> numXruns { 0 };
+
+public:
+    AidaHeadlessEngine(const HeadlessOptions& opts, jack_client_t* const c)
+        : options(opts),
+          client(c),
+          plugin(this, nullptr, nullptr, nullptr) // writeMidi, requestParameterValueChange, updateStateValue
+    {
+        audioIn = jack_port_register(client, "in", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        audioOuts[0] = jack_port_register(client, "out_1", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        audioOuts[1] = jack_port_register(client, "out_2", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        midiIn = jack_port_register(client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+
+        // parameters first, model loading picks up the conditioning values
+        for (uint i=0; i<kNumParameters; ++i)
+        {
+            if (! plugin.isParameterOutput(i))
+                plugin.setParameterValue(i, options.parameters[i]);
+        }
+
+        if (! options.modelFilename.empty())
+            plugin.setState("json", options.modelFilename.c_str());
+        if (! options.cabinetFilename.empty())
+            plugin.setState("cabinet", options.cabinetFilename.c_str());
+        if (! options.bankFileList.empty())
+            plugin.setState("bank", options.bankFileList.c_str());
+
+        jack_set_thread_init_callback(client, threadInitCallback, this);
+        jack_set_process_callback(client, processCallback, this);
+        jack_set_buffer_size_callback(client, bufferSizeCallback, this);
+        jack_set_sample_rate_callback(client, sampleRateCallback, this);
+        jack_set_xrun_callback(client, xrunCallback, this);
+        jack_on_shutdown(client, shutdownCallback, this);
+    }
+
+    bool start()
+    {
+        if (audioIn == nullptr || audioOuts[0] == nullptr || audioOuts[1] == nullptr || midiIn == nullptr)
+        {
+            d_stderr2("Unable to register JACK ports");
+            return false;
+        }
+
+        plugin.activate();
+
+        if (jack_activate(client) != 0)
+        {
+            d_stderr2("Unable to activate JACK client");
+            plugin.deactivate();
+            return false;
+        }
+
+        setupProcessThread();
+
+        if (options.autoConnect)
+            connectPorts();
+
+        return true;
+    }
+
+    void stop()
+    {
+        jack_deactivate(client);
+        plugin.deactivateIfNeeded();
+    }
+
+    void printStats()
+    {
+        d_stdout("DSP load %.1f%%, peak %.1f%%, %u overruns, %u xruns",
+                 plugin.getParameterValue(kParameterDSPLoad),
+                 plugin.getParameterValue(kParameterDSPLoadPeak),
+                 static_cast<uint>(plugin.getParameterValue(kParameterDSPOverruns)),
+                 numXruns.load());
+    }
+
+private:
+    /* Pin the process thread to the requested cores and change its priority */
+    void setupProcessThread()
+    {
+        const jack_native_thread_t thread = jack_client_thread_id(client);
+
+        if (! options.cores.empty())
+        {
+           #ifdef __linux__
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+
+            for (const int core : options.cores)
+                CPU_SET(core, &cpuset);
+
+            if (::pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset) != 0)
+                d_stderr2("Failed to pin the process thread to the requested cores");
+           #else
+            d_stderr2("CPU affinity is not supported on this system");
+           #endif
+        }
+
+        if (options.priority > 0 && jack_acquire_real_time_scheduling(thread, options.priority) != 0)
+            d_stderr2("Failed to set realtime priority %d for the process thread", options.priority);
+    }
+
+    /* Connect to the given ports, or to the first physical ones */
+    void connectPorts()
+    {
+        const char** const capturePorts = options.inputPorts.empty()
+                                         ? jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE,
+                                                          JackPortIsPhysical|JackPortIsOutput)
+                                         : nullptr;
+        const char** const playbackPorts = options.outputPorts.empty()
+                                         ? jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE,
+                                                          JackPortIsPhysical|JackPortIsInput)
+                                         : nullptr;
+
+        if (! options.inputPorts.empty())
+            connectPort(options.inputPorts[0].c_str(), jack_port_name(audioIn));
+        else if (capturePorts != nullptr && capturePorts[0] != nullptr)
+            connectPort(capturePorts[0], jack_port_name(audioIn));
+
+        for (uint i = 0; i < DISTRHO_PLUGIN_NUM_OUTPUTS; ++i)
+        {
+            if (! options.outputPorts.empty())
+            {
+                if (i < options.outputPorts.size())
+                    connectPort(jack_port_name(audioOuts[i]), options.outputPorts[i].c_str());
+            }
+            else if (playbackPorts != nullptr)
+            {
+                if (playbackPorts[i] == nullptr)
+                    break;
+                connectPort(jack_port_name(audioOuts[i]), playbackPorts[i]);
+            }
+        }
+
+        if (capturePorts != nullptr)
+            jack_free(capturePorts);
+        if (playbackPorts != nullptr)
+            jack_free(playbackPorts);
+    }
+
+    void connectPort(const char* const source, const char* const destination)
+    {
+        const int ret = jack_connect(client, source, destination);
+
+        if (ret != 0 && ret != EEXIST)
+            d_stderr2("Unable to connect %s to %s", source, destination);
+    }
+
+    /* Mapped controllers set their parameter right away, for the whole block */
+    void setParameterFromMidi(const uint32_t index, const uint8_t ccValue)
+    {
+        const ParameterRanges& ranges(plugin.getParameterRanges(index));
+        const uint32_t hints = plugin.getParameterHints(index);
+        float value;
+
+        if (hints & kParameterIsBoolean)
+            value = ccValue >= 64 ? ranges.max : ranges.min;
+        else if (hints & kParameterIsInteger)
+            value = std::round(ranges.getUnnormalizedValue(ccValue / 127.f));
+        else
+            value = ranges.getUnnormalizedValue(ccValue / 127.f);
+
+        plugin.setParameterValue(index, value);
+    }
+
+    int process(const jack_nframes_t nframes)
+    {
+        const float* inputs[DISTRHO_PLUGIN_NUM_INPUTS] = {
+            static_cast<const float*>(jack_port_get_buffer(audioIn, nframes))
+        };
+        float* outputs[DISTRHO_PLUGIN_NUM_OUTPUTS];
+
+        for (uint i = 0; i < DISTRHO_PLUGIN_NUM_OUTPUTS; ++i)
+            outputs[i] = static_cast<float*>(jack_port_get_buffer(audioOuts[i], nframes));
+
+        void* const midiBuffer = jack_port_get_buffer(midiIn, nframes);
+        const uint32_t jackEventCount = jack_midi_get_event_count(midiBuffer);
+        uint32_t midiEventCount = 0;
+        jack_midi_event_t jevent;
+
+        for (uint32_t i = 0; i < jackEventCount; ++i)
+        {
+            if (jack_midi_event_get(&jevent, midiBuffer, i) != 0)
+                break;
+            if (jevent.size == 0)
+                continue;
+
+            const uint8_t status = jevent.buffer[0];
+
+            // channel messages from other channels are ignored
+            if (options.midiChannel != 0 && status >= 0x80 && status < 0xF0
+                && (status & 0x0F) + 1 != options.midiChannel)
+                continue;
+
+            if ((status & 0xF0) == 0xB0 && jevent.size == 3 && jevent.buffer[1] < 0x80)
+            {
+                const int index = options.ccParameters[jevent.buffer[1]];
+
+                if (index >= 0)
+                {
+                    setParameterFromMidi(index, jevent.buffer[2]);
+                    continue;
+                }
+            }
+
+            if (midiEventCount == kMaxMidiEvents)
+                continue;
+
+            MidiEvent& event(midiEvents[midiEventCount++]);
+            event.frame = jevent.time;
+            event.size = static_cast<uint32_t>(jevent.size);
+
+            if (jevent.size > MidiEvent::kDataSize)
+            {
+                event.dataExt = jevent.buffer;
+            }
+            else
+            {
+                std::memcpy(event.data, jevent.buffer, jevent.size);
+                event.dataExt = nullptr;
+            }
+        }
+
+        plugin.run(inputs, outputs, nframes, midiEvents, midiEventCount);
+        return 0;
+    }
+
+    static void threadInitCallback(void*)
+    {
+        prefaultStack();
+    }
+
+    static int processCallback(const jack_nframes_t nframes, void* const arg)
+    {
+        return static_cast<AidaHeadlessEngine*>(arg)->process(nframes);
+    }
+
+    static int bufferSizeCallback(const jack_nframes_t nframes, void* const arg)
+    {
+        static_cast<AidaHeadlessEngine*>(arg)->plugin.setBufferSize(nframes, true);
+        return 0;
+    }
+
+    static int sampleRateCallback(const jack_nframes_t nframes, void* const arg)
+    {
+        static_cast<AidaHeadlessEngine*>(arg)->plugin.setSampleRate(nframes, true);
+        return 0;
+    }
+
+    static int xrunCallback(void* const arg)
+    {
+        ++static_cast<AidaHeadlessEngine*>(arg)->numXruns;
+        return 0;
+    }
+
+    static void shutdownCallback(void*)
+    {
+        gRunning = 0;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AidaHeadlessEngine)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static int findParameter(const char* const name)
+{
+    for (uint i=0; i<kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+        if (::strcasecmp(name, param.symbol) == 0 || ::strcasecmp(name, param.name) == 0)
+            return static_cast<int>(i);
+    }
+
+    d_stderr2("Unknown parameter: %s", name);
+    return -1;
+}
+
+static bool setParameterFromString(HeadlessOptions& options, const char* const arg)
+{
+    const char* const sep = std::strchr(arg, '=');
+    DISTRHO_SAFE_ASSERT_RETURN(sep != nullptr, false);
+
+    const int index = findParameter(std::string(arg, sep - arg).c_str());
+
+    if (index < 0)
+        return false;
+
+    options.parameters[index] = kParameters[index].ranges.getFixedValue(std::atof(sep + 1));
+    return true;
+}
+
+static bool setMidiControlFromString(HeadlessOptions& options, const char* const arg)
+{
+    const char* const sep = std::strchr(arg, '=');
+    DISTRHO_SAFE_ASSERT_RETURN(sep != nullptr, false);
+
+    const int cc = std::atoi(arg);
+
+    if (cc < 0 || cc > 127)
+    {
+        d_stderr2("Invalid MIDI CC number: %d", cc);
+        return false;
+    }
+
+    const int index = findParameter(sep + 1);
+
+    if (index < 0)
+        return false;
+
+    options.ccParameters[cc] = index;
+    return true;
+}
+
+static void parseCoreList(HeadlessOptions& options, const char* const coreList)
+{
+    options.cores.clear();
+
+    for (const char* s = coreList; *s != '\0';)
+    {
+        char* end;
+        const long core = std::strtol(s, &end, 10);
+
+        if (end == s)
+            break;
+        if (core >= 0)
+            options.cores.push_back(static_cast<int>(core));
+
+        s = *end == ',' ? end + 1 : end;
+    }
+}
+
+static void printUsage(const char* const progname)
+{
+    d_stdout("Usage: %s [options]", progname);
+    d_stdout("Options:");
+    d_stdout("  -f, --config FILE      Read options from a file, one 'option = value' per line");
+    d_stdout("  -m, --model FILE       Neural model json or aidax file (built-in model by default)");
+    d_stdout("  -c, --cabinet FILE     Cabinet impulse response wav/flac file (built-in IR by default)");
+    d_stdout("  -k, --bank FILE        Model for the next bank slot, can be repeated up to %u times", kModelBankSlots);
+    d_stdout("  -p, --param NAME=VAL   Set a plugin parameter by name or symbol, can be repeated");
+    d_stdout("  -C, --cc NUM=NAME      Control a parameter with a MIDI CC, can be repeated");
+    d_stdout("  -M, --midi-channel N   Only listen to MIDI channel N, 1 to 16 (default: all channels)");
+    d_stdout("  -N, --name NAME        JACK client name (default: %s)", DISTRHO_PLUGIN_NAME);
+    d_stdout("  -i, --input PORT       JACK port to connect the input to (default: first physical capture port)");
+    d_stdout("  -o, --output PORT      JACK port to connect the next output to (default: physical playback ports)");
+    d_stdout("  -n, --no-connect       Do not connect any ports");
+    d_stdout("  -a, --cpu LIST         Pin the process thread to a comma separated list of CPU cores");
+    d_stdout("  -r, --priority N       Realtime priority of the process thread (default: as set by JACK)");
+    d_stdout("  -u, --no-mlock         Do not lock memory");
+    d_stdout("  -v, --verbose          Print DSP load every %u seconds", kStatsInterval);
+    d_stdout("  -h, --help             Show this help");
+    d_stdout("MIDI program changes 0 to %u select the main model or a bank slot.", kModelBankSlots);
+    d_stdout("Parameters:");
+
+    for (uint i=0; i<kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+
+        d_stdout("  %-14s %-14s [%g .. %g] default %g %s",
+                 param.name.buffer(), param.symbol.buffer(),
+                 param.ranges.min, param.ranges.max, param.ranges.def, param.unit.buffer());
+    }
+}
+
+static bool parseConfigFile(HeadlessOptions& options, const char* filename);
+
+/* Apply a single option by its long name, @a value is null for options without one */
+static bool applyOption(HeadlessOptions& options, const std::string& name, const char* const value)
+{
+    if (name == "no-connect")
+        options.autoConnect = false;
+    else if (name == "no-mlock")
+        options.lockMemory = false;
+    else if (name == "verbose")
+        options.verbose = true;
+    else if (value == nullptr)
+    {
+        d_stderr2("Missing value for option %s", name.c_str());
+        return false;
+    }
+    else if (name == "config")
+        return parseConfigFile(options, value);
+    else if (name == "model")
+        options.modelFilename = value;
+    else if (name == "cabinet")
+        options.cabinetFilename = value;
+    else if (name == "bank")
+        options.bankFileList += std::string(options.bankFileList.empty() ? "" : "\n") + value;
+    else if (name == "param")
+        return setParameterFromString(options, value);
+    else if (name == "cc")
+        return setMidiControlFromString(options, value);
+    else if (name == "midi-channel")
+        options.midiChannel = std::max(0, std::min(16, std::atoi(value)));
+    else if (name == "name")
+        options.clientName = value;
+    else if (name == "input")
+        options.inputPorts.push_back(value);
+    else if (name == "output")
+        options.outputPorts.push_back(value);
+    else if (name == "cpu")
+        parseCoreList(options, value);
+    else if (name == "priority")
+        options.priority = std::max(0, std::atoi(value));
+    else
+    {
+        d_stderr2("Unknown option %s", name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static std::string trimString(const std::string& s)
+{
+    const size_t start = s.find_first_not_of(" \t\r");
+
+    if (start == std::string::npos)
+        return std::string();
+
+    return s.substr(start, s.find_last_not_of(" \t\r") - start + 1);
+}
+
+static bool parseConfigFile(HeadlessOptions& options, const char* const filename)
+{
+    std::ifstream file(filename);
+
+    if (! file)
+    {
+        d_stderr2("Unable to read config file: %s", filename);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = trimString(line);
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        const size_t sep = line.find('=');
+
+        if (sep == std::string::npos)
+        {
+            if (! applyOption(options, line, nullptr))
+                return false;
+            continue;
+        }
+
+        const std::string value(trimString(line.substr(sep + 1)));
+
+        if (! applyOption(options, trimString(line.substr(0, sep)), value.c_str()))
+            return false;
+    }
+
+    return true;
+}
+
+static bool parseArguments(HeadlessOptions& options, const int argc, char* argv[])
+{
+    static const char* const kShortOptions[][2] = {
+        { "-f", "config" }, { "-m", "model" }, { "-c", "cabinet" }, { "-k", "bank" },
+        { "-p", "param" }, { "-C", "cc" }, { "-M", "midi-channel" }, { "-N", "name" },
+        { "-i", "input" }, { "-o", "output" }, { "-n", "no-connect" }, { "-a", "cpu" },
+        { "-r", "priority" }, { "-u", "no-mlock" }, { "-v", "verbose" },
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+            return false;
+
+        std::string name;
+
+        if (std::strncmp(arg, "--", 2) == 0)
+        {
+            name = arg + 2;
+        }
+        else
+        {
+            for (uint j = 0; j < ARRAY_SIZE(kShortOptions); ++j)
+            {
+                if (std::strcmp(arg, kShortOptions[j][0]) == 0)
+                {
+                    name = kShortOptions[j][1];
+                    break;
+                }
+            }
+
+            if (name.empty())
+            {
+                d_stderr2("Unknown option %s", arg);
+                return false;
+            }
+        }
+
+        const bool isFlag = name == "no-connect" || name == "no-mlock" || name == "verbose";
+        const char* const value = ! isFlag && i + 1 < argc ? argv[++i] : nullptr;
+
+        if (! applyOption(options, name, value))
+            return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static int runEngine(const HeadlessOptions& options)
+{
+    jack_client_t* const client = jack_client_open(options.clientName.c_str(), JackNoStartServer, nullptr);
+
+    if (client == nullptr)
+    {
+        d_stderr2("Unable to connect to the JACK server");
+        return 1;
+    }
+
+    // picked up by the plugin constructor
+    d_nextBufferSize = jack_get_buffer_size(client);
+    d_nextSampleRate = jack_get_sample_rate(client);
+
+    int ret = 1;
+
+    {
+        AidaHeadlessEngine engine(options, client);
+
+        if (engine.start())
+        {
+            d_stdout("%s running as JACK client '%s', %u Hz, %u frames",
+                     DISTRHO_PLUGIN_NAME, jack_get_client_name(client),
+                     static_cast<uint>(d_nextSampleRate), d_nextBufferSize);
+
+            for (uint seconds = 0; gRunning; ++seconds)
+            {
+                d_sleep(1);
+
+                if (options.verbose && seconds % kStatsInterval == kStatsInterval - 1)
+                    engine.printStats();
+            }
+
+            engine.stop();
+            ret = 0;
+        }
+    }
+
+    jack_client_close(client);
+    return ret;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
+
+int main(int argc, char* argv[])
+{
+    USE_NAMESPACE_DISTRHO;
+
+    HeadlessOptions options;
+
+    if (! parseArguments(options, argc, argv))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    // before anything is loaded, so models, cabinets and worker threads are locked too
+    if (options.lockMemory)
+        lockMemory();
+
+    return runEngine(options);
+}
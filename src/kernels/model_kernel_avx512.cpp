@@ -0,0 +1,14 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Model kernel using AVX-512 (F and DQ), see CMakeLists.txt for the compiler flags
+
+#undef RTNEURAL_DEFAULT_ALIGNMENT
+#define RTNEURAL_DEFAULT_ALIGNMENT 64
+
+#define AIDAX_MODEL_KERNEL avx512
+#include "../model_kernel.cpp"
@@ -0,0 +1,14 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Model kernel using NEON, for 32-bit ARM where it is optional, see CMakeLists.txt for the compiler flags
+
+#undef RTNEURAL_DEFAULT_ALIGNMENT
+#define RTNEURAL_DEFAULT_ALIGNMENT 16
+
+#define AIDAX_MODEL_KERNEL neon
+#include "../model_kernel.cpp"
@@ -0,0 +1,603 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "model_binary.hpp"
+
+#include "extra/Mutex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#ifdef DISTRHO_OS_WINDOWS
+# include <direct.h>
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static constexpr uint64_t alignOffset(const uint64_t offset) noexcept
+{
+    return (offset + kBinaryModelAlignment - 1) & ~static_cast<uint64_t>(kBinaryModelAlignment - 1);
+}
+
+static bool isValidBinaryModel(const uint8_t* const data, const size_t size, BinaryModel& model)
+{
+    if (size < sizeof(BinaryModelHeader))
+        return false;
+
+    const BinaryModelHeader* const header = static_cast<const BinaryModelHeader*>(static_cast<const void*>(data));
+
+    if (std::memcmp(header->magic, kBinaryModelMagic, sizeof(kBinaryModelMagic)) != 0)
+        return false;
+    if (header->version != kBinaryModelVersion || header->byteOrder != kBinaryModelByteOrder)
+        return false;
+    if (header->layerType != kBinaryModelLayerGRU && header->layerType != kBinaryModelLayerLSTM)
+        return false;
+    if (header->inputSize == 0 || header->hiddenSize == 0 || header->inputSkip > 1)
+        return false;
+    if (header->precision > kModelPrecisionInt8)
+        return false;
+
+    const uint32_t hiddenSize = header->hiddenSize;
+    const uint32_t gatesSize = hiddenSize * (header->layerType == kBinaryModelLayerLSTM ? 4 : 3);
+
+    const uint32_t expected[kBinaryModelArrayCount][2] = {
+        { header->inputSize, gatesSize },
+        { hiddenSize, gatesSize },
+        { header->layerType == kBinaryModelLayerLSTM ? 1u : 2u, gatesSize },
+        { 1, hiddenSize },
+        { 1, 1 },
+        { header->layerType == kBinaryModelLayerLSTM ? 2u : 1u, hiddenSize },
+    };
+
+    for (int i = 0; i < kBinaryModelArrayCount; ++i)
+    {
+        const BinaryModelArray& array = header->arrays[i];
+
+        if (array.rows != expected[i][0] || array.cols != expected[i][1])
+        {
+            // no initial state stored
+            if (i != kBinaryModelInitialState || array.rows != 0 || array.cols != 0)
+                return false;
+        }
+        if (array.offset % kBinaryModelAlignment != 0 || array.offset < sizeof(BinaryModelHeader))
+            return false;
+        if (array.offset + sizeof(float) * array.rows * array.cols > size)
+            return false;
+
+        model.arrays[i] = static_cast<const float*>(static_cast<const void*>(data + array.offset));
+    }
+
+    model.header = header;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+bool BinaryModelFile::open(const char* const filename)
+{
+    close();
+
+   #ifdef DISTRHO_OS_WINDOWS
+    const HANDLE file = ::CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (::GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(BinaryModelHeader)))
+    {
+        if (const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+        {
+            data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            ::CloseHandle(mapping);
+        }
+    }
+
+    ::CloseHandle(file);
+
+    if (data == nullptr)
+        return false;
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+    mapped = true;
+   #else
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(BinaryModelHeader)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size = static_cast<size_t>(st.st_size);
+
+    void* const ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (ptr != MAP_FAILED)
+    {
+        data = ptr;
+        mapped = true;
+    }
+    else
+    {
+        // fallback for systems without mmap support
+        data = std::malloc(size);
+
+        if (data == nullptr || ::pread(fd, data, size, 0) != static_cast<ssize_t>(size))
+        {
+            std::free(data);
+            data = nullptr;
+        }
+    }
+
+    ::close(fd);
+
+    if (data == nullptr)
+        return false;
+   #endif
+
+    if (! isValidBinaryModel(static_cast<const uint8_t*>(data), size, model))
+    {
+        d_stderr2("Invalid or incompatible binary model file: %s", filename);
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void BinaryModelFile::close() noexcept
+{
+    if (data == nullptr)
+        return;
+
+   #ifdef DISTRHO_OS_WINDOWS
+    ::UnmapViewOfFile(data);
+   #else
+    if (mapped)
+        ::munmap(data, size);
+    else
+        std::free(data);
+   #endif
+
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    model = {};
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static void appendModelArray(std::vector<uint8_t>& out, BinaryModelArray& array,
+                             const std::vector<std::vector<float>>& values, const bool transpose)
+{
+    const uint32_t rows = values.size();
+    const uint32_t cols = rows != 0 ? values[0].size() : 0;
+
+    array.offset = alignOffset(out.size());
+    array.rows = transpose ? cols : rows;
+    array.cols = transpose ? rows : cols;
+
+    out.resize(array.offset + sizeof(float) * rows * cols);
+    float* const dest = static_cast<float*>(static_cast<void*>(out.data() + array.offset));
+
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        if (values[r].size() != cols)
+            throw std::invalid_argument("Inconsistent weights shape");
+
+        for (uint32_t c = 0; c < cols; ++c)
+        {
+            if (transpose)
+                dest[c * rows + r] = values[r][c];
+            else
+                dest[r * cols + c] = values[r][c];
+        }
+    }
+}
+
+static const float* getModelArray(const std::vector<uint8_t>& data, const BinaryModelArray& array) noexcept
+{
+    return static_cast<const float*>(static_cast<const void*>(data.data() + array.offset));
+}
+
+#if RTNEURAL_USE_EIGEN
+# include "model_recurrent.hpp"
+
+/**
+   Run the recurrent layer over silence until its state stops changing, with the same step as the model kernels.
+   Returns false if it does not settle, which leaves @a state with nothing to store.
+ */
+template <bool lstm>
+static bool computeInitialState(const std::vector<uint8_t>& data, const BinaryModelHeader& header,
+                                std::vector<std::vector<float>>& state)
+{
+    const int size = static_cast<int>(header.hiddenSize);
+    const int gatesSize = size * (lstm ? 4 : 3);
+
+    if (header.arrays[kBinaryModelRnnRecurrent].rows != header.hiddenSize
+        || header.arrays[kBinaryModelRnnRecurrent].cols != static_cast<uint32_t>(gatesSize)
+        || header.arrays[kBinaryModelRnnBias].rows != (lstm ? 1u : 2u)
+        || header.arrays[kBinaryModelRnnBias].cols != static_cast<uint32_t>(gatesSize))
+        throw std::invalid_argument("Inconsistent weights shape");
+
+    // keras stores recurrent kernels as hidden x gates in row-major order, which is gates x hidden in column-major
+    const Eigen::Map<const Eigen::MatrixXf> recurrent(getModelArray(data, header.arrays[kBinaryModelRnnRecurrent]),
+                                                      gatesSize, size);
+    const float* const biasValues = getModelArray(data, header.arrays[kBinaryModelRnnBias]);
+
+    // the input is silence, so the input kernel never contributes and the gates start from the bias alone
+    Eigen::VectorXf bias = Eigen::Map<const Eigen::VectorXf>(biasValues, gatesSize);
+    Eigen::VectorXf recurrentBias = Eigen::VectorXf::Zero(size);
+
+    if constexpr (! lstm)
+    {
+        bias.head(size * 2) += Eigen::Map<const Eigen::VectorXf>(biasValues + gatesSize, size * 2);
+        recurrentBias = Eigen::Map<const Eigen::VectorXf>(biasValues + gatesSize + size * 2, size);
+    }
+
+    Eigen::VectorXf hidden = Eigen::VectorXf::Zero(size);
+    Eigen::VectorXf cell = Eigen::VectorXf::Zero(lstm ? size : 0);
+    Eigen::VectorXf lastHidden(size);
+    Eigen::VectorXf lastCell(lstm ? size : 0);
+    Eigen::VectorXf gates(gatesSize);
+    Eigen::VectorXf recurrentGates(gatesSize);
+
+    for (uint32_t step = 0; step < kBinaryModelInitialStateMaxSteps; ++step)
+    {
+        lastHidden = hidden;
+        lastCell = cell;
+
+        recurrentGates.noalias() = recurrent * hidden;
+        gates = bias;
+
+        stepRecurrentLayer<lstm, Eigen::Dynamic>(gates, recurrentGates, hidden, cell, recurrentBias, size);
+
+        float change = (hidden - lastHidden).cwiseAbs().maxCoeff();
+
+        if constexpr (lstm)
+            change = std::max(change, (cell - lastCell).cwiseAbs().maxCoeff());
+
+        if (change < kBinaryModelInitialStateTolerance)
+        {
+            state.assign(1, std::vector<float>(hidden.data(), hidden.data() + size));
+
+            if constexpr (lstm)
+                state.emplace_back(cell.data(), cell.data() + size);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif
+
+bool createBinaryModelData(const nlohmann::json& model_json, const ModelKernelInfo& info,
+                           const uint64_t sourceHash, std::vector<uint8_t>& out)
+{
+    out.assign(sizeof(BinaryModelHeader), 0);
+    BinaryModelHeader header = {};
+
+    try {
+        const nlohmann::json& layers = model_json.at("layers");
+
+        if (layers.size() != 2 || layers.at(1).at("type").get<std::string>() != "dense")
+            throw std::invalid_argument("Only single recurrent plus dense layer models are supported");
+
+        const nlohmann::json& rnn = layers.at(0);
+        const nlohmann::json& dense = layers.at(1);
+        const std::string rnnType = rnn.at("type").get<std::string>();
+
+        if (rnnType == "gru")
+            header.layerType = kBinaryModelLayerGRU;
+        else if (rnnType == "lstm")
+            header.layerType = kBinaryModelLayerLSTM;
+        else
+            throw std::invalid_argument("Unsupported recurrent layer type");
+
+        if (dense.at("shape").back().get<int>() != 1)
+            throw std::invalid_argument("Only models with a single output are supported");
+
+        header.inputSize = model_json.at("in_shape").back().get<uint32_t>();
+        header.hiddenSize = rnn.at("shape").back().get<uint32_t>();
+
+        const nlohmann::json& rnnWeights = rnn.at("weights");
+        const nlohmann::json& denseWeights = dense.at("weights");
+
+        appendModelArray(out, header.arrays[kBinaryModelRnnKernel],
+                         rnnWeights.at(0).get<std::vector<std::vector<float>>>(), false);
+        appendModelArray(out, header.arrays[kBinaryModelRnnRecurrent],
+                         rnnWeights.at(1).get<std::vector<std::vector<float>>>(), false);
+
+        if (header.layerType == kBinaryModelLayerLSTM)
+            appendModelArray(out, header.arrays[kBinaryModelRnnBias],
+                             { rnnWeights.at(2).get<std::vector<float>>() }, false);
+        else
+            appendModelArray(out, header.arrays[kBinaryModelRnnBias],
+                             rnnWeights.at(2).get<std::vector<std::vector<float>>>(), false);
+
+        appendModelArray(out, header.arrays[kBinaryModelDenseKernel],
+                         denseWeights.at(0).get<std::vector<std::vector<float>>>(), true);
+        appendModelArray(out, header.arrays[kBinaryModelDenseBias],
+                         { denseWeights.at(1).get<std::vector<float>>() }, false);
+
+        // conditioned models settle somewhere else for every parameter value, those keep pre-buffering
+        // only the Eigen based models use it, so it is not computed without them
+        std::vector<std::vector<float>> initialState;
+
+       #if RTNEURAL_USE_EIGEN
+        if (header.inputSize == 1)
+        {
+            const bool settles = header.layerType == kBinaryModelLayerLSTM
+                               ? computeInitialState<true>(out, header, initialState)
+                               : computeInitialState<false>(out, header, initialState);
+
+            if (! settles)
+                d_stdout("Model does not settle over silence, no initial state stored");
+        }
+       #endif
+
+        appendModelArray(out, header.arrays[kBinaryModelInitialState], initialState, false);
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Unable to convert model to binary, error: %s", e.what());
+        return false;
+    }
+
+    std::memcpy(header.magic, kBinaryModelMagic, sizeof(kBinaryModelMagic));
+    header.version = kBinaryModelVersion;
+    header.byteOrder = kBinaryModelByteOrder;
+    header.inputSkip = info.input_skip ? 1 : 0;
+    header.inputGain = info.input_gain;
+    header.outputGain = info.output_gain;
+    header.precision = info.precision != kModelPrecisionDefault ? info.precision : kModelPrecisionFloat;
+    header.sampleRate = info.sample_rate;
+    header.sourceHash = sourceHash;
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    // check our own output, catches shape mismatches before the data is ever used
+    BinaryModel check;
+    if (! isValidBinaryModel(out.data(), out.size(), check))
+    {
+        d_stderr2("Unable to convert model to binary, unexpected weights shape");
+        return false;
+    }
+
+    return true;
+}
+
+bool writeBinaryModel(const char* const filename, const std::vector<uint8_t>& out)
+{
+    // write to a unique temporary file first, so other instances never see a partial file
+    static std::atomic<uint> tmpCounter { 0 };
+   #ifdef DISTRHO_OS_WINDOWS
+    const uint pid = ::GetCurrentProcessId();
+   #else
+    const uint pid = ::getpid();
+   #endif
+    const String tmpFilename = String(filename) + ".tmp" + String(pid) + "-" + String(++tmpCounter);
+
+    FILE* const f = std::fopen(tmpFilename, "wb");
+    if (f == nullptr)
+        return false;
+
+    const bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    std::fclose(f);
+
+    if (! ok || std::rename(tmpFilename, filename) != 0)
+    {
+        std::remove(tmpFilename);
+        return false;
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+SharedModelWeights* SharedModelWeights::fromFile(const char* const filename, const uint64_t sourceHash)
+{
+    std::unique_ptr<SharedModelWeights> weights(new SharedModelWeights);
+
+    if (! weights->file.open(filename))
+        return nullptr;
+
+    if (sourceHash != 0 && weights->file.getModel().header->sourceHash != sourceHash)
+        return nullptr;
+
+    weights->model = weights->file.getModel();
+    weights->size = weights->file.getSize();
+    return weights.release();
+}
+
+SharedModelWeights* SharedModelWeights::fromData(const std::vector<uint8_t>& data)
+{
+    std::unique_ptr<SharedModelWeights> weights(new SharedModelWeights);
+
+    // offsets inside the data are aligned, so align its start too
+    weights->storage.resize(data.size() + kBinaryModelAlignment);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(weights->storage.data());
+    uint8_t* const aligned = weights->storage.data() + (alignOffset(address) - address);
+
+    std::memcpy(aligned, data.data(), data.size());
+
+    if (! isValidBinaryModel(aligned, data.size(), weights->model))
+        return nullptr;
+
+    weights->size = data.size();
+    return weights.release();
+}
+
+/* Keyed by content hash, weak references so entries never keep weights alive on their own */
+struct SharedModelWeightsCache {
+    Mutex mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<const SharedModelWeights>> entries;
+
+    static SharedModelWeightsCache& getInstance()
+    {
+        static SharedModelWeightsCache cache;
+        return cache;
+    }
+};
+
+std::shared_ptr<const SharedModelWeights> findSharedModelWeights(const uint64_t hash)
+{
+    SharedModelWeightsCache& cache = SharedModelWeightsCache::getInstance();
+    const MutexLocker cml(cache.mutex);
+
+    const auto it = cache.entries.find(hash);
+
+    if (it == cache.entries.end())
+        return nullptr;
+
+    std::shared_ptr<const SharedModelWeights> weights = it->second.lock();
+
+    if (weights == nullptr)
+        cache.entries.erase(it);
+
+    return weights;
+}
+
+std::shared_ptr<const SharedModelWeights> addSharedModelWeights(const uint64_t hash, SharedModelWeights* const ptr)
+{
+    std::shared_ptr<const SharedModelWeights> weights(ptr);
+
+    if (weights == nullptr)
+        return nullptr;
+
+    SharedModelWeightsCache& cache = SharedModelWeightsCache::getInstance();
+    const MutexLocker cml(cache.mutex);
+
+    // another thread may have loaded the same contents in the meantime, keep the first one
+    std::weak_ptr<const SharedModelWeights>& entry = cache.entries[hash];
+
+    if (std::shared_ptr<const SharedModelWeights> existing = entry.lock())
+        return existing;
+
+    entry = weights;
+    return weights;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+uint64_t hashModelData(const void* const data, const size_t size) noexcept
+{
+    const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static bool createDirectory(const String& path)
+{
+   #ifdef DISTRHO_OS_WINDOWS
+    return ::_mkdir(path) == 0 || errno == EEXIST;
+   #else
+    return ::mkdir(path, 0755) == 0 || errno == EEXIST;
+   #endif
+}
+
+String getModelCacheDir()
+{
+    String path;
+
+    if (const char* const envdir = std::getenv("AIDAX_MODEL_CACHE_DIR"))
+    {
+        // empty value disables the cache
+        if (envdir[0] == '\0')
+            return String();
+
+        path = envdir;
+        return createDirectory(path) ? path : String();
+    }
+
+   #if defined(DISTRHO_OS_WINDOWS)
+    const char* const basedir = std::getenv("LOCALAPPDATA");
+    if (basedir == nullptr || basedir[0] == '\0')
+        return String();
+    path = basedir;
+    path += "\\AIDA-X";
+    if (! createDirectory(path))
+        return String();
+    path += "\\cache";
+   #elif defined(DISTRHO_OS_MAC)
+    const char* const homedir = std::getenv("HOME");
+    if (homedir == nullptr || homedir[0] == '\0')
+        return String();
+    path = homedir;
+    path += "/Library/Caches/AIDA-X";
+   #else
+    if (const char* const xdgdir = std::getenv("XDG_CACHE_HOME"))
+    {
+        path = xdgdir;
+    }
+    else
+    {
+        const char* const homedir = std::getenv("HOME");
+        if (homedir == nullptr || homedir[0] == '\0')
+            return String();
+        path = homedir;
+        path += "/.cache";
+    }
+    if (! createDirectory(path))
+        return String();
+    path += "/AIDA-X";
+   #endif
+
+    return createDirectory(path) ? path : String();
+}
+
+String getModelCacheFilename(const uint64_t hash)
+{
+    String filename(getModelCacheDir());
+
+    if (filename.isEmpty())
+        return filename;
+
+   #ifdef DISTRHO_OS_WINDOWS
+    filename += "\\";
+   #else
+    filename += "/";
+   #endif
+    char hashstr[24] = {};
+    std::snprintf(hashstr, sizeof(hashstr) - 1, "%016llx", static_cast<unsigned long long>(hash));
+    filename += hashstr;
+    filename += ".aidax";
+
+    return filename;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
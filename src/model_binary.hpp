@@ -0,0 +1,205 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "model_kernel.hpp"
+
+#include "extra/Mutex.hpp"
+#include "extra/String.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Compiled binary model format (.aidax)
+//
+// A fixed header followed by flat float arrays, each starting at a kBinaryModelAlignment boundary.
+// Arrays use the same layout as the json weights, except for the dense kernel which is stored as (out x in),
+// the way RTNeural takes it. Files are written in native byte order and rejected if it does not match.
+// Weights are always stored in full precision, reduced precision models convert them when created.
+// The initial state is where silence leaves the recurrent state, computed once at conversion so reset() can jump there
+// instead of pre-buffering. It is only stored for models without conditioning inputs that settle, and is empty otherwise.
+
+/* File magic, version and alignment of each weight array */
+static constexpr const char kBinaryModelMagic[8] = { 'A', 'I', 'D', 'A', 'X', 'M', 'D', 'L' };
+static constexpr const uint32_t kBinaryModelVersion = 4;
+static constexpr const uint32_t kBinaryModelByteOrder = 0x01020304;
+static constexpr const uint32_t kBinaryModelAlignment = 64;
+
+/* Limits for computing the initial state, the largest change of a state value over one step for it to be settled */
+static constexpr const uint32_t kBinaryModelInitialStateMaxSteps = 8192;
+static constexpr const float kBinaryModelInitialStateTolerance = 1e-6f;
+
+enum BinaryModelLayerType : uint32_t {
+    kBinaryModelLayerGRU = 0,
+    kBinaryModelLayerLSTM = 1,
+};
+
+enum BinaryModelArrays {
+    kBinaryModelRnnKernel = 0,  /* (input_size x gates * hidden_size) */
+    kBinaryModelRnnRecurrent,   /* (hidden_size x gates * hidden_size) */
+    kBinaryModelRnnBias,        /* GRU: (2 x 3 * hidden_size), LSTM: (1 x 4 * hidden_size) */
+    kBinaryModelDenseKernel,    /* (1 x hidden_size) */
+    kBinaryModelDenseBias,      /* (1 x 1) */
+    kBinaryModelInitialState,   /* GRU: (1 x hidden_size), LSTM: (2 x hidden_size) hidden then cell, or (0 x 0) */
+    kBinaryModelArrayCount
+};
+
+struct BinaryModelArray {
+    uint64_t offset;
+    uint32_t rows;
+    uint32_t cols;
+};
+
+struct BinaryModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t layerType;
+    uint32_t inputSize;
+    uint32_t hiddenSize;
+    uint32_t inputSkip;
+    float inputGain;  /* linear, not dB */
+    float outputGain; /* linear, not dB */
+    uint32_t precision; /* ModelPrecision, never kModelPrecisionDefault */
+    uint32_t sampleRate; /* training sample rate in Hz, 0 if unknown */
+    uint64_t sourceHash;
+    BinaryModelArray arrays[kBinaryModelArrayCount];
+};
+
+static_assert(sizeof(BinaryModelHeader) == 152, "BinaryModelHeader must have a fixed size");
+
+// --------------------------------------------------------------------------------------------------------------------
+// Validated view of a binary model, weights point into the file data
+
+struct BinaryModel {
+    const BinaryModelHeader* header;
+    const float* arrays[kBinaryModelArrayCount];
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Memory-mapped binary model file
+
+class BinaryModelFile
+{
+    void* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    BinaryModel model = {};
+
+public:
+    BinaryModelFile() noexcept {}
+    ~BinaryModelFile() noexcept { close(); }
+
+    /* Open, map and validate a binary model file, returns false on error */
+    bool open(const char* filename);
+    void close() noexcept;
+
+    /* Only valid after a successful open() */
+    const BinaryModel& getModel() const noexcept { return model; }
+    size_t getSize() const noexcept { return size; }
+
+    DISTRHO_DECLARE_NON_COPYABLE(BinaryModelFile)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Immutable model weights, shared by reference count between all models loaded from the same contents.
+//
+// A process-wide cache keyed by content hash hands out the same weights to every load of a model file, so only the
+// first load reads and converts it. Entries are dropped together with the last model holding them.
+// Models that need the weights in another form (e.g. fixed size or quantized matrices) build those once per weights
+// with getLayers(), and keep only their recurrent state per instance.
+
+class SharedModelWeights
+{
+    BinaryModelFile file;
+    std::vector<uint8_t> storage;
+    BinaryModel model = {};
+    size_t size = 0;
+
+    // converted layers by type, kept while some model is using them
+    mutable Mutex layersMutex;
+    mutable std::vector<std::pair<std::type_index, std::weak_ptr<const void>>> layers;
+
+    SharedModelWeights() noexcept {}
+
+public:
+    /* Map a binary model file, optionally checking its source hash, returns null on error */
+    static SharedModelWeights* fromFile(const char* filename, uint64_t sourceHash = 0);
+
+    /* Copy binary model data into aligned memory, returns null on error */
+    static SharedModelWeights* fromData(const std::vector<uint8_t>& data);
+
+    const BinaryModel& getModel() const noexcept { return model; }
+
+    /* Size of the binary model data, header and weights */
+    size_t getSize() const noexcept { return size; }
+
+    /* Get immutable layers built from these weights with T(const BinaryModel&), building them on first use.
+       May throw whatever the T constructor throws. */
+    template <typename T>
+    std::shared_ptr<const T> getLayers() const
+    {
+        const std::type_index type(typeid(T));
+        const MutexLocker cml(layersMutex);
+
+        for (auto& entry : layers)
+        {
+            if (entry.first != type)
+                continue;
+
+            if (std::shared_ptr<const void> existing = entry.second.lock())
+                return std::static_pointer_cast<const T>(existing);
+
+            // not using make_shared, layers may need more alignment than it guarantees
+            std::shared_ptr<const T> newlayers(new T(model));
+            entry.second = newlayers;
+            return newlayers;
+        }
+
+        std::shared_ptr<const T> newlayers(new T(model));
+        layers.emplace_back(type, newlayers);
+        return newlayers;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(SharedModelWeights)
+};
+
+/* Look up cached weights by content hash, returns null if no model is using them */
+std::shared_ptr<const SharedModelWeights> findSharedModelWeights(uint64_t hash);
+
+/* Add weights to the cache taking ownership, returns the already cached ones instead if there are any */
+std::shared_ptr<const SharedModelWeights> addSharedModelWeights(uint64_t hash, SharedModelWeights* weights);
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Convert a parsed json model into binary model data in memory, returns false on error */
+bool createBinaryModelData(const nlohmann::json& model_json, const ModelKernelInfo& info,
+                           uint64_t sourceHash, std::vector<uint8_t>& data);
+
+/* Write binary model data into a file, returns false on error */
+bool writeBinaryModel(const char* filename, const std::vector<uint8_t>& data);
+
+/* 64-bit FNV-1a hash, used for keying cached binary models by their json contents */
+uint64_t hashModelData(const void* data, size_t size) noexcept;
+
+/* Directory for cached binary models, empty if none could be created */
+String getModelCacheDir();
+
+/* Cached binary model filename for json contents with the given hash, empty if there is no cache directory */
+String getModelCacheFilename(uint64_t hash);
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
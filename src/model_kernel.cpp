@@ -0,0 +1,1734 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// This file is built once per model kernel.
+// Without AIDAX_MODEL_KERNEL defined it becomes the generic kernel, built with the regular compiler flags.
+// Otherwise it is included from kernels/model_kernel_*.cpp, which are built with extra instruction set flags.
+// In that case RTNeural and its backends are moved into a per-kernel namespace, so that template code built for
+// different instruction sets does not get merged together by the linker.
+
+#ifdef AIDAX_MODEL_KERNEL
+# define AIDAX_KERNEL_NAMESPACE2(ns, kernel) ns ## _ ## kernel
+# define AIDAX_KERNEL_NAMESPACE(ns, kernel) AIDAX_KERNEL_NAMESPACE2(ns, kernel)
+# define RTNeural AIDAX_KERNEL_NAMESPACE(RTNeural, AIDAX_MODEL_KERNEL)
+# define Eigen AIDAX_KERNEL_NAMESPACE(Eigen, AIDAX_MODEL_KERNEL)
+# define xsimd AIDAX_KERNEL_NAMESPACE(xsimd, AIDAX_MODEL_KERNEL)
+#else
+# define AIDAX_MODEL_KERNEL generic
+#endif
+
+#include "model_binary.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+START_NAMESPACE_DISTRHO
+
+namespace AIDAX_MODEL_KERNEL {
+
+#include "model_variant.hpp"
+
+#if RTNEURAL_USE_EIGEN
+# include "model_recurrent.hpp"
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// Architecture lookup, maps (layer type, hidden size, input size) to a ModelVariantType alternative in O(1)
+
+template <typename T>
+struct is_lstm_layer : std::false_type {};
+
+template <int in_size, int out_size>
+struct is_lstm_layer<RTNeural::LSTMLayerT<float, in_size, out_size>> : std::true_type {};
+
+struct ModelArchitecture {
+    bool lstm;
+    int hidden_size;
+    int input_size;
+};
+
+template <typename ModelType>
+static constexpr ModelArchitecture getModelArchitecture()
+{
+    using RNNLayerType = std::decay_t<decltype(std::declval<ModelType&>().template get<0>())>;
+    return { is_lstm_layer<RNNLayerType>::value, RNNLayerType::out_size, ModelType::input_size };
+}
+
+template <size_t... Is>
+static constexpr int getMaxHiddenSize(std::index_sequence<Is...>)
+{
+    int maxHiddenSize = 0;
+    ((maxHiddenSize = std::max(maxHiddenSize,
+                               getModelArchitecture<std::variant_alternative_t<Is + 1, ModelVariantType>>().hidden_size)),
+     ...);
+    return maxHiddenSize;
+}
+
+static constexpr const size_t kNumModelTypes = std::variant_size_v<ModelVariantType> - 1; // without NullModel
+static constexpr const int kMaxHiddenSize = getMaxHiddenSize(std::make_index_sequence<kNumModelTypes>());
+
+static constexpr size_t getModelArchitectureKey(const bool lstm, const int hidden_size, const int input_size)
+{
+    return ((lstm ? 1 : 0) * (kMaxHiddenSize + 1) + hidden_size) * (MAX_INPUT_SIZE + 1) + input_size;
+}
+
+static constexpr const size_t kModelArchitectureKeyCount = getModelArchitectureKey(true, kMaxHiddenSize, MAX_INPUT_SIZE) + 1;
+
+/* Variant index for each architecture key, 0 (NullModel) if unsupported */
+template <size_t... Is>
+static constexpr std::array<uint8_t, kModelArchitectureKeyCount> createModelIndexTable(std::index_sequence<Is...>)
+{
+    static_assert(std::variant_size_v<ModelVariantType> <= 256, "Too many model types for 8-bit table entries");
+
+    std::array<uint8_t, kModelArchitectureKeyCount> table = {};
+    ((table[getModelArchitectureKey(getModelArchitecture<std::variant_alternative_t<Is + 1, ModelVariantType>>().lstm,
+                                    getModelArchitecture<std::variant_alternative_t<Is + 1, ModelVariantType>>().hidden_size,
+                                    getModelArchitecture<std::variant_alternative_t<Is + 1, ModelVariantType>>().input_size)]
+        = Is + 1),
+     ...);
+    return table;
+}
+
+static constexpr const std::array<uint8_t, kModelArchitectureKeyCount> kModelIndexTable
+    = createModelIndexTable(std::make_index_sequence<kNumModelTypes>());
+
+using ModelEmplacer = void (*)(ModelVariantType&);
+
+template <size_t Index>
+static void emplaceModel(ModelVariantType& variant)
+{
+    variant.template emplace<Index>();
+}
+
+template <size_t... Is>
+static constexpr std::array<ModelEmplacer, sizeof...(Is)> createModelEmplacers(std::index_sequence<Is...>)
+{
+    return {{ &emplaceModel<Is>... }};
+}
+
+static constexpr const std::array<ModelEmplacer, std::variant_size_v<ModelVariantType>> kModelEmplacers
+    = createModelEmplacers(std::make_index_sequence<std::variant_size_v<ModelVariantType>>());
+
+/* Emplace the model type matching an architecture, returns false if not supported */
+static bool createModelVariant(const ModelArchitecture& arch, ModelVariantType& variant)
+{
+    if (arch.hidden_size <= 0 || arch.hidden_size > kMaxHiddenSize)
+        return false;
+    if (arch.input_size <= 0 || arch.input_size > MAX_INPUT_SIZE)
+        return false;
+
+    const uint8_t index = kModelIndexTable[getModelArchitectureKey(arch.lstm, arch.hidden_size, arch.input_size)];
+
+    if (index == 0)
+        return false;
+
+    kModelEmplacers[index](variant);
+    return true;
+}
+
+/* Read the architecture from a json model, without copying any layers or weights.
+   Returns false for layouts other than a single recurrent layer followed by a dense output. */
+static bool getModelArchitecture(const nlohmann::json& model_json, ModelArchitecture& arch)
+{
+    const nlohmann::json& layers = model_json.at("layers");
+
+    if (layers.size() != 2 || layers.at(1).at("type").get_ref<const std::string&>() != "dense")
+        return false;
+    if (layers.at(1).at("shape").back().get<int>() != 1)
+        return false;
+
+    const nlohmann::json& rnn_layer = layers.at(0);
+    const std::string& rnn_layer_type = rnn_layer.at("type").get_ref<const std::string&>();
+
+    if (rnn_layer_type == "lstm")
+        arch.lstm = true;
+    else if (rnn_layer_type == "gru")
+        arch.lstm = false;
+    else
+        return false;
+
+    arch.hidden_size = rnn_layer.at("shape").back().get<int>();
+    arch.input_size = model_json.at("in_shape").back().get<int>();
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Run a model over a buffer, shared by the fixed-size and dynamic models
+
+template <int input_size, typename ModelType>
+static void processModel(ModelType& custom_model, float* const out, const uint32_t numSamples,
+                         const bool input_skip, const float input_gain, const float output_gain,
+                         LinearValueSmoother& param1, LinearValueSmoother& param2)
+{
+    if (d_isNotEqual(input_gain, 1.f))
+    {
+        for (uint32_t i=0; i<numSamples; ++i)
+            out[i] *= input_gain;
+    }
+
+    if constexpr (input_size == 1)
+    {
+        if (input_skip)
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+                out[i] += custom_model.forward(out + i);
+        }
+        else
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+                out[i] = custom_model.forward(out + i) * output_gain;
+        }
+    }
+    else if constexpr (input_size == 2)
+    {
+        float inArray1 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[2];
+
+        if (input_skip)
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+            {
+                inArray1[0] = out[i];
+                inArray1[1] = param1.next();
+                out[i] += custom_model.forward(inArray1);
+            }
+        }
+        else
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+            {
+                inArray1[0] = out[i];
+                inArray1[1] = param1.next();
+                out[i] = custom_model.forward(inArray1) * output_gain;
+            }
+        }
+    }
+    else if constexpr (input_size == 3)
+    {
+        float inArray2 alignas(RTNEURAL_DEFAULT_ALIGNMENT)[3];
+
+        if (input_skip)
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+            {
+                inArray2[0] = out[i];
+                inArray2[1] = param1.next();
+                inArray2[2] = param2.next();
+                out[i] += custom_model.forward(inArray2);
+            }
+        }
+        else
+        {
+            for (uint32_t i=0; i<numSamples; ++i)
+            {
+                inArray2[0] = out[i];
+                inArray2[1] = param1.next();
+                inArray2[2] = param2.next();
+                out[i] = custom_model.forward(inArray2) * output_gain;
+            }
+        }
+    }
+
+    if (input_skip && d_isNotEqual(output_gain, 1.f))
+    {
+        for (uint32_t i=0; i<numSamples; ++i)
+            out[i] *= output_gain;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Run two copies of a model over 2 buffers, one sample of each at a time.
+// The recurrent states do not depend on each other, stepping both together lets their computations overlap
+// instead of waiting on the latency of a single dependency chain.
+
+template <int input_size, typename ModelType>
+static void processModelStereo(ModelType& left_model, ModelType& right_model,
+                               float* const left, float* const right, const uint32_t numSamples,
+                               const bool input_skip, const float input_gain, const float output_gain,
+                               LinearValueSmoother& param1, LinearValueSmoother& param2)
+{
+    if (d_isNotEqual(input_gain, 1.f))
+    {
+        for (uint32_t i=0; i<numSamples; ++i)
+        {
+            left[i] *= input_gain;
+            right[i] *= input_gain;
+        }
+    }
+
+    float leftArray alignas(RTNEURAL_DEFAULT_ALIGNMENT)[input_size];
+    float rightArray alignas(RTNEURAL_DEFAULT_ALIGNMENT)[input_size];
+
+    for (uint32_t i=0; i<numSamples; ++i)
+    {
+        leftArray[0] = left[i];
+        rightArray[0] = right[i];
+
+        // conditioning parameters are the same for both channels
+        if constexpr (input_size >= 2)
+            leftArray[1] = rightArray[1] = param1.next();
+        if constexpr (input_size >= 3)
+            leftArray[2] = rightArray[2] = param2.next();
+
+        const float leftOut = left_model.forward(leftArray);
+        const float rightOut = right_model.forward(rightArray);
+
+        if (input_skip)
+        {
+            left[i] += leftOut;
+            right[i] += rightOut;
+        }
+        else
+        {
+            left[i] = leftOut * output_gain;
+            right[i] = rightOut * output_gain;
+        }
+    }
+
+    if (input_skip && d_isNotEqual(output_gain, 1.f))
+    {
+        for (uint32_t i=0; i<numSamples; ++i)
+        {
+            left[i] *= output_gain;
+            right[i] *= output_gain;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+class VariantModel : public DynamicModel
+{
+public:
+    ModelVariantType variant;
+    // same model type and weights, for the right channel in stereo mode
+    std::unique_ptr<ModelVariantType> rightVariant;
+    bool input_skip = false;
+    float input_gain = 1.f;
+    float output_gain = 1.f;
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // This function carries model calculations
+
+    void process(float* const out, const uint32_t numSamples,
+                 LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        const bool input_skip = this->input_skip;
+        const float input_gain = this->input_gain;
+        const float output_gain = this->output_gain;
+
+        std::visit(
+            [&out, numSamples, input_skip, input_gain, output_gain, &param1, &param2] (auto&& custom_model)
+            {
+                using ModelType = std::decay_t<decltype (custom_model)>;
+                if constexpr (! std::is_same_v<ModelType, NullModel>)
+                {
+                    processModel<ModelType::input_size>(custom_model, out, numSamples,
+                                                        input_skip, input_gain, output_gain, param1, param2);
+                }
+            },
+            variant
+        );
+    }
+
+    void processStereo(float* const left, float* const right, const uint32_t numSamples,
+                       LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        if (rightVariant == nullptr)
+        {
+            process(left, numSamples, param1, param2);
+            std::memcpy(right, left, sizeof(float) * numSamples);
+            return;
+        }
+
+        const bool input_skip = this->input_skip;
+        const float input_gain = this->input_gain;
+        const float output_gain = this->output_gain;
+        ModelVariantType& rightVariant = *this->rightVariant;
+
+        std::visit(
+            [&left, &right, &rightVariant, numSamples, input_skip, input_gain, output_gain, &param1, &param2]
+            (auto&& custom_model)
+            {
+                using ModelType = std::decay_t<decltype (custom_model)>;
+                if constexpr (! std::is_same_v<ModelType, NullModel>)
+                {
+                    processModelStereo<ModelType::input_size>(custom_model, std::get<ModelType>(rightVariant),
+                                                              left, right, numSamples,
+                                                              input_skip, input_gain, output_gain, param1, param2);
+                }
+            },
+            variant
+        );
+    }
+
+    // ----------------------------------------------------------------------------------------------------------------
+    // Reset model internal state
+
+    void reset() override
+    {
+        resetVariant(variant);
+
+        if (rightVariant != nullptr)
+            resetVariant(*rightVariant);
+    }
+
+    static void resetVariant(ModelVariantType& variant)
+    {
+        std::visit (
+            [] (auto&& custom_model)
+            {
+                using ModelType = std::decay_t<decltype (custom_model)>;
+                if constexpr (! std::is_same_v<ModelType, NullModel>)
+                {
+                    custom_model.reset();
+                }
+            },
+            variant);
+    }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Generic RTNeural model, slower but not limited to the architectures in ModelVariantType
+
+class FallbackModel : public DynamicModel
+{
+public:
+    std::unique_ptr<RTNeural::Model<float>> model;
+    // same layers and weights, for the right channel in stereo mode
+    std::unique_ptr<RTNeural::Model<float>> rightModel;
+    bool input_skip = false;
+    float input_gain = 1.f;
+    float output_gain = 1.f;
+
+    void process(float* const out, const uint32_t numSamples,
+                 LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        switch (model->getInSize())
+        {
+        case 1:
+            processModel<1>(*model, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 2:
+            processModel<2>(*model, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 3:
+            processModel<3>(*model, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        }
+    }
+
+    void processStereo(float* const left, float* const right, const uint32_t numSamples,
+                       LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        if (rightModel == nullptr)
+        {
+            process(left, numSamples, param1, param2);
+            std::memcpy(right, left, sizeof(float) * numSamples);
+            return;
+        }
+
+        switch (model->getInSize())
+        {
+        case 1:
+            processModelStereo<1>(*model, *rightModel, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 2:
+            processModelStereo<2>(*model, *rightModel, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 3:
+            processModelStereo<3>(*model, *rightModel, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        }
+    }
+
+    void reset() override
+    {
+        model->reset();
+
+        if (rightModel != nullptr)
+            rightModel->reset();
+    }
+};
+
+/* The right channel model is only used in stereo mode, it must have been created from the same data */
+static DynamicModel* createFallbackModel(std::unique_ptr<RTNeural::Model<float>> model,
+                                         std::unique_ptr<RTNeural::Model<float>> rightModel,
+                                         const ModelKernelInfo& info)
+{
+    if (model == nullptr || model->getOutSize() != 1 || model->getInSize() < 1 || model->getInSize() > MAX_INPUT_SIZE)
+    {
+        d_stderr2("Error loading model: Unable to identify a known model architecture!");
+        return nullptr;
+    }
+
+    if (info.stereo && rightModel == nullptr)
+    {
+        d_stderr2("Error loading model: Unable to create the right channel model!");
+        return nullptr;
+    }
+
+    d_stdout("Model architecture is not built-in, using generic RTNeural model");
+
+    model->reset();
+
+    std::unique_ptr<FallbackModel> newmodel = std::make_unique<FallbackModel>();
+    newmodel->model = std::move(model);
+
+    if (info.stereo)
+    {
+        rightModel->reset();
+        newmodel->rightModel = std::move(rightModel);
+    }
+
+    newmodel->input_skip = info.input_skip;
+    newmodel->input_gain = info.input_gain;
+    newmodel->output_gain = info.output_gain;
+
+    return newmodel.release();
+}
+
+static std::unique_ptr<RTNeural::Model<float>> parseFallbackModel(const nlohmann::json& model_json)
+{
+    std::unique_ptr<RTNeural::Model<float>> model = RTNeural::json_parser::parseJson<float>(model_json, false);
+
+    // layers that RTNeural could not parse are skipped instead of failing
+    if (model != nullptr && model->layers.size() != model_json.at("layers").size())
+        model.reset();
+
+    return model;
+}
+
+static DynamicModel* createFallbackModel(const nlohmann::json& model_json, const ModelKernelInfo& info)
+{
+    std::unique_ptr<RTNeural::Model<float>> model, rightModel;
+
+    try {
+        model = parseFallbackModel(model_json);
+
+        if (info.stereo && model != nullptr)
+            rightModel = parseFallbackModel(model_json);
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading model: %s", e.what());
+        return nullptr;
+    }
+
+    return createFallbackModel(std::move(model), std::move(rightModel), info);
+}
+
+/* Empty model of the same type as @a variant, for the right channel in stereo mode */
+static std::unique_ptr<ModelVariantType> createRightVariant(const ModelVariantType& variant)
+{
+    std::unique_ptr<ModelVariantType> rightVariant = std::make_unique<ModelVariantType>();
+    kModelEmplacers[variant.index()](*rightVariant);
+    return rightVariant;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Create a model matching the json architecture, returns null on error
+
+DynamicModel* createDynamicModel(const nlohmann::json& model_json, const ModelKernelInfo& info)
+{
+    std::unique_ptr<VariantModel> newmodel = std::make_unique<VariantModel>();
+
+    try {
+        ModelArchitecture arch;
+        if (! getModelArchitecture (model_json, arch) || ! createModelVariant (arch, newmodel->variant))
+            return createFallbackModel (model_json, info);
+
+        const auto loadWeights = [&model_json] (auto&& custom_model)
+        {
+            using ModelType = std::decay_t<decltype (custom_model)>;
+            if constexpr (! std::is_same_v<ModelType, NullModel>)
+            {
+                custom_model.parseJson (model_json, true);
+                custom_model.reset();
+            }
+        };
+
+        std::visit (loadWeights, newmodel->variant);
+
+        if (info.stereo)
+        {
+            newmodel->rightVariant = createRightVariant (newmodel->variant);
+            std::visit (loadWeights, *newmodel->rightVariant);
+        }
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading model: %s", e.what());
+        return nullptr;
+    }
+
+    // save extra info
+    newmodel->input_skip = info.input_skip;
+    newmodel->input_gain = info.input_gain;
+    newmodel->output_gain = info.output_gain;
+
+    return newmodel.release();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Load weights from a binary model straight into the RTNeural layers
+
+static std::vector<std::vector<float>> getBinaryModelMatrix(const BinaryModel& model, const int index)
+{
+    const BinaryModelArray& array = model.header->arrays[index];
+    const float* const values = model.arrays[index];
+
+    std::vector<std::vector<float>> matrix(array.rows);
+
+    for (uint32_t r = 0; r < array.rows; ++r)
+        matrix[r].assign(values + r * array.cols, values + (r + 1) * array.cols);
+
+    return matrix;
+}
+
+/* Works for both fixed-size and generic RTNeural layers, they share the same setters */
+template <bool lstm, typename RNNLayerType, typename DenseLayerType>
+static void setBinaryModelWeights(RNNLayerType& rnn, DenseLayerType& dense, const BinaryModel& model)
+{
+    rnn.setWVals(getBinaryModelMatrix(model, kBinaryModelRnnKernel));
+    rnn.setUVals(getBinaryModelMatrix(model, kBinaryModelRnnRecurrent));
+
+    if constexpr (lstm)
+    {
+        const float* const bias = model.arrays[kBinaryModelRnnBias];
+        rnn.setBVals(std::vector<float>(bias, bias + model.header->arrays[kBinaryModelRnnBias].cols));
+    }
+    else
+    {
+        rnn.setBVals(getBinaryModelMatrix(model, kBinaryModelRnnBias));
+    }
+
+    dense.setWeights(getBinaryModelMatrix(model, kBinaryModelDenseKernel));
+    dense.setBias(model.arrays[kBinaryModelDenseBias]);
+}
+
+template <typename ModelType>
+static void setBinaryModelWeights(ModelType& custom_model, const BinaryModel& model)
+{
+    auto& rnn = custom_model.template get<0>();
+    auto& dense = custom_model.template get<1>();
+    using RNNLayerType = std::decay_t<decltype(rnn)>;
+
+    setBinaryModelWeights<is_lstm_layer<RNNLayerType>::value>(rnn, dense, model);
+}
+
+static std::unique_ptr<RTNeural::Model<float>> createFallbackModelLayers(const BinaryModel& model)
+{
+    const int input_size = static_cast<int>(model.header->inputSize);
+    const int hidden_size = static_cast<int>(model.header->hiddenSize);
+
+    std::unique_ptr<RTNeural::Model<float>> newmodel = std::make_unique<RTNeural::Model<float>>(input_size);
+
+    // the model owns its layers as soon as they are added
+    if (model.header->layerType == kBinaryModelLayerLSTM)
+    {
+        RTNeural::LSTMLayer<float>* const rnn = new RTNeural::LSTMLayer<float>(input_size, hidden_size);
+        newmodel->addLayer(rnn);
+        RTNeural::Dense<float>* const dense = new RTNeural::Dense<float>(hidden_size, 1);
+        newmodel->addLayer(dense);
+        setBinaryModelWeights<true>(*rnn, *dense, model);
+    }
+    else
+    {
+        RTNeural::GRULayer<float>* const rnn = new RTNeural::GRULayer<float>(input_size, hidden_size);
+        newmodel->addLayer(rnn);
+        RTNeural::Dense<float>* const dense = new RTNeural::Dense<float>(hidden_size, 1);
+        newmodel->addLayer(dense);
+        setBinaryModelWeights<false>(*rnn, *dense, model);
+    }
+
+    return newmodel;
+}
+
+static DynamicModel* createFallbackModel(const BinaryModel& model, const ModelKernelInfo& info)
+{
+    std::unique_ptr<RTNeural::Model<float>> newmodel, rightModel;
+
+    try {
+        newmodel = createFallbackModelLayers(model);
+
+        if (info.stereo)
+            rightModel = createFallbackModelLayers(model);
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading model: %s", e.what());
+        return nullptr;
+    }
+
+    return createFallbackModel(std::move(newmodel), std::move(rightModel), info);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Reduced precision models, with the recurrent weights stored as bf16 or int8 values.
+//
+// The recurrent matrix holds nearly all the weights of a model, for the big models it no longer fits in the L1 cache
+// of small ARM cores and gets read from L2 on every sample. In 16 or 8 bits it fits again.
+// Weights are expanded to float while multiplying and all sums are done in float, int8 weights have a scale per gate
+// output (a column of the hiddenSize x gates recurrent matrix) so each one uses the whole 8-bit range.
+// Input kernel, biases and dense layer are tiny and stay in float.
+// Non-quantized weights are used in place, the binary model data must outlive the model.
+
+#if RTNEURAL_USE_EIGEN
+/* Initial state stored in a binary model, hidden then cell values for LSTM, null if the model has none */
+static const float* getBinaryModelInitialState(const BinaryModel& model) noexcept
+{
+    return model.header->arrays[kBinaryModelInitialState].rows != 0 ? model.arrays[kBinaryModelInitialState] : nullptr;
+}
+
+static inline float decodeWeight(const int8_t value) noexcept
+{
+    return static_cast<float>(value);
+}
+
+/* bf16 is the upper half of a float */
+static inline float decodeWeight(const uint16_t value) noexcept
+{
+    const uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/* Matrix of (rows x cols) weights, stored row-major with int8_t or uint16_t (bf16) values */
+template <typename WeightType>
+class QuantizedMatrix
+{
+    static constexpr const bool kScaled = std::is_same_v<WeightType, int8_t>;
+
+    const int rows;
+    const int cols;
+    std::vector<WeightType> values;
+    std::vector<float> scales; /* cols, one per gate output, int8 only */
+
+public:
+    QuantizedMatrix(const float* const weights, const int rows_, const int cols_)
+        : rows(rows_),
+          cols(cols_),
+          values(static_cast<size_t>(rows_) * cols_),
+          scales(kScaled ? cols_ : 0, 0.f)
+    {
+        if constexpr (kScaled)
+        {
+            for (int r = 0; r < rows; ++r)
+                for (int c = 0; c < cols; ++c)
+                    scales[c] = std::max(scales[c], std::abs(weights[r * cols + c]));
+
+            // all zero columns can use any scale
+            for (int c = 0; c < cols; ++c)
+                scales[c] = d_isNotZero(scales[c]) ? scales[c] / 127.f : 1.f;
+        }
+
+        for (int r = 0; r < rows; ++r)
+        {
+            for (int c = 0; c < cols; ++c)
+            {
+                const float weight = weights[r * cols + c];
+
+                if constexpr (kScaled)
+                {
+                    values[r * cols + c] = static_cast<int8_t>(std::lround(weight / scales[c]));
+                }
+                else
+                {
+                    // round to nearest even
+                    uint32_t bits;
+                    std::memcpy(&bits, &weight, sizeof(bits));
+                    values[r * cols + c] = static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+                }
+            }
+        }
+    }
+
+    /* out = in * matrix, for @a in of size rows and @a out of size cols */
+    void multiply(float* const out, const float* const in) const noexcept
+    {
+        std::fill(out, out + cols, 0.f);
+
+        for (int r = 0; r < rows; ++r)
+        {
+            const float x = in[r];
+            const WeightType* const row = values.data() + r * cols;
+
+            for (int c = 0; c < cols; ++c)
+                out[c] += decodeWeight(row[c]) * x;
+        }
+
+        if constexpr (kScaled)
+        {
+            for (int c = 0; c < cols; ++c)
+                out[c] *= scales[c];
+        }
+    }
+};
+
+/* Immutable weights built once per SharedModelWeights, shared by every recurrent state using them */
+template <bool lstm, typename WeightType>
+struct QuantizedRecurrentLayers
+{
+    using Matrix = Eigen::MatrixXf;
+    using Vector = Eigen::VectorXf;
+
+    static constexpr const int kNumGates = lstm ? 4 : 3;
+
+    const int inputSize;
+    const int hiddenSize;
+
+    // keras stores kernels as input x gates in row-major order, the same as gates x input in column-major
+    Eigen::Map<const Matrix> kernel;               /* gates x inputSize */
+    QuantizedMatrix<WeightType> recurrent;         /* hiddenSize x gates */
+    Eigen::Map<const Eigen::RowVectorXf> dense;    /* hiddenSize */
+    Vector bias;            /* gates, GRU adds the recurrent bias of update and reset gates here */
+    Vector recurrentBias;   /* hiddenSize, recurrent bias of the GRU candidate gate */
+    float denseBias;
+    Vector initialHidden;   /* hiddenSize, state set by reset() */
+    Vector initialCell;     /* hiddenSize, LSTM only */
+    const bool settled;     /* initial state taken from the model, instead of zeros */
+
+    explicit QuantizedRecurrentLayers(const BinaryModel& model)
+        : inputSize(static_cast<int>(model.header->inputSize)),
+          hiddenSize(static_cast<int>(model.header->hiddenSize)),
+          kernel(model.arrays[kBinaryModelRnnKernel], hiddenSize * kNumGates, inputSize),
+          recurrent(model.arrays[kBinaryModelRnnRecurrent], hiddenSize, hiddenSize * kNumGates),
+          dense(model.arrays[kBinaryModelDenseKernel], hiddenSize),
+          bias(Eigen::Map<const Vector>(model.arrays[kBinaryModelRnnBias], hiddenSize * kNumGates)),
+          recurrentBias(Vector::Zero(hiddenSize)),
+          denseBias(model.arrays[kBinaryModelDenseBias][0]),
+          initialHidden(Vector::Zero(hiddenSize)),
+          initialCell(Vector::Zero(lstm ? hiddenSize : 0)),
+          settled(getBinaryModelInitialState(model) != nullptr)
+    {
+        if constexpr (! lstm)
+        {
+            const float* const recurrentBiasValues = model.arrays[kBinaryModelRnnBias] + hiddenSize * kNumGates;
+
+            bias.head(hiddenSize * 2) += Eigen::Map<const Vector>(recurrentBiasValues, hiddenSize * 2);
+            recurrentBias = Eigen::Map<const Vector>(recurrentBiasValues + hiddenSize * 2, hiddenSize);
+        }
+
+        if (const float* const initialState = getBinaryModelInitialState(model))
+        {
+            initialHidden = Eigen::Map<const Vector>(initialState, hiddenSize);
+
+            if constexpr (lstm)
+                initialCell = Eigen::Map<const Vector>(initialState + hiddenSize, hiddenSize);
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(QuantizedRecurrentLayers)
+};
+
+/* Recurrent state of one channel, with the same forward() and reset() as RTNeural models */
+template <bool lstm, typename WeightType>
+class QuantizedRecurrentState
+{
+    using Layers = QuantizedRecurrentLayers<lstm, WeightType>;
+    using Vector = Eigen::VectorXf;
+
+    const Layers& layers;
+    Vector hidden;
+    Vector cell;            /* LSTM only */
+    Vector gates;
+    Vector recurrentGates;
+
+public:
+    explicit QuantizedRecurrentState(const Layers& layers_)
+        : layers(layers_),
+          hidden(layers_.initialHidden),
+          cell(layers_.initialCell),
+          gates(layers_.hiddenSize * Layers::kNumGates),
+          recurrentGates(layers_.hiddenSize * Layers::kNumGates) {}
+
+    void reset()
+    {
+        hidden = layers.initialHidden;
+        cell = layers.initialCell;
+    }
+
+    float forward(const float* const input) noexcept
+    {
+        layers.recurrent.multiply(recurrentGates.data(), hidden.data());
+
+        gates.noalias() = layers.kernel * Eigen::Map<const Vector>(input, layers.inputSize);
+        gates += layers.bias;
+
+        stepRecurrentLayer<lstm, Eigen::Dynamic>(gates, recurrentGates, hidden, cell,
+                                                 layers.recurrentBias, layers.hiddenSize);
+
+        return layers.dense.dot(hidden) + layers.denseBias;
+    }
+
+private:
+    DISTRHO_DECLARE_NON_COPYABLE(QuantizedRecurrentState)
+};
+
+template <bool lstm, typename WeightType>
+class QuantizedRecurrentModel : public DynamicModel
+{
+    using Layers = QuantizedRecurrentLayers<lstm, WeightType>;
+    using State = QuantizedRecurrentState<lstm, WeightType>;
+
+    // shared with every model of the same precision loaded from the same weights
+    const std::shared_ptr<const Layers> layers;
+    State state;
+    // same layers, for the right channel in stereo mode
+    std::unique_ptr<State> rightState;
+    const bool input_skip;
+    const float input_gain;
+    const float output_gain;
+
+public:
+    QuantizedRecurrentModel(const SharedModelWeights& weights, const ModelKernelInfo& info)
+        : layers(weights.getLayers<Layers>()),
+          state(*layers),
+          rightState(info.stereo ? new State(*layers) : nullptr),
+          input_skip(info.input_skip),
+          input_gain(info.input_gain),
+          output_gain(info.output_gain)
+    {
+        precision = info.precision;
+        settled_reset = layers->settled;
+    }
+
+    void process(float* const out, const uint32_t numSamples,
+                 LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        switch (layers->inputSize)
+        {
+        case 1:
+            processModel<1>(state, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 2:
+            processModel<2>(state, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 3:
+            processModel<3>(state, out, numSamples, input_skip, input_gain, output_gain, param1, param2);
+            break;
+        }
+    }
+
+    void processStereo(float* const left, float* const right, const uint32_t numSamples,
+                       LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        if (rightState == nullptr)
+        {
+            process(left, numSamples, param1, param2);
+            std::memcpy(right, left, sizeof(float) * numSamples);
+            return;
+        }
+
+        switch (layers->inputSize)
+        {
+        case 1:
+            processModelStereo<1>(state, *rightState, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 2:
+            processModelStereo<2>(state, *rightState, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        case 3:
+            processModelStereo<3>(state, *rightState, left, right, numSamples,
+                                  input_skip, input_gain, output_gain, param1, param2);
+            break;
+        }
+    }
+
+    void reset() override
+    {
+        state.reset();
+
+        if (rightState != nullptr)
+            rightState->reset();
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(QuantizedRecurrentModel)
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// Block inference for the fixed-size architectures, used instead of the RTNeural models with the Eigen backend.
+//
+// RTNeural steps a model one sample at a time, computing the input kernel product of each sample next to the
+// recurrent one. Here the input products of a whole chunk of samples, biases included, are done upfront as a single
+// matrix product (a rank-1 outer product for models without conditioning inputs), leaving only the recurrent product
+// and gate activations in the per-sample loop. Hidden states are collected over the chunk and go through the dense
+// layer together once it is done. The gate step is stepRecurrentLayer(), with all weights in float.
+// While the conditioning parameters of a model are not moving, their part of the input products is constant and gets
+// folded into the bias once, so the chunk products are done for the audio input alone.
+
+#if RTNEURAL_USE_EIGEN
+/* Number of samples processed at once, sized so the per-chunk input products stay in cache for the biggest models */
+static constexpr const int kBlockModelFrames = 32;
+
+/* Immutable weights built once per SharedModelWeights, shared by every recurrent state using them */
+template <bool lstm, int inputSize, int hiddenSize>
+struct BlockRecurrentLayers
+{
+    static constexpr const int kNumGates = lstm ? 4 : 3;
+    static constexpr const int kGatesSize = hiddenSize * kNumGates;
+
+    Eigen::Matrix<float, kGatesSize, inputSize> kernel;
+    Eigen::Matrix<float, kGatesSize, hiddenSize> recurrent;
+    Eigen::Matrix<float, 1, hiddenSize> dense;
+    Eigen::Matrix<float, kGatesSize, 1> bias;           /* GRU adds the recurrent bias of update and reset gates here */
+    Eigen::Matrix<float, hiddenSize, 1> recurrentBias;  /* recurrent bias of the GRU candidate gate */
+    float denseBias;
+    Eigen::Matrix<float, hiddenSize, 1> initialHidden;  /* state set by reset() */
+    Eigen::Matrix<float, hiddenSize, 1> initialCell;    /* LSTM only */
+    const bool settled;                                 /* initial state taken from the model, instead of zeros */
+
+    explicit BlockRecurrentLayers(const BinaryModel& model)
+        // keras stores kernels as input x gates in row-major order, the same as gates x input in column-major
+        : kernel(Eigen::Map<const Eigen::Matrix<float, kGatesSize, inputSize>>(model.arrays[kBinaryModelRnnKernel])),
+          recurrent(Eigen::Map<const Eigen::Matrix<float, kGatesSize, hiddenSize>>(model.arrays[kBinaryModelRnnRecurrent])),
+          dense(Eigen::Map<const Eigen::Matrix<float, 1, hiddenSize>>(model.arrays[kBinaryModelDenseKernel])),
+          bias(Eigen::Map<const Eigen::Matrix<float, kGatesSize, 1>>(model.arrays[kBinaryModelRnnBias])),
+          recurrentBias(Eigen::Matrix<float, hiddenSize, 1>::Zero()),
+          denseBias(model.arrays[kBinaryModelDenseBias][0]),
+          initialHidden(Eigen::Matrix<float, hiddenSize, 1>::Zero()),
+          initialCell(Eigen::Matrix<float, hiddenSize, 1>::Zero()),
+          settled(getBinaryModelInitialState(model) != nullptr)
+    {
+        if constexpr (! lstm)
+        {
+            const float* const recurrentBiasValues = model.arrays[kBinaryModelRnnBias] + kGatesSize;
+
+            bias.template head<hiddenSize * 2>() += Eigen::Map<const Eigen::Matrix<float, hiddenSize * 2, 1>>(recurrentBiasValues);
+            recurrentBias = Eigen::Map<const Eigen::Matrix<float, hiddenSize, 1>>(recurrentBiasValues + hiddenSize * 2);
+        }
+
+        if (const float* const initialState = getBinaryModelInitialState(model))
+        {
+            initialHidden = Eigen::Map<const Eigen::Matrix<float, hiddenSize, 1>>(initialState);
+
+            if constexpr (lstm)
+                initialCell = Eigen::Map<const Eigen::Matrix<float, hiddenSize, 1>>(initialState + hiddenSize);
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(BlockRecurrentLayers)
+};
+
+/**
+   Recurrent state of one channel, or of both channels in stereo mode, plus the products of the chunk being processed.
+   Each channel is a column of the state matrices, so both channels step as a single product against the same weights.
+   Chunk matrices have a column per frame and channel, with the channels of a frame next to each other.
+ */
+template <bool lstm, int inputSize, int hiddenSize, int channels>
+class BlockRecurrentState
+{
+    using Layers = BlockRecurrentLayers<lstm, inputSize, hiddenSize>;
+    static constexpr const int kGatesSize = Layers::kGatesSize;
+    static constexpr const int kColumns = kBlockModelFrames * channels;
+
+    const Layers& layers;
+    Eigen::Matrix<float, hiddenSize, channels> hidden;
+    Eigen::Matrix<float, hiddenSize, channels> cell;           /* LSTM only */
+    Eigen::Matrix<float, kGatesSize, channels> recurrentGates;
+    Eigen::Matrix<float, kGatesSize, kColumns> inputGates;
+    Eigen::Matrix<float, hiddenSize, kColumns> hiddenStates;
+
+public:
+    static constexpr const int kChannels = channels;
+
+    Eigen::Matrix<float, inputSize, kColumns> inputs;
+    Eigen::Matrix<float, 1, kColumns> outputs;
+
+    explicit BlockRecurrentState(const Layers& layers_)
+        : layers(layers_),
+          inputs(Eigen::Matrix<float, inputSize, kColumns>::Zero())
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        hidden = layers.initialHidden.template replicate<1, channels>();
+        cell = layers.initialCell.template replicate<1, channels>();
+    }
+
+    /* Input kernel products for the first @a numFrames frames of inputs */
+    void project(const int numFrames) noexcept
+    {
+        const int numColumns = numFrames * channels;
+
+        inputGates.leftCols(numColumns).noalias() = layers.kernel * inputs.leftCols(numColumns);
+        inputGates.leftCols(numColumns).colwise() += layers.bias;
+    }
+
+    /* Same as project() using only the audio input, for conditioning inputs already folded into @a foldedBias */
+    void projectFolded(const int numFrames, const Eigen::Matrix<float, kGatesSize, 1>& foldedBias) noexcept
+    {
+        const int numColumns = numFrames * channels;
+
+        inputGates.leftCols(numColumns).noalias() = layers.kernel.col(0) * inputs.row(0).leftCols(numColumns);
+        inputGates.leftCols(numColumns).colwise() += foldedBias;
+    }
+
+    /* Recurrent step for one frame of the chunk, after project() */
+    void step(const int frame) noexcept
+    {
+        // recurrent * [hL hR] as one matrix-vector product per column, a single product with 2 columns goes through
+        // the general matrix product, which repacks the weights on every call
+        for (int c = 0; c < channels; ++c)
+            recurrentGates.col(c).noalias() = layers.recurrent * hidden.col(c);
+
+        stepRecurrentLayer<lstm, hiddenSize>(inputGates.template middleCols<channels>(frame * channels),
+                                             recurrentGates, hidden, cell, layers.recurrentBias, hiddenSize);
+
+        hiddenStates.template middleCols<channels>(frame * channels) = hidden;
+    }
+
+    /* Dense layer over the first @a numFrames frames of hidden states of the chunk, into outputs */
+    void output(const int numFrames) noexcept
+    {
+        const int numColumns = numFrames * channels;
+
+        outputs.leftCols(numColumns).noalias() = layers.dense * hiddenStates.leftCols(numColumns);
+        outputs.leftCols(numColumns).array() += layers.denseBias;
+    }
+
+private:
+    DISTRHO_DECLARE_NON_COPYABLE(BlockRecurrentState)
+};
+
+template <bool lstm, int inputSize, int hiddenSize>
+class BlockRecurrentModel : public DynamicModel
+{
+    using Layers = BlockRecurrentLayers<lstm, inputSize, hiddenSize>;
+    using State = BlockRecurrentState<lstm, inputSize, hiddenSize, 1>;
+    using StereoState = BlockRecurrentState<lstm, inputSize, hiddenSize, 2>;
+
+    // shared with every full precision model loaded from the same weights
+    const std::shared_ptr<const Layers> layers;
+    State state;
+    // both channels over the same layers, in stereo mode
+    std::unique_ptr<StereoState> stereoState;
+    const bool input_skip;
+    const float input_gain;
+    const float output_gain;
+
+    // input bias plus the conditioning inputs contribution, for the parameter values it was last computed with
+    Eigen::Matrix<float, Layers::kGatesSize, 1> foldedBias;
+    float foldedParams[2] = {};
+    bool foldedBiasValid = false;
+
+public:
+    BlockRecurrentModel(const SharedModelWeights& weights, const ModelKernelInfo& info)
+        : layers(weights.getLayers<Layers>()),
+          state(*layers),
+          stereoState(info.stereo ? new StereoState(*layers) : nullptr),
+          input_skip(info.input_skip),
+          input_gain(info.input_gain),
+          output_gain(info.output_gain)
+    {
+        precision = kModelPrecisionFloat;
+        settled_reset = layers->settled;
+    }
+
+    void process(float* const out, const uint32_t numSamples,
+                 LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        const bool folded = foldConditioning(param1, param2);
+
+        for (uint32_t offset = 0; offset < numSamples; offset += kBlockModelFrames)
+        {
+            const int numFrames = static_cast<int>(std::min<uint32_t>(kBlockModelFrames, numSamples - offset));
+
+            setInputs(state, out + offset, numFrames);
+
+            if (folded)
+            {
+                state.projectFolded(numFrames, foldedBias);
+            }
+            else
+            {
+                setConditioning(state, numFrames, param1, param2);
+                state.project(numFrames);
+            }
+
+            for (int i = 0; i < numFrames; ++i)
+                state.step(i);
+
+            state.output(numFrames);
+            getOutputs(state, out + offset, numFrames);
+        }
+    }
+
+    void processStereo(float* const left, float* const right, const uint32_t numSamples,
+                       LinearValueSmoother& param1, LinearValueSmoother& param2) override
+    {
+        if (stereoState == nullptr)
+        {
+            process(left, numSamples, param1, param2);
+            std::memcpy(right, left, sizeof(float) * numSamples);
+            return;
+        }
+
+        StereoState& stereoState = *this->stereoState;
+        const bool folded = foldConditioning(param1, param2);
+
+        for (uint32_t offset = 0; offset < numSamples; offset += kBlockModelFrames)
+        {
+            const int numFrames = static_cast<int>(std::min<uint32_t>(kBlockModelFrames, numSamples - offset));
+
+            setInputs(stereoState, left + offset, numFrames, 0);
+            setInputs(stereoState, right + offset, numFrames, 1);
+
+            if (folded)
+            {
+                stereoState.projectFolded(numFrames, foldedBias);
+            }
+            else
+            {
+                setConditioning(stereoState, numFrames, param1, param2);
+                stereoState.project(numFrames);
+            }
+
+            for (int i = 0; i < numFrames; ++i)
+                stereoState.step(i);
+
+            stereoState.output(numFrames);
+
+            getOutputs(stereoState, left + offset, numFrames, 0);
+            getOutputs(stereoState, right + offset, numFrames, 1);
+        }
+    }
+
+    void reset() override
+    {
+        state.reset();
+
+        if (stereoState != nullptr)
+            stereoState->reset();
+    }
+
+private:
+   /**
+      Check if the conditioning parameters stay the same over the next block, updating foldedBias for their values.
+      Parameters only change through the smoothers, so a smoother at its target will not move until the next block.
+    */
+    bool foldConditioning(const LinearValueSmoother& param1, const LinearValueSmoother& param2) noexcept
+    {
+        if constexpr (inputSize == 1)
+        {
+            return false;
+        }
+        else
+        {
+            Eigen::Matrix<float, inputSize - 1, 1> params;
+
+            params(0) = param1.getCurrentValue();
+
+            if (d_isNotEqual(params(0), param1.getTargetValue()))
+                return false;
+
+            if constexpr (inputSize >= 3)
+            {
+                params(1) = param2.getCurrentValue();
+
+                if (d_isNotEqual(params(1), param2.getTargetValue()))
+                    return false;
+            }
+
+            bool changed = ! foldedBiasValid;
+
+            for (int i = 0; i < inputSize - 1; ++i)
+            {
+                if (d_isNotEqual(foldedParams[i], params(i)))
+                {
+                    foldedParams[i] = params(i);
+                    changed = true;
+                }
+            }
+
+            if (changed)
+            {
+                foldedBias.noalias() = layers->kernel.template rightCols<inputSize - 1>() * params;
+                foldedBias += layers->bias;
+                foldedBiasValid = true;
+            }
+
+            return true;
+        }
+    }
+
+    template <typename S>
+    void setInputs(S& s, const float* const in, const int numFrames, const int channel = 0) const noexcept
+    {
+        for (int i = 0; i < numFrames; ++i)
+            s.inputs(0, i * S::kChannels + channel) = in[i] * input_gain;
+    }
+
+    /* Conditioning parameters are the same for all channels */
+    template <typename S>
+    static void setConditioning(S& s, const int numFrames,
+                                LinearValueSmoother& param1, LinearValueSmoother& param2) noexcept
+    {
+        if constexpr (inputSize >= 2)
+        {
+            for (int i = 0; i < numFrames; ++i)
+                s.inputs.row(1).template segment<S::kChannels>(i * S::kChannels).setConstant(param1.next());
+        }
+
+        if constexpr (inputSize >= 3)
+        {
+            for (int i = 0; i < numFrames; ++i)
+                s.inputs.row(2).template segment<S::kChannels>(i * S::kChannels).setConstant(param2.next());
+        }
+    }
+
+    template <typename S>
+    void getOutputs(const S& s, float* const out, const int numFrames, const int channel = 0) const noexcept
+    {
+        if (input_skip)
+        {
+            for (int i = 0; i < numFrames; ++i)
+                out[i] = (s.inputs(0, i * S::kChannels + channel) + s.outputs(i * S::kChannels + channel))
+                       * output_gain;
+        }
+        else
+        {
+            for (int i = 0; i < numFrames; ++i)
+                out[i] = s.outputs(i * S::kChannels + channel) * output_gain;
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(BlockRecurrentModel)
+};
+
+using BlockModelCreator = DynamicModel* (*)(const SharedModelWeights&, const ModelKernelInfo&);
+
+template <size_t Index>
+static DynamicModel* createBlockModel(const SharedModelWeights& weights, const ModelKernelInfo& info)
+{
+    using ModelType = std::variant_alternative_t<Index, ModelVariantType>;
+
+    if constexpr (std::is_same_v<ModelType, NullModel>)
+    {
+        return nullptr;
+    }
+    else
+    {
+        constexpr const ModelArchitecture arch = getModelArchitecture<ModelType>();
+        return new BlockRecurrentModel<arch.lstm, arch.input_size, arch.hidden_size>(weights, info);
+    }
+}
+
+template <size_t... Is>
+static constexpr std::array<BlockModelCreator, sizeof...(Is)> createBlockModelCreators(std::index_sequence<Is...>)
+{
+    return {{ &createBlockModel<Is>... }};
+}
+
+/* Block model constructors, in the same order as ModelVariantType */
+static constexpr const std::array<BlockModelCreator, std::variant_size_v<ModelVariantType>> kBlockModelCreators
+    = createBlockModelCreators(std::make_index_sequence<std::variant_size_v<ModelVariantType>>());
+
+/* Block inference can be turned off with AIDAX_MODEL_BLOCK_INFERENCE=0, to compare against the RTNeural models */
+static bool useBlockModels() noexcept
+{
+    static const bool enabled = [] {
+        const char* const forced = std::getenv("AIDAX_MODEL_BLOCK_INFERENCE");
+        return forced == nullptr || std::atoi(forced) != 0;
+    }();
+
+    return enabled;
+}
+#endif
+
+/* Returns null if reduced precision is not available, so the model is created in full precision instead */
+static DynamicModel* createQuantizedModel(const SharedModelWeights& weights, const ModelKernelInfo& info)
+{
+   #if RTNEURAL_USE_EIGEN
+    const BinaryModel& model = weights.getModel();
+
+    if (model.header->inputSize < 1 || model.header->inputSize > MAX_INPUT_SIZE)
+        return nullptr;
+
+    try {
+        const bool lstm = model.header->layerType == kBinaryModelLayerLSTM;
+
+        if (info.precision == kModelPrecisionInt8)
+        {
+            if (lstm)
+                return new QuantizedRecurrentModel<true, int8_t>(weights, info);
+
+            return new QuantizedRecurrentModel<false, int8_t>(weights, info);
+        }
+
+        if (lstm)
+            return new QuantizedRecurrentModel<true, uint16_t>(weights, info);
+
+        return new QuantizedRecurrentModel<false, uint16_t>(weights, info);
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading reduced precision model: %s", e.what());
+        return nullptr;
+    }
+   #else
+    // unused
+    (void)weights;
+    (void)info;
+
+    d_stdout("Reduced precision models need RTNeural with the Eigen backend, using full precision");
+    return nullptr;
+   #endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Create a model from shared binary weights, returns null on error
+
+DynamicModel* createDynamicModel(const SharedModelWeights& weights, const ModelKernelInfo& info)
+{
+    const BinaryModel& model = weights.getModel();
+
+    if (info.precision != kModelPrecisionFloat)
+    {
+        if (DynamicModel* const newmodel = createQuantizedModel(weights, info))
+            return newmodel;
+    }
+
+    std::unique_ptr<VariantModel> newmodel = std::make_unique<VariantModel>();
+
+    try {
+        const ModelArchitecture arch = {
+            model.header->layerType == kBinaryModelLayerLSTM,
+            static_cast<int>(model.header->hiddenSize),
+            static_cast<int>(model.header->inputSize),
+        };
+
+        if (! createModelVariant (arch, newmodel->variant))
+            return createFallbackModel (model, info);
+
+       #if RTNEURAL_USE_EIGEN
+        // RTNeural models keep their own copy of the weights per channel, block models step both over one copy
+        if (useBlockModels() || info.stereo)
+            return kBlockModelCreators[newmodel->variant.index()](weights, info);
+       #endif
+
+        const auto loadWeights = [&model] (auto&& custom_model)
+        {
+            using ModelType = std::decay_t<decltype (custom_model)>;
+            if constexpr (! std::is_same_v<ModelType, NullModel>)
+            {
+                setBinaryModelWeights (custom_model, model);
+                custom_model.reset();
+            }
+        };
+
+        std::visit (loadWeights, newmodel->variant);
+
+        if (info.stereo)
+        {
+            newmodel->rightVariant = createRightVariant (newmodel->variant);
+            std::visit (loadWeights, *newmodel->rightVariant);
+        }
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading model: %s", e.what());
+        return nullptr;
+    }
+
+    // save extra info
+    newmodel->input_skip = info.input_skip;
+    newmodel->input_gain = info.input_gain;
+    newmodel->output_gain = info.output_gain;
+
+    return newmodel.release();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Batched models, advancing many streams of the same model one sample at a time.
+//
+// States are stored with one column per stream slot, so the matrix-vector products of a single stream become
+// matrix-matrix products over all of them, done by Eigen with every weight loaded once for all streams.
+// Added streams always use the first slots, removing one moves the last stream into its slot.
+// Weights are not copied, the binary model data must outlive the batched model.
+
+#if RTNEURAL_USE_EIGEN
+template <bool lstm>
+class BatchedRecurrentModel : public BatchedModel
+{
+    using Matrix = Eigen::MatrixXf;
+    using Vector = Eigen::VectorXf;
+
+    static constexpr const int kNumGates = lstm ? 4 : 3;
+
+    const int inputSize;
+    const int hiddenSize;
+    const int maxStreams;
+    const bool input_skip;
+    const float input_gain;
+    const float output_gain;
+
+    // weights in keras order, one row per gate value, used in place from the shared binary model data
+    Eigen::Map<const Matrix> kernel;               /* gates x inputSize */
+    Eigen::Map<const Matrix> recurrent;            /* gates x hiddenSize */
+    Eigen::Map<const Eigen::RowVectorXf> dense;    /* hiddenSize */
+    Vector bias;            /* gates, GRU adds the recurrent bias of update and reset gates here */
+    Vector recurrentBias;   /* hiddenSize, recurrent bias of the GRU candidate gate */
+    float denseBias;
+    Vector initialHidden;   /* hiddenSize, state of added and reset streams */
+    Vector initialCell;     /* hiddenSize, LSTM only */
+
+    // per slot state, one column per slot
+    Matrix hidden;          /* hiddenSize x maxStreams */
+    Matrix cell;            /* hiddenSize x maxStreams, LSTM only */
+    Matrix inputs;          /* inputSize x maxStreams, conditioning rows keep their current values */
+    Matrix paramTargets;    /* 2 x maxStreams */
+    Matrix gates;           /* gates x maxStreams */
+    Matrix recurrentGates;  /* gates x maxStreams */
+    Eigen::RowVectorXf outputs;
+
+    std::vector<int> slotStreams;
+    std::vector<int> streamSlots;
+    // per slot, set after add and reset so the next conditioning values are jumped to instead of ramped
+    std::vector<uint8_t> snapParams;
+    int numStreams = 0;
+
+public:
+    BatchedRecurrentModel(const BinaryModel& model, const ModelKernelInfo& info, const uint32_t maxStreams_)
+        : inputSize(static_cast<int>(model.header->inputSize)),
+          hiddenSize(static_cast<int>(model.header->hiddenSize)),
+          maxStreams(static_cast<int>(maxStreams_)),
+          input_skip(info.input_skip),
+          input_gain(info.input_gain),
+          output_gain(info.output_gain),
+          // keras stores kernels as input x gates in row-major order, the same as gates x input in column-major
+          kernel(model.arrays[kBinaryModelRnnKernel], hiddenSize * kNumGates, inputSize),
+          recurrent(model.arrays[kBinaryModelRnnRecurrent], hiddenSize * kNumGates, hiddenSize),
+          dense(model.arrays[kBinaryModelDenseKernel], hiddenSize),
+          bias(Eigen::Map<const Vector>(model.arrays[kBinaryModelRnnBias], hiddenSize * kNumGates)),
+          recurrentBias(Vector::Zero(hiddenSize)),
+          denseBias(model.arrays[kBinaryModelDenseBias][0]),
+          initialHidden(Vector::Zero(hiddenSize)),
+          initialCell(Vector::Zero(lstm ? hiddenSize : 0)),
+          hidden(Matrix::Zero(hiddenSize, maxStreams)),
+          cell(Matrix::Zero(lstm ? hiddenSize : 0, maxStreams)),
+          inputs(Matrix::Zero(inputSize, maxStreams)),
+          paramTargets(Matrix::Zero(2, maxStreams)),
+          gates(hiddenSize * kNumGates, maxStreams),
+          recurrentGates(hiddenSize * kNumGates, maxStreams),
+          outputs(maxStreams),
+          slotStreams(maxStreams_, -1),
+          streamSlots(maxStreams_, -1),
+          snapParams(maxStreams_, 0)
+    {
+        input_size = inputSize;
+
+        // GRU has a second bias for the recurrent products, which only stays apart for the candidate gate
+        if constexpr (! lstm)
+        {
+            const float* const recurrentBiasValues = model.arrays[kBinaryModelRnnBias] + hiddenSize * kNumGates;
+
+            bias.head(hiddenSize * 2) += Eigen::Map<const Vector>(recurrentBiasValues, hiddenSize * 2);
+            recurrentBias = Eigen::Map<const Vector>(recurrentBiasValues + hiddenSize * 2, hiddenSize);
+        }
+
+        if (const float* const initialState = getBinaryModelInitialState(model))
+        {
+            initialHidden = Eigen::Map<const Vector>(initialState, hiddenSize);
+
+            if constexpr (lstm)
+                initialCell = Eigen::Map<const Vector>(initialState + hiddenSize, hiddenSize);
+        }
+    }
+
+    int addStream() override
+    {
+        if (numStreams == maxStreams)
+            return -1;
+
+        int stream = 0;
+        while (streamSlots[stream] != -1)
+            ++stream;
+
+        const int slot = numStreams++;
+        slotStreams[slot] = stream;
+        streamSlots[stream] = slot;
+
+        hidden.col(slot) = initialHidden;
+        inputs.col(slot).setZero();
+        paramTargets.col(slot).setZero();
+        snapParams[slot] = 1;
+
+        if constexpr (lstm)
+            cell.col(slot) = initialCell;
+
+        return stream;
+    }
+
+    void removeStream(const int stream) override
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(stream >= 0 && stream < maxStreams,);
+        DISTRHO_SAFE_ASSERT_RETURN(streamSlots[stream] != -1,);
+
+        const int slot = streamSlots[stream];
+        const int last = --numStreams;
+
+        if (slot != last)
+        {
+            hidden.col(slot) = hidden.col(last);
+            inputs.col(slot) = inputs.col(last);
+            paramTargets.col(slot) = paramTargets.col(last);
+            snapParams[slot] = snapParams[last];
+
+            if constexpr (lstm)
+                cell.col(slot) = cell.col(last);
+
+            slotStreams[slot] = slotStreams[last];
+            streamSlots[slotStreams[slot]] = slot;
+        }
+
+        slotStreams[last] = -1;
+        streamSlots[stream] = -1;
+    }
+
+    void resetStream(const int stream) override
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(stream >= 0 && stream < maxStreams,);
+        DISTRHO_SAFE_ASSERT_RETURN(streamSlots[stream] != -1,);
+
+        hidden.col(streamSlots[stream]) = initialHidden;
+        snapParams[streamSlots[stream]] = 1;
+
+        if constexpr (lstm)
+            cell.col(streamSlots[stream]) = initialCell;
+    }
+
+    void setStreamParameters(const int stream, const float param1, const float param2) override
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(stream >= 0 && stream < maxStreams,);
+        DISTRHO_SAFE_ASSERT_RETURN(streamSlots[stream] != -1,);
+
+        const int slot = streamSlots[stream];
+
+        paramTargets(0, slot) = param1;
+        paramTargets(1, slot) = param2;
+
+        // same as the plugin on its first run, a new or reset stream starts right at its values
+        if (snapParams[slot] != 0)
+        {
+            snapParams[slot] = 0;
+
+            if (const int numParams = std::min(inputSize - 1, 2))
+                inputs.block(1, slot, numParams, 1) = paramTargets.block(0, slot, numParams, 1);
+        }
+    }
+
+    void process(float* const* const buffers, const uint32_t numSamples) override
+    {
+        const int count = numStreams;
+
+        if (count == 0 || numSamples == 0)
+            return;
+
+        const int numParams = std::min(inputSize - 1, 2);
+
+        for (uint32_t i = 0; i < numSamples; ++i)
+        {
+            for (int s = 0; s < count; ++s)
+                inputs(0, s) = buffers[slotStreams[s]][i] * input_gain;
+
+            // conditioning values ramp linearly over the block
+            if (numParams != 0)
+            {
+                auto params = inputs.block(1, 0, numParams, count);
+                params += (paramTargets.topLeftCorner(numParams, count) - params) / static_cast<float>(numSamples - i);
+            }
+
+            step(count);
+
+            for (int s = 0; s < count; ++s)
+            {
+                float& out = buffers[slotStreams[s]][i];
+
+                // first row of the inputs is the gained input sample
+                if (input_skip)
+                    out = (inputs(0, s) + outputs(s)) * output_gain;
+                else
+                    out = outputs(s) * output_gain;
+            }
+        }
+    }
+
+    uint32_t getNumStreams() const noexcept override
+    {
+        return static_cast<uint32_t>(numStreams);
+    }
+
+    uint32_t getMaxStreams() const noexcept override
+    {
+        return static_cast<uint32_t>(maxStreams);
+    }
+
+private:
+    /* One time step for the first @a count slots */
+    void step(const int count)
+    {
+        auto h = hidden.leftCols(count);
+        auto g = gates.leftCols(count);
+        auto r = recurrentGates.leftCols(count);
+
+        g.noalias() = kernel * inputs.leftCols(count);
+        g.colwise() += bias;
+        r.noalias() = recurrent * h;
+
+        // GRU has no cell, the empty matrix is never touched
+        stepRecurrentLayer<lstm, Eigen::Dynamic>(g, r, h, cell.leftCols(count), recurrentBias, hiddenSize);
+
+        outputs.head(count).noalias() = dense * h;
+        outputs.head(count).array() += denseBias;
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE(BatchedRecurrentModel)
+};
+#endif
+
+BatchedModel* createBatchedModel(const BinaryModel& model, const ModelKernelInfo& info, const uint32_t maxStreams)
+{
+    DISTRHO_SAFE_ASSERT_RETURN(maxStreams != 0, nullptr);
+
+   #if RTNEURAL_USE_EIGEN
+    try {
+        if (model.header->layerType == kBinaryModelLayerLSTM)
+            return new BatchedRecurrentModel<true>(model, info, maxStreams);
+
+        return new BatchedRecurrentModel<false>(model, info, maxStreams);
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Error loading batched model: %s", e.what());
+        return nullptr;
+    }
+   #else
+    // unused
+    (void)model;
+    (void)info;
+
+    d_stderr2("Batched models need RTNeural with the Eigen backend");
+    return nullptr;
+   #endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+}
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,48 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "AidaDSP.hpp"
+
+#include <RTNeural/RTNeural.h>
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+// Model kernels, the same inference code built for different instruction sets (see model_kernel.cpp)
+// The loader picks the best one for the running CPU, see model_loader.cpp
+
+struct BinaryModel;
+class SharedModelWeights;
+
+struct ModelKernelInfo {
+    bool input_skip;
+    float input_gain;
+    float output_gain;
+    ModelPrecision precision;
+    uint32_t sample_rate; /* sample rate the model was trained at, 0 if unknown */
+    bool stereo; /* create a second recurrent state for processStereo(), not stored in binary models */
+};
+
+#define AIDAX_DECLARE_MODEL_KERNEL(kernel)                                                                            \
+    namespace kernel {                                                                                                \
+        DynamicModel* createDynamicModel(const nlohmann::json& model_json, const ModelKernelInfo& info);              \
+        DynamicModel* createDynamicModel(const SharedModelWeights& weights, const ModelKernelInfo& info);             \
+        BatchedModel* createBatchedModel(const BinaryModel& model, const ModelKernelInfo& info, uint32_t maxStreams); \
+    }
+
+AIDAX_DECLARE_MODEL_KERNEL(generic)
+AIDAX_DECLARE_MODEL_KERNEL(avx2)
+AIDAX_DECLARE_MODEL_KERNEL(avx512)
+AIDAX_DECLARE_MODEL_KERNEL(neon)
+
+#undef AIDAX_DECLARE_MODEL_KERNEL
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
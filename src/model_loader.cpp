@@ -0,0 +1,486 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "model_binary.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if AIDAX_MODEL_KERNEL_NEON
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Max input size supported by the model kernels, see model_variant.hpp */
+static constexpr const int kMaxModelInputSize = 3;
+
+struct ModelKernel {
+    const char* name;
+    DynamicModel* (*createDynamicModel)(const nlohmann::json& model_json, const ModelKernelInfo& info);
+    DynamicModel* (*createDynamicModelFromBinary)(const SharedModelWeights& weights, const ModelKernelInfo& info);
+    BatchedModel* (*createBatchedModel)(const BinaryModel& model, const ModelKernelInfo& info, uint32_t maxStreams);
+};
+
+static const ModelKernel kModelKernels[] = {
+   #if AIDAX_MODEL_KERNEL_AVX512
+    { "avx512", avx512::createDynamicModel, avx512::createDynamicModel, avx512::createBatchedModel },
+   #endif
+   #if AIDAX_MODEL_KERNEL_AVX2
+    { "avx2", avx2::createDynamicModel, avx2::createDynamicModel, avx2::createBatchedModel },
+   #endif
+   #if AIDAX_MODEL_KERNEL_NEON
+    { "neon", neon::createDynamicModel, neon::createDynamicModel, neon::createBatchedModel },
+   #endif
+    { "generic", generic::createDynamicModel, generic::createDynamicModel, generic::createBatchedModel },
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Check if the running CPU can use a model kernel
+
+static bool isModelKernelSupported(const ModelKernel& kernel)
+{
+   #if AIDAX_MODEL_KERNEL_AVX2 || AIDAX_MODEL_KERNEL_AVX512
+    __builtin_cpu_init();
+   #endif
+
+   #if AIDAX_MODEL_KERNEL_AVX512
+    if (std::strcmp(kernel.name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+            && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+   #endif
+   #if AIDAX_MODEL_KERNEL_AVX2
+    if (std::strcmp(kernel.name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+   #endif
+   #if AIDAX_MODEL_KERNEL_NEON
+    if (std::strcmp(kernel.name, "neon") == 0)
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+   #endif
+
+    return std::strcmp(kernel.name, "generic") == 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Pick the best model kernel for the running CPU, AIDAX_MODEL_KERNEL env var can be used to force a specific one
+
+static const ModelKernel& selectModelKernel()
+{
+    constexpr const size_t numKernels = sizeof(kModelKernels) / sizeof(kModelKernels[0]);
+
+    if (const char* const forced = std::getenv("AIDAX_MODEL_KERNEL"))
+    {
+        for (size_t i = 0; i < numKernels; ++i)
+        {
+            if (std::strcmp(kModelKernels[i].name, forced) != 0)
+                continue;
+
+            if (isModelKernelSupported(kModelKernels[i]))
+                return kModelKernels[i];
+
+            d_stderr2("Model kernel '%s' is not supported by this CPU, ignoring AIDAX_MODEL_KERNEL", forced);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < numKernels; ++i)
+    {
+        if (isModelKernelSupported(kModelKernels[i]))
+            return kModelKernels[i];
+    }
+
+    // generic kernel, always last
+    return kModelKernels[numKernels - 1];
+}
+
+static const ModelKernel& getModelKernel()
+{
+    static const ModelKernel& kernel = selectModelKernel();
+    return kernel;
+}
+
+const char* getModelKernelName()
+{
+    return getModelKernel().name;
+}
+
+size_t getModelWeightsSize(const DynamicModel* const model) noexcept
+{
+    return model->weights != nullptr ? model->weights->getSize() : 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static constexpr const char* const kModelPrecisionNames[] = { "float", "bf16", "int8" };
+
+const char* getModelPrecisionName(const ModelPrecision precision) noexcept
+{
+    DISTRHO_SAFE_ASSERT_RETURN(precision >= kModelPrecisionFloat && precision <= kModelPrecisionInt8, "default");
+
+    return kModelPrecisionNames[precision];
+}
+
+bool parseModelPrecision(const char* const name, ModelPrecision& precision) noexcept
+{
+    for (int i = kModelPrecisionFloat; i <= kModelPrecisionInt8; ++i)
+    {
+        if (::strcasecmp(name, kModelPrecisionNames[i]) == 0)
+        {
+            precision = static_cast<ModelPrecision>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Parse a json model, returns false on error
+
+static bool parseModelJson(std::istream& jsonStream, nlohmann::json& model_json, int& input_size, ModelKernelInfo& info)
+{
+    int input_skip;
+    float input_gain;
+    float output_gain;
+    ModelPrecision precision = kModelPrecisionFloat;
+    uint32_t sample_rate = 0;
+
+    try {
+        jsonStream >> model_json;
+
+        /* Understand which model type to load */
+        input_size = model_json["in_shape"].back().get<int>();
+        if (input_size > kMaxModelInputSize) {
+            throw std::invalid_argument("Value for input_size not supported");
+        }
+
+        if (model_json["in_skip"].is_number()) {
+            input_skip = model_json["in_skip"].get<int>();
+            if (input_skip > 1)
+                throw std::invalid_argument("Values for in_skip > 1 are not supported");
+        }
+        else {
+            input_skip = 0;
+        }
+
+        if (model_json["in_gain"].is_number()) {
+            input_gain = DB_CO(model_json["in_gain"].get<float>());
+        }
+        else {
+            input_gain = 1.0f;
+        }
+
+        if (model_json["out_gain"].is_number()) {
+            output_gain = DB_CO(model_json["out_gain"].get<float>());
+        }
+        else {
+            output_gain = 1.0f;
+        }
+
+        if (model_json["precision"].is_string()) {
+            if (! parseModelPrecision(model_json["precision"].get_ref<const std::string&>().c_str(), precision))
+                throw std::invalid_argument("Value for precision not supported");
+        }
+
+        // trainers may also store it along with other information about the model
+        const nlohmann::json* samplerate_json = &model_json["samplerate"];
+        if (! samplerate_json->is_number() && model_json["metadata"].is_object()) {
+            samplerate_json = &model_json["metadata"]["samplerate"];
+        }
+
+        if (samplerate_json->is_number()) {
+            const double samplerate = samplerate_json->get<double>();
+            if (samplerate < 8000.0 || samplerate > 768000.0)
+                throw std::invalid_argument("Value for samplerate not supported");
+            sample_rate = static_cast<uint32_t>(samplerate + 0.5);
+        }
+    }
+    catch (const std::exception& e) {
+        d_stderr2("Unable to load json, error: %s", e.what());
+        return false;
+    }
+
+    info = { input_skip != 0, input_gain, output_gain, precision, sample_rate, false };
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Create a DynamicModel from shared binary weights, returns null on error
+
+static DynamicModel* createDynamicModel(const std::shared_ptr<const SharedModelWeights>& weights,
+                                        int& input_size, const bool stereo, const ModelPrecision precision)
+{
+    const BinaryModel& binmodel = weights->getModel();
+
+    if (binmodel.header->inputSize > kMaxModelInputSize)
+    {
+        d_stderr2("Unable to load binary model, error: Value for input_size not supported");
+        return nullptr;
+    }
+
+    const ModelKernelInfo info = {
+        binmodel.header->inputSkip != 0,
+        binmodel.header->inputGain,
+        binmodel.header->outputGain,
+        precision != kModelPrecisionDefault ? precision : static_cast<ModelPrecision>(binmodel.header->precision),
+        binmodel.header->sampleRate,
+        stereo,
+    };
+
+    DynamicModel* const newmodel = getModelKernel().createDynamicModelFromBinary(*weights, info);
+
+    if (newmodel != nullptr)
+    {
+        newmodel->input_size = input_size = binmodel.header->inputSize;
+        newmodel->sample_rate = binmodel.header->sampleRate;
+        newmodel->weights = weights;
+    }
+
+    return newmodel;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Shared weights of a binary model file.
+// These keep the hash of the json they were converted from, so they share weights with loads of that json too.
+
+static std::shared_ptr<const SharedModelWeights> loadBinaryModelWeights(const char* const filename)
+{
+    std::unique_ptr<SharedModelWeights> weights(SharedModelWeights::fromFile(filename));
+
+    if (weights == nullptr)
+        return nullptr;
+
+    const uint64_t hash = weights->getModel().header->sourceHash;
+
+    if (hash == 0)
+        return std::shared_ptr<const SharedModelWeights>(weights.release());
+
+    // mapping is cheap, keep the weights other models already use and drop the new ones
+    if (std::shared_ptr<const SharedModelWeights> cached = findSharedModelWeights(hash))
+        return cached;
+
+    return addSharedModelWeights(hash, weights.release());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Shared weights of a json model, from the process-wide cache, the binary cache file or converting the json.
+// Returns null for layouts not supported by binary models, parsing the json into @a model_json in that case.
+
+static std::shared_ptr<const SharedModelWeights> loadJsonModelWeights(const std::string& contents,
+                                                                      nlohmann::json& model_json,
+                                                                      int& input_size, ModelKernelInfo& info,
+                                                                      bool& parsed)
+{
+    const uint64_t hash = hashModelData(contents.data(), contents.size());
+
+    if (std::shared_ptr<const SharedModelWeights> cached = findSharedModelWeights(hash))
+        return cached;
+
+    const String cacheFilename(getModelCacheFilename(hash));
+
+    if (cacheFilename.isNotEmpty())
+    {
+        if (SharedModelWeights* const weights = SharedModelWeights::fromFile(cacheFilename, hash))
+            return addSharedModelWeights(hash, weights);
+    }
+
+    std::istringstream jsonStream(contents);
+    parsed = parseModelJson(jsonStream, model_json, input_size, info);
+
+    if (! parsed)
+        return nullptr;
+
+    // unsupported layouts are simply not cached
+    std::vector<uint8_t> data;
+
+    if (! createBinaryModelData(model_json, info, hash, data))
+        return nullptr;
+
+    // store binary version for next time
+    if (cacheFilename.isNotEmpty())
+        writeBinaryModel(cacheFilename, data);
+
+    return addSharedModelWeights(hash, SharedModelWeights::fromData(data));
+}
+
+static DynamicModel* loadDynamicModelFromContents(const std::string& contents, int& input_size,
+                                                  const bool stereo, const ModelPrecision precision)
+{
+    nlohmann::json model_json;
+    ModelKernelInfo info;
+    bool parsed = false;
+
+    if (std::shared_ptr<const SharedModelWeights> weights = loadJsonModelWeights(contents, model_json,
+                                                                                 input_size, info, parsed))
+        return createDynamicModel(weights, input_size, stereo, precision);
+
+    if (! parsed)
+        return nullptr;
+
+    if ((precision != kModelPrecisionDefault ? precision : info.precision) != kModelPrecisionFloat)
+        d_stdout("Reduced precision needs a single recurrent plus dense layer model, using full precision");
+
+    info.precision = kModelPrecisionFloat;
+    info.stereo = stereo;
+
+    DynamicModel* const newmodel = getModelKernel().createDynamicModel(model_json, info);
+
+    if (newmodel != nullptr)
+    {
+        newmodel->input_size = input_size;
+        newmodel->sample_rate = info.sample_rate;
+    }
+
+    return newmodel;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Read a whole file, returns false on error
+
+static bool readModelFile(const char* const filename, std::string& contents)
+{
+    std::ifstream file(filename, std::ifstream::binary);
+
+    if (! file)
+    {
+        d_stderr2("Unable to open model file: %s", filename);
+        return false;
+    }
+
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    contents = ss.str();
+    return true;
+}
+
+static bool isBinaryModelFilename(const char* const filename)
+{
+    const size_t filenameLen = std::strlen(filename);
+
+    return filenameLen > 6 && ::strncasecmp(filename + filenameLen - 6, ".aidax", 6) == 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Load a json or binary model, sharing weights with other models loaded from the same contents
+
+DynamicModel* loadDynamicModel(std::istream& jsonStream, int& input_size, const bool stereo,
+                               const ModelPrecision precision)
+{
+    std::ostringstream ss;
+    ss << jsonStream.rdbuf();
+
+    return loadDynamicModelFromContents(ss.str(), input_size, stereo, precision);
+}
+
+DynamicModel* loadDynamicModelFromFile(const char* const filename, int& input_size, const bool stereo,
+                                       const ModelPrecision precision)
+{
+    if (isBinaryModelFilename(filename))
+    {
+        if (std::shared_ptr<const SharedModelWeights> weights = loadBinaryModelWeights(filename))
+            return createDynamicModel(weights, input_size, stereo, precision);
+
+        return nullptr;
+    }
+
+    std::string contents;
+
+    if (! readModelFile(filename, contents))
+        return nullptr;
+
+    return loadDynamicModelFromContents(contents, input_size, stereo, precision);
+}
+
+DynamicModel* loadDynamicModelFromMemory(const void* const data, const size_t dataSize,
+                                         int& input_size, const bool stereo, const ModelPrecision precision)
+{
+    return loadDynamicModelFromContents(std::string(static_cast<const char*>(data), dataSize),
+                                        input_size, stereo, precision);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Batched models use the shared binary weights in place, json models are converted in memory
+
+static BatchedModel* createBatchedModel(const std::shared_ptr<const SharedModelWeights>& weights,
+                                        const uint32_t maxStreams)
+{
+    const BinaryModel& binmodel = weights->getModel();
+
+    if (binmodel.header->inputSize > kMaxModelInputSize)
+    {
+        d_stderr2("Unable to load batched model, error: Value for input_size not supported");
+        return nullptr;
+    }
+
+    const ModelKernelInfo info = {
+        binmodel.header->inputSkip != 0,
+        binmodel.header->inputGain,
+        binmodel.header->outputGain,
+        kModelPrecisionFloat,
+        binmodel.header->sampleRate,
+        false,
+    };
+
+    BatchedModel* const newmodel = getModelKernel().createBatchedModel(binmodel, info, maxStreams);
+
+    if (newmodel != nullptr)
+        newmodel->weights = weights;
+
+    return newmodel;
+}
+
+static BatchedModel* loadBatchedModelFromContents(const std::string& contents, const uint32_t maxStreams)
+{
+    nlohmann::json model_json;
+    ModelKernelInfo info;
+    int input_size;
+    bool parsed = false;
+
+    if (std::shared_ptr<const SharedModelWeights> weights = loadJsonModelWeights(contents, model_json,
+                                                                                 input_size, info, parsed))
+        return createBatchedModel(weights, maxStreams);
+
+    if (parsed)
+        d_stderr2("Unable to load batched model, error: Only single recurrent plus dense layer models are supported");
+
+    return nullptr;
+}
+
+BatchedModel* loadBatchedModel(std::istream& jsonStream, const uint32_t maxStreams)
+{
+    std::ostringstream ss;
+    ss << jsonStream.rdbuf();
+
+    return loadBatchedModelFromContents(ss.str(), maxStreams);
+}
+
+BatchedModel* loadBatchedModelFromFile(const char* const filename, const uint32_t maxStreams)
+{
+    if (isBinaryModelFilename(filename))
+    {
+        if (std::shared_ptr<const SharedModelWeights> weights = loadBinaryModelWeights(filename))
+            return createBatchedModel(weights, maxStreams);
+
+        return nullptr;
+    }
+
+    std::string contents;
+
+    if (! readModelFile(filename, contents))
+        return nullptr;
+
+    return loadBatchedModelFromContents(contents, maxStreams);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,67 @@
+/*
+ * AIDA-X DPF plugin
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+// Recurrent step math shared by the Eigen based models (see model_kernel.cpp) and the initial state computation of
+// binary models (see model_binary.cpp).
+// Needs Eigen to be already included, and is included inside the namespace of each model kernel, so every kernel
+// gets its own copy built with its own instruction set flags.
+
+template <typename T>
+static inline void recurrentSigmoid(T&& values) noexcept
+{
+    values = (1.f + (-values).exp()).inverse();
+}
+
+/**
+   Gate activations and state update of one GRU or LSTM step, for a single state (column vectors) or for one state per
+   column. @a gates holds the input kernel products plus bias, and is used as scratch space. @a recurrentGates holds
+   the recurrent kernel products, without any bias. For GRU, the update and reset gates have the recurrent bias added
+   into @a gates already, @a recurrentBias is the one of the candidate gate, applied after the reset gate.
+   @a cell is only used by LSTM and @a recurrentBias only by GRU.
+   @a Size is the hidden size when known at compile time, Eigen::Dynamic otherwise, @a size the hidden size.
+ */
+template <bool lstm, int Size, typename Gates, typename RecurrentGates, typename Hidden, typename Cell,
+          typename RecurrentBias>
+static inline void stepRecurrentLayer(Gates&& gates, const RecurrentGates& recurrentGates, Hidden&& hidden,
+                                      Cell&& cell, const RecurrentBias& recurrentBias, const int size) noexcept
+{
+    constexpr const int Size2 = Size == Eigen::Dynamic ? Eigen::Dynamic : Size * 2;
+
+    if constexpr (lstm)
+    {
+        gates += recurrentGates;
+
+        // keras gate order: input, forget, cell, output
+        recurrentSigmoid(gates.template topRows<Size2>(size * 2).array());
+        recurrentSigmoid(gates.template bottomRows<Size>(size).array());
+
+        cell.array() = gates.template middleRows<Size>(size, size).array() * cell.array()
+                     + gates.template topRows<Size>(size).array()
+                     * gates.template middleRows<Size>(size * 2, size).array().tanh();
+        hidden.array() = gates.template bottomRows<Size>(size).array() * cell.array().tanh();
+
+        // unused
+        (void)recurrentBias;
+    }
+    else
+    {
+        // keras gate order: update, reset, candidate, with the reset gate applied after the recurrent product
+        gates.template topRows<Size2>(size * 2) += recurrentGates.template topRows<Size2>(size * 2);
+        recurrentSigmoid(gates.template topRows<Size2>(size * 2).array());
+
+        gates.template bottomRows<Size>(size).array() += gates.template middleRows<Size>(size, size).array()
+            * (recurrentGates.template bottomRows<Size>(size).colwise() + recurrentBias).array();
+
+        hidden.array() = (1.f - gates.template topRows<Size>(size).array())
+                       * gates.template bottomRows<Size>(size).array().tanh()
+                       + gates.template topRows<Size>(size).array() * hidden.array();
+
+        // unused
+        (void)cell;
+    }
+}
@@ -7,8 +7,13 @@
 
 #pragma once
 
-#define DISTRHO_PLUGIN_NUM_INPUTS      1
-#define DISTRHO_PLUGIN_NUM_OUTPUTS     1
+#if AIDAX_STEREO
+# define DISTRHO_PLUGIN_NUM_INPUTS     2
+# define DISTRHO_PLUGIN_NUM_OUTPUTS    2
+#else
+# define DISTRHO_PLUGIN_NUM_INPUTS     1
+# define DISTRHO_PLUGIN_NUM_OUTPUTS    1
+#endif
 #define DISTRHO_UI_USER_RESIZABLE      0
 
 #define DISTRHO_PLUGIN_VARIANT_PLUGIN     1
@@ -0,0 +1,720 @@
+/*
+ * AIDA-X offline renderer
+ * Copyright (C) 2022-2023 Massimo Pennazio <maxipenna@libero.it>
+ * Copyright (C) 2023 Filipe Coelho <falktx@falktx.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "DistrhoPluginInfo.h"
+
+#include "AidaDSP.hpp"
+#include "Files.hpp"
+#include "ResampledModel.hpp"
+
+#include "extra/ScopedDenormalDisable.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dr_flac.h"
+#include "dr_wav.h"
+// -Wunused-variable
+#include "CDSPResampler.h"
+
+// must be last
+#include "PartitionedConvolver.hpp"
+
+START_NAMESPACE_DISTRHO
+
+// --------------------------------------------------------------------------------------------------------------------
+
+/* Offline processing does not care about latency, so use big blocks to keep per-call overhead low */
+static constexpr const uint32_t kDefaultBlockSize = 8192;
+
+/* Same as the plugin, silence run through the model after loading to get rid of initial state "clicks" */
+static constexpr const uint32_t kModelPreBufferSize = 2048;
+
+struct RenderOptions {
+    std::string modelFilename;
+    std::string cabinetFilename; /* empty means built-in cabinet */
+    std::string outputDir;
+    std::vector<std::string> inputFilenames;
+    float parameters[kNumParameters];
+    uint32_t blockSize = kDefaultBlockSize;
+    uint numJobs = 0;
+    ModelPrecision precision = kModelPrecisionDefault;
+    bool checkAccuracy = false;
+    bool useCabinet = true;
+
+    RenderOptions()
+    {
+        for (uint i=0; i<kNumParameters; ++i)
+            parameters[i] = kParameters[i].ranges.def;
+    }
+};
+
+/* Cabinet IR as loaded from disk, before any resampling; shared read-only between workers */
+struct CabinetIR {
+    std::vector<float> data;
+    uint sampleRate = 0;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// Read a wav or flac file as mono, using the same first-channel rule as the plugin
+
+static float* readMonoAudioFile(const char* const filename, uint& sampleRate, drwav_uint64& numFrames)
+{
+    uint channels;
+    float* data;
+
+    if (::strncasecmp(filename + std::max(0, static_cast<int>(std::strlen(filename)) - 5), ".flac", 5) == 0)
+        data = drflac_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+    else
+        data = drwav_open_file_and_read_pcm_frames_f32(filename, &channels, &sampleRate, &numFrames, nullptr);
+
+    if (data == nullptr)
+        return nullptr;
+
+    if (channels > 1)
+    {
+        for (drwav_uint64 i=0, j=0; j<numFrames * channels; ++i, j+=channels)
+            data[i] = data[j];
+    }
+
+    return data;
+}
+
+static bool writeMonoWavFile(const char* const filename, const float* const data,
+                             const drwav_uint64 numFrames, const uint sampleRate)
+{
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = 1;
+    format.sampleRate = sampleRate;
+    format.bitsPerSample = 32;
+
+    drwav wav;
+    if (! drwav_init_file_write(&wav, filename, &format, nullptr))
+        return false;
+
+    const drwav_uint64 written = drwav_write_pcm_frames(&wav, numFrames, data);
+    drwav_uninit(&wav);
+
+    return written == numFrames;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// One renderer per worker thread, owning its own model, filters and convolver
+
+class AidaOfflineRenderer
+{
+    const RenderOptions& options;
+    const CabinetIR& cabinet;
+    AidaToneControl aida;
+    std::unique_ptr<DynamicModel> model;
+    // full precision copy of the model for accuracy checks, run on the same input as the model
+    std::unique_ptr<DynamicModel> referenceModel;
+    std::vector<float> referenceBuffer;
+    std::unique_ptr<PartitionedConvolver> cabsim;
+    std::vector<float> resampledIR;
+    std::vector<float> cabsimInplaceBuffer;
+    LinearValueSmoother param1;
+    LinearValueSmoother param2;
+    LinearValueSmoother referenceParam1;
+    LinearValueSmoother referenceParam2;
+    uint currentSampleRate = 0;
+    uint modelHostSampleRate = 0;
+    bool modelResampled = false;
+    bool referenceModelResampled = false;
+
+public:
+    AidaOfflineRenderer(const RenderOptions& opts, const CabinetIR& cab)
+        : options(opts),
+          cabinet(cab),
+          cabsimInplaceBuffer(opts.blockSize)
+    {
+        param1.setTimeConstant(0.1f);
+        param2.setTimeConstant(0.1f);
+        referenceParam1.setTimeConstant(0.1f);
+        referenceParam2.setTimeConstant(0.1f);
+    }
+
+    bool loadModel()
+    {
+        int input_size = 0;
+        model.reset(loadDynamicModelFromFile(options.modelFilename.c_str(), input_size, false, options.precision));
+
+        if (model == nullptr)
+            return false;
+
+        if (options.checkAccuracy)
+        {
+            referenceModel.reset(loadDynamicModelFromFile(options.modelFilename.c_str(), input_size,
+                                                          false, kModelPrecisionFloat));
+            referenceBuffer.resize(options.blockSize);
+        }
+
+        return ! options.checkAccuracy || referenceModel != nullptr;
+    }
+
+    bool renderFile(const std::string& inputFilename, const std::string& outputFilename)
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(model != nullptr, false);
+
+        uint sampleRate;
+        drwav_uint64 numFrames;
+        float* const fileData = readMonoAudioFile(inputFilename.c_str(), sampleRate, numFrames);
+
+        if (fileData == nullptr)
+        {
+            d_stderr2("Unable to read audio file: %s", inputFilename.c_str());
+            return false;
+        }
+
+        prepare(sampleRate);
+
+        // models running at their own sample rate add latency, rendered past the end and skipped at the start
+        const uint32_t latency = aida.net_bypass ? 0 : model->latency;
+        const drwav_uint64 numRenderFrames = numFrames + latency;
+        std::vector<float> paddedData;
+        float* data = fileData;
+
+        if (latency != 0)
+        {
+            paddedData.resize(numRenderFrames);
+            std::memcpy(paddedData.data(), fileData, sizeof(float)*numFrames);
+            data = paddedData.data();
+        }
+
+        const float* const parameters = options.parameters;
+        const bool enabledLPF = d_isNotZero(parameters[kParameterINLPF]);
+        const bool enabledDC = parameters[kParameterDCBLOCKER] > 0.5f;
+        const bool cabsimBypass = parameters[kParameterCABSIMBYPASS] > 0.5f;
+
+        // optimize for non-denormal usage
+        const ScopedDenormalDisable sdd;
+
+        double signalEnergy = 0.0;
+        double errorEnergy = 0.0;
+        float peakError = 0.f;
+
+        for (drwav_uint64 offset = 0; offset < numRenderFrames; offset += options.blockSize)
+        {
+            const uint32_t numSamples = static_cast<uint32_t>(std::min<drwav_uint64>(options.blockSize,
+                                                                                      numRenderFrames - offset));
+            float* const out = data + offset;
+
+            // High frequencies roll-off (lowpass)
+            if (enabledLPF)
+                applyBiquadFilter(aida.in_lpf_stage[0], aida.in_lpf, out, numSamples);
+
+            // Pre-gain
+            applyGainRamp(aida.inlevel, out, numSamples);
+
+            // Equalizer section
+            if (!aida.eq_bypass && aida.eq_pos == kEqPre)
+                applyToneControls(aida, out, numSamples);
+
+            if (!aida.net_bypass)
+            {
+                if (referenceModel != nullptr)
+                    std::memcpy(referenceBuffer.data(), out, sizeof(float)*numSamples);
+
+                applyModel(model.get(), out, numSamples, param1, param2);
+
+                if (referenceModel != nullptr)
+                {
+                    applyModel(referenceModel.get(), referenceBuffer.data(), numSamples,
+                               referenceParam1, referenceParam2);
+
+                    for (uint32_t i = 0; i < numSamples; ++i)
+                    {
+                        const float error = out[i] - referenceBuffer[i];
+                        signalEnergy += referenceBuffer[i] * referenceBuffer[i];
+                        errorEnergy += error * error;
+                        peakError = std::max(peakError, std::abs(error));
+                    }
+                }
+            }
+
+            // DC blocker filter (highpass)
+            if (enabledDC)
+                applyBiquadFilter(aida.dc_blocker_stage[0], aida.dc_blocker, out, numSamples);
+
+            // Cabinet convolution, with -12dB compensation
+            if (cabsim != nullptr && !cabsimBypass)
+            {
+                std::memcpy(cabsimInplaceBuffer.data(), out, sizeof(float)*numSamples);
+                cabsim->process(cabsimInplaceBuffer.data(), out, numSamples);
+
+                for (uint32_t i = 0; i < numSamples; ++i)
+                    out[i] *= kCabinetMaxGain;
+            }
+
+            // Equalizer section
+            if (!aida.eq_bypass && aida.eq_pos == kEqPost)
+                applyToneControls(aida, out, numSamples);
+
+            // Output volume
+            applyGainRamp(aida.outlevel, out, numSamples);
+        }
+
+        if (referenceModel != nullptr)
+            printAccuracy(inputFilename, signalEnergy, errorEnergy, peakError);
+
+        const bool ok = writeMonoWavFile(outputFilename.c_str(), data + latency, numFrames, sampleRate);
+        drwav_free(fileData, nullptr);
+
+        if (! ok)
+            d_stderr2("Unable to write audio file: %s", outputFilename.c_str());
+
+        return ok;
+    }
+
+private:
+    // model output error against the full precision model, relative to its output and to full scale
+    void printAccuracy(const std::string& inputFilename,
+                       const double signalEnergy, const double errorEnergy, const float peakError) const
+    {
+        const char* const precisionName = getModelPrecisionName(model->precision);
+
+        if (errorEnergy <= 0.0)
+        {
+            d_stdout("Accuracy of %s model on %s: identical to full precision", precisionName, inputFilename.c_str());
+            return;
+        }
+
+        d_stdout("Accuracy of %s model on %s: error %.1f dB below signal, peak error %.1f dBFS",
+                 precisionName, inputFilename.c_str(),
+                 10.0 * std::log10(std::max(signalEnergy, 1e-30) / errorEnergy),
+                 20.0 * std::log10(std::max(peakError, 1e-30f)));
+    }
+
+    // reset all processing state for a new file, recreating rate-dependent pieces as needed
+    void prepare(const uint sampleRate)
+    {
+        const float* const parameters = options.parameters;
+
+        aida = AidaToneControl();
+        aida.net_bypass = parameters[kParameterNETBYPASS] > 0.5f;
+        aida.eq_bypass = parameters[kParameterEQBYPASS] > 0.5f;
+        aida.eq_pos = parameters[kParameterEQPOS] > 0.5f ? kEqPre : kEqPost;
+        aida.mid_type = parameters[kParameterMTYPE] > 0.5f ? kMidEqBandpass : kMidEqPeak;
+        aida.setSampleRate(parameters, sampleRate);
+        aida.inlevel.clearToTargetValue();
+        aida.outlevel.clearToTargetValue();
+
+        param1.setSampleRate(sampleRate);
+        param1.setTargetValue(parameters[kParameterPARAM1]);
+        param1.clearToTargetValue();
+        param2.setSampleRate(sampleRate);
+        param2.setTargetValue(parameters[kParameterPARAM2]);
+        param2.clearToTargetValue();
+
+        if (parameters[kParameterMODELRATE] > 0.5f && modelHostSampleRate != sampleRate)
+        {
+            modelHostSampleRate = sampleRate;
+            setModelHostSampleRate(model, modelResampled, sampleRate);
+
+            if (referenceModel != nullptr)
+                setModelHostSampleRate(referenceModel, referenceModelResampled, sampleRate);
+        }
+
+        resetModel(model.get());
+
+        // Pre-buffer to avoid "clicks" during initialization, unless the model starts settled
+        float silence[kModelPreBufferSize] = {};
+        if (! model->settled_reset)
+            applyModel(model.get(), silence, kModelPreBufferSize, param1, param2);
+
+        if (referenceModel != nullptr)
+        {
+            referenceParam1.setSampleRate(sampleRate);
+            referenceParam1.setTargetValue(parameters[kParameterPARAM1]);
+            referenceParam1.clearToTargetValue();
+            referenceParam2.setSampleRate(sampleRate);
+            referenceParam2.setTargetValue(parameters[kParameterPARAM2]);
+            referenceParam2.clearToTargetValue();
+
+            resetModel(referenceModel.get());
+
+            std::memset(silence, 0, sizeof(silence));
+            if (! referenceModel->settled_reset)
+                applyModel(referenceModel.get(), silence, kModelPreBufferSize, referenceParam1, referenceParam2);
+        }
+
+        if (! options.useCabinet || cabinet.data.empty())
+            return;
+
+        if (currentSampleRate != sampleRate)
+        {
+            currentSampleRate = sampleRate;
+
+            if (cabinet.sampleRate != sampleRate)
+            {
+                r8b::CDSPResampler16IR resampler(cabinet.sampleRate, sampleRate, cabinet.data.size());
+                const int numResampledFrames = resampler.getMaxOutLen(0);
+                DISTRHO_SAFE_ASSERT_RETURN(numResampledFrames > 0,);
+
+                resampledIR.resize(numResampledFrames);
+                resampler.oneshot(cabinet.data.data(), cabinet.data.size(), resampledIR.data(), numResampledFrames);
+            }
+            else
+            {
+                resampledIR = cabinet.data;
+            }
+
+            // same as the plugin, trim the silent tail first and then apply the length limit
+            const size_t decayLength = getCabinetIRDecayLength(resampledIR.data(), resampledIR.size());
+
+            if (decayLength < resampledIR.size())
+            {
+                resampledIR.resize(decayLength);
+                fadeOutCabinetIR(resampledIR.data(), decayLength, sampleRate);
+            }
+
+            const uint32_t maxLength = static_cast<uint32_t>(parameters[kParameterCABSIMMAXLEN] + 0.5f);
+            const size_t maxFrames = static_cast<size_t>(sampleRate * maxLength / 1000.0);
+
+            if (maxFrames != 0 && maxFrames < resampledIR.size())
+            {
+                resampledIR.resize(maxFrames);
+                fadeOutCabinetIR(resampledIR.data(), maxFrames, sampleRate);
+            }
+        }
+
+        // convolver keeps tail state, so each file gets a fresh one
+        cabsim.reset(new PartitionedConvolver());
+
+        if (! cabsim->init(resampledIR.data(), resampledIR.size(), options.blockSize))
+        {
+            d_stderr2("Unable to initialize cabinet convolver");
+            cabsim.reset();
+        }
+    }
+
+    // same as the plugin with MODELRATE on, run a model at its training sample rate if lower than the file one,
+    // unwrapping it first if it was set up for a previous file
+    static void setModelHostSampleRate(std::unique_ptr<DynamicModel>& m, bool& resampled, const uint sampleRate)
+    {
+        if (resampled)
+        {
+            m.reset(static_cast<ResampledModel*>(m.get())->releaseModel());
+            resampled = false;
+        }
+
+        if (! ResampledModel::isNeeded(m.get(), sampleRate))
+            return;
+
+        std::unique_ptr<ResampledModel> wrapper(new ResampledModel(m.get(), sampleRate, false));
+        m.release();
+
+        if (wrapper->latency < kMaxModelLatency)
+        {
+            m.reset(wrapper.release());
+            resampled = true;
+        }
+        else
+        {
+            d_stderr2("Model sample rate conversion needs too much latency, running at the file sample rate");
+            m.reset(wrapper->releaseModel());
+        }
+    }
+
+    DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AidaOfflineRenderer)
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static bool loadCabinetIR(const RenderOptions& options, CabinetIR& cabinet)
+{
+    if (! options.useCabinet)
+        return true;
+
+    drwav_uint64 numFrames;
+    float* ir;
+
+    if (options.cabinetFilename.empty())
+    {
+        using namespace Files;
+
+        uint channels;
+        ir = drwav_open_memory_and_read_pcm_frames_f32(V30_P2_audix_i5_deerinkstudiosData,
+                                                       V30_P2_audix_i5_deerinkstudiosDataSize,
+                                                       &channels,
+                                                       &cabinet.sampleRate,
+                                                       &numFrames,
+                                                       nullptr);
+        DISTRHO_SAFE_ASSERT_RETURN(ir != nullptr, false);
+        DISTRHO_SAFE_ASSERT_RETURN(channels == 1, false);
+    }
+    else
+    {
+        ir = readMonoAudioFile(options.cabinetFilename.c_str(), cabinet.sampleRate, numFrames);
+
+        if (ir == nullptr)
+        {
+            d_stderr2("Unable to read cabinet file: %s", options.cabinetFilename.c_str());
+            return false;
+        }
+    }
+
+    cabinet.data.assign(ir, ir + numFrames);
+    drwav_free(ir, nullptr);
+    return true;
+}
+
+static std::string getOutputFilename(const RenderOptions& options, const std::string& inputFilename)
+{
+    const size_t sep = inputFilename.find_last_of("/\\");
+    const size_t dot = inputFilename.find_last_of('.');
+    const size_t nameStart = sep == std::string::npos ? 0 : sep + 1;
+    const size_t nameEnd = dot == std::string::npos || dot < nameStart ? inputFilename.size() : dot;
+    const std::string basename(inputFilename.substr(nameStart, nameEnd - nameStart));
+
+    if (options.outputDir.empty())
+        return inputFilename.substr(0, nameEnd) + "-aidax.wav";
+
+    return options.outputDir + DISTRHO_OS_SEP_STR + basename + ".wav";
+}
+
+// resolve all output filenames before rendering, inputs with the same basename from different directories get a
+// numbered suffix instead of overwriting each other's output
+static std::vector<std::string> getOutputFilenames(const RenderOptions& options)
+{
+    std::vector<std::string> outputFilenames;
+    std::set<std::string> usedFilenames;
+    outputFilenames.reserve(options.inputFilenames.size());
+
+    for (const std::string& inputFilename : options.inputFilenames)
+    {
+        const std::string outputFilename(getOutputFilename(options, inputFilename));
+        std::string uniqueFilename(outputFilename);
+
+        for (uint n = 2; usedFilenames.count(uniqueFilename) != 0; ++n)
+            uniqueFilename = outputFilename.substr(0, outputFilename.size() - 4) + "-" + std::to_string(n) + ".wav";
+
+        if (uniqueFilename != outputFilename)
+            d_stderr("Output file %s is already used by another input, rendering %s as %s",
+                     outputFilename.c_str(), inputFilename.c_str(), uniqueFilename.c_str());
+
+        usedFilenames.insert(uniqueFilename);
+        outputFilenames.push_back(uniqueFilename);
+    }
+
+    return outputFilenames;
+}
+
+static bool setParameterFromString(RenderOptions& options, const char* const arg)
+{
+    const char* const sep = std::strchr(arg, '=');
+    DISTRHO_SAFE_ASSERT_RETURN(sep != nullptr, false);
+
+    const std::string name(arg, sep - arg);
+
+    for (uint i=0; i<kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+        if (::strcasecmp(name.c_str(), param.symbol) != 0 && ::strcasecmp(name.c_str(), param.name) != 0)
+            continue;
+
+        options.parameters[i] = param.ranges.getFixedValue(std::atof(sep + 1));
+        return true;
+    }
+
+    d_stderr2("Unknown parameter: %s", name.c_str());
+    return false;
+}
+
+static void printUsage(const char* const progname)
+{
+    d_stdout("Usage: %s [options] -m model.json input-files...", progname);
+    d_stdout("Options:");
+    d_stdout("  -m, --model FILE       Neural model json or aidax file (required)");
+    d_stdout("  -c, --cabinet FILE     Cabinet impulse response wav/flac file (built-in IR by default)");
+    d_stdout("  -n, --no-cabinet       Disable cabinet convolution");
+    d_stdout("  -o, --output DIR       Output directory (default: next to input, with '-aidax' suffix)");
+    d_stdout("  -j, --jobs N           Number of files to render in parallel (default: number of CPUs)");
+    d_stdout("  -b, --block-size N     Internal processing block size (default: %u)", kDefaultBlockSize);
+    d_stdout("  -p, --param NAME=VAL   Set a plugin parameter by name or symbol, can be repeated");
+    d_stdout("  -q, --precision P      Model weights precision: float, bf16 or int8 (default: as set in the model)");
+    d_stdout("  -a, --accuracy         Also run the model in full precision and report the error against it");
+    d_stdout("  -h, --help             Show this help");
+    d_stdout("Parameters:");
+
+    for (uint i=0; i<kNumParameters; ++i)
+    {
+        const Parameter& param(kParameters[i]);
+
+        if (param.hints & kParameterIsOutput)
+            continue;
+
+        d_stdout("  %-14s %-14s [%g .. %g] default %g %s",
+                 param.name.buffer(), param.symbol.buffer(),
+                 param.ranges.min, param.ranges.max, param.ranges.def, param.unit.buffer());
+    }
+}
+
+static bool parseArguments(RenderOptions& options, const int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* const arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0)
+            return false;
+
+        if (std::strcmp(arg, "-n") == 0 || std::strcmp(arg, "--no-cabinet") == 0)
+        {
+            options.useCabinet = false;
+            continue;
+        }
+
+        if (std::strcmp(arg, "-a") == 0 || std::strcmp(arg, "--accuracy") == 0)
+        {
+            options.checkAccuracy = true;
+            continue;
+        }
+
+        if (arg[0] != '-')
+        {
+            options.inputFilenames.push_back(arg);
+            continue;
+        }
+
+        if (! hasValue)
+        {
+            d_stderr2("Missing value for option %s", arg);
+            return false;
+        }
+
+        const char* const value = argv[++i];
+
+        if (std::strcmp(arg, "-m") == 0 || std::strcmp(arg, "--model") == 0)
+            options.modelFilename = value;
+        else if (std::strcmp(arg, "-c") == 0 || std::strcmp(arg, "--cabinet") == 0)
+            options.cabinetFilename = value;
+        else if (std::strcmp(arg, "-o") == 0 || std::strcmp(arg, "--output") == 0)
+            options.outputDir = value;
+        else if (std::strcmp(arg, "-j") == 0 || std::strcmp(arg, "--jobs") == 0)
+            options.numJobs = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "-b") == 0 || std::strcmp(arg, "--block-size") == 0)
+            options.blockSize = std::max(16, std::atoi(value));
+        else if (std::strcmp(arg, "-p") == 0 || std::strcmp(arg, "--param") == 0)
+        {
+            if (! setParameterFromString(options, value))
+                return false;
+        }
+        else if (std::strcmp(arg, "-q") == 0 || std::strcmp(arg, "--precision") == 0)
+        {
+            if (! parseModelPrecision(value, options.precision))
+            {
+                d_stderr2("Unknown precision: %s", value);
+                return false;
+            }
+        }
+        else
+        {
+            d_stderr2("Unknown option %s", arg);
+            return false;
+        }
+    }
+
+    return !options.modelFilename.empty() && !options.inputFilenames.empty();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+static int render(RenderOptions& options)
+{
+    CabinetIR cabinet;
+    if (! loadCabinetIR(options, cabinet))
+        return 1;
+
+    const size_t numFiles = options.inputFilenames.size();
+    const std::vector<std::string> outputFilenames(getOutputFilenames(options));
+
+    if (options.numJobs == 0)
+        options.numJobs = std::max(1u, std::thread::hardware_concurrency());
+
+    const uint numWorkers = static_cast<uint>(std::min<size_t>(options.numJobs, numFiles));
+
+    std::atomic<size_t> nextFile { 0 };
+    std::atomic<uint> numFailed { 0 };
+    std::vector<std::thread> workers;
+    workers.reserve(numWorkers);
+
+    for (uint w = 0; w < numWorkers; ++w)
+    {
+        workers.emplace_back([&options, &cabinet, &outputFilenames, &nextFile, &numFailed, numFiles]
+        {
+            AidaOfflineRenderer renderer(options, cabinet);
+
+            if (! renderer.loadModel())
+            {
+                // claim all remaining files so they are reported as failed once
+                for (size_t i; (i = nextFile++) < numFiles;)
+                    ++numFailed;
+                return;
+            }
+
+            for (size_t i; (i = nextFile++) < numFiles;)
+            {
+                const std::string& inputFilename(options.inputFilenames[i]);
+                const std::string& outputFilename(outputFilenames[i]);
+
+                if (outputFilename == inputFilename)
+                {
+                    d_stderr2("Refusing to overwrite input file: %s", inputFilename.c_str());
+                    ++numFailed;
+                    continue;
+                }
+
+                if (renderer.renderFile(inputFilename, outputFilename))
+                    d_stdout("Rendered %s -> %s", inputFilename.c_str(), outputFilename.c_str());
+                else
+                    ++numFailed;
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (const uint failed = numFailed.load())
+    {
+        d_stderr2("%u of %lu files failed to render", failed, static_cast<ulong>(numFiles));
+        return 1;
+    }
+
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+END_NAMESPACE_DISTRHO
+
+int main(int argc, char* argv[])
+{
+    USE_NAMESPACE_DISTRHO;
+
+    RenderOptions options;
+
+    if (! parseArguments(options, argc, argv))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    return render(options);
+}
@@ -0,0 +1 @@
+../BiquadCascade.cpp
\ No newline at end of file
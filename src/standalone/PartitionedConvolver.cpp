@@ -0,0 +1 @@
+../PartitionedConvolver.cpp
\ No newline at end of file
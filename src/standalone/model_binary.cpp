@@ -0,0 +1 @@
+../model_binary.cpp
\ No newline at end of file
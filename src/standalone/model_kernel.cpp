@@ -0,0 +1 @@
+../model_kernel.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../model_loader.cpp
\ No newline at end of file